@@ -7,3 +7,53 @@ check_function_exists(inet_pton HAVE_INET_PTON)
 
 # -- daemon support
 check_function_exists(fork HAVE_FORK)
+
+# -- x86 instruction set extensions for crypto kernels
+include(CheckCXXSourceCompiles)
+
+check_cxx_source_compiles("
+#include <cpuid.h>
+int main() {
+    unsigned int a, b, c, d;
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d);
+}" HAVE_CPUID_H)
+
+check_cxx_source_compiles("
+#include <immintrin.h>
+__attribute__((target(\"sha,sse4.1\")))
+int main() {
+    __m128i v = _mm_setzero_si128();
+    v = _mm_sha256rnds2_epu32(v, v, v);
+    v = _mm_sha1rnds4_epu32(v, v, 0);
+    return _mm_extract_epi32(v, 0);
+}" HAVE_X86_SHA_INTRINSICS)
+
+check_cxx_source_compiles("
+#include <immintrin.h>
+__attribute__((target(\"ssse3\")))
+int main() {
+    __m128i v = _mm_setzero_si128();
+    v = _mm_shuffle_epi8(v, v);
+    return _mm_cvtsi128_si32(v);
+}" HAVE_X86_SSSE3_INTRINSICS)
+
+check_cxx_source_compiles("
+#include <immintrin.h>
+__attribute__((target(\"avx2\")))
+int main() {
+    __m256i v = _mm256_setzero_si256();
+    v = _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(_mm_setzero_si128()));
+    return _mm256_extract_epi32(v, 0);
+}" HAVE_X86_AVX2_INTRINSICS)
+
+check_cxx_source_compiles("
+#include <immintrin.h>
+__attribute__((target(\"aes,ssse3\")))
+int main() {
+    __m128i v = _mm_setzero_si128();
+    v = _mm_aesenclast_si128(_mm_aesenc_si128(v, v), v);
+    return _mm_cvtsi128_si32(_mm_shuffle_epi8(v, v));
+}" HAVE_X86_AESNI_INTRINSICS)
+
+# -- random source
+check_function_exists(getrandom HAVE_GETRANDOM)
@@ -0,0 +1,92 @@
+#ifndef __SHADOWSOCKS_AES_INCLUDED__
+#define __SHADOWSOCKS_AES_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+/* FIPS-197 block cipher, forward direction only as CTR and CFB need */
+class SsAes {
+    public:
+        enum : size_t {
+            BLOCK_SIZE = 16,
+            MAX_ROUNDS = 14
+        };
+        using CtrKernel = void (*)(const uint8_t *roundKeys, size_t rounds,
+                                   uint8_t *counter, const uint8_t *in,
+                                   uint8_t *out, size_t blocks);
+        using CfbKernel = void (*)(const uint8_t *roundKeys, size_t rounds,
+                                   uint8_t *iv, const uint8_t *in,
+                                   uint8_t *out, size_t blocks);
+
+    public:
+        SsAes(const uint8_t *key, size_t keySize);
+        void encryptBlock(const uint8_t *in, uint8_t *out) const;
+        static const char *kernel();
+
+    protected:
+        static bool hardware();
+
+    protected:
+        uint8_t _roundKeys[(MAX_ROUNDS + 1) * BLOCK_SIZE];
+        size_t _rounds;
+};
+
+
+/* counter mode, 128 bits big-endian counter as the IV */
+class SsAesCtr : public SsAes {
+    public:
+        SsAesCtr(const uint8_t *key, size_t keySize, const uint8_t *iv);
+        void crypt(const uint8_t *in, uint8_t *out, size_t size);
+
+    private:
+        uint8_t _counter[BLOCK_SIZE];
+        uint8_t _keystream[BLOCK_SIZE];
+        size_t _leftover = 0;
+        CtrKernel _kernel;
+};
+
+
+/* 128 bits cipher feedback, decryption of whole blocks is parallel */
+class SsAesCfb : public SsAes {
+    public:
+        SsAesCfb(const uint8_t *key, size_t keySize, const uint8_t *iv);
+        void encrypt(const uint8_t *in, uint8_t *out, size_t size);
+        void decrypt(const uint8_t *in, uint8_t *out, size_t size);
+
+    private:
+        template <bool Decrypt>
+        void crypt(const uint8_t *in, uint8_t *out, size_t size);
+
+    private:
+        uint8_t _register[BLOCK_SIZE];
+        size_t _used = 0;
+        CfbKernel _encryptKernel;
+        CfbKernel _decryptKernel;
+};
+
+
+/* block kernels, selected by SsCpu runtime dispatch */
+void aesCtrBlocksScalar(const uint8_t *roundKeys, size_t rounds,
+                        uint8_t *counter, const uint8_t *in,
+                        uint8_t *out, size_t blocks);
+void aesCfbEncryptBlocksScalar(const uint8_t *roundKeys, size_t rounds,
+                               uint8_t *iv, const uint8_t *in,
+                               uint8_t *out, size_t blocks);
+void aesCfbDecryptBlocksScalar(const uint8_t *roundKeys, size_t rounds,
+                               uint8_t *iv, const uint8_t *in,
+                               uint8_t *out, size_t blocks);
+#if defined(HAVE_X86_AESNI_INTRINSICS)
+void aesCtrBlocksNi(const uint8_t *roundKeys, size_t rounds,
+                    uint8_t *counter, const uint8_t *in,
+                    uint8_t *out, size_t blocks);
+void aesCfbEncryptBlocksNi(const uint8_t *roundKeys, size_t rounds,
+                           uint8_t *iv, const uint8_t *in,
+                           uint8_t *out, size_t blocks);
+void aesCfbDecryptBlocksNi(const uint8_t *roundKeys, size_t rounds,
+                           uint8_t *iv, const uint8_t *in,
+                           uint8_t *out, size_t blocks);
+#endif
+
+
+#endif // __SHADOWSOCKS_AES_INCLUDED__
@@ -0,0 +1,80 @@
+#ifndef __SHADOWSOCKS_BYTES_INCLUDED__
+#define __SHADOWSOCKS_BYTES_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+#define ROTL32(V, N)                    (((V) << (N)) | ((V) >> (32 - (N))))
+#define ROTR32(V, N)                    (((V) >> (N)) | ((V) << (32 - (N))))
+
+
+// read big-endian word
+inline uint32_t loadBigEndian32(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) |
+           (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) |
+           (static_cast<uint32_t>(p[3]));
+}
+
+// write big-endian word
+inline void storeBigEndian32(uint8_t *p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+// read big-endian double word
+inline uint64_t loadBigEndian64(const uint8_t *p) {
+    return static_cast<uint64_t>(loadBigEndian32(p)) << 32 |
+           static_cast<uint64_t>(loadBigEndian32(p + 4));
+}
+
+// write big-endian double word
+inline void storeBigEndian64(uint8_t *p, uint64_t v) {
+    storeBigEndian32(p, static_cast<uint32_t>(v >> 32));
+    storeBigEndian32(p + 4, static_cast<uint32_t>(v));
+}
+
+// read little-endian word
+inline uint32_t loadLittleEndian32(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0])) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// write little-endian word
+inline void storeLittleEndian32(uint8_t *p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+// read little-endian double word
+inline uint64_t loadLittleEndian64(const uint8_t *p) {
+    return static_cast<uint64_t>(loadLittleEndian32(p)) |
+           static_cast<uint64_t>(loadLittleEndian32(p + 4)) << 32;
+}
+
+// write little-endian double word
+inline void storeLittleEndian64(uint8_t *p, uint64_t v) {
+    storeLittleEndian32(p, static_cast<uint32_t>(v));
+    storeLittleEndian32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+// compare secrets without data dependent timing
+inline bool constantTimeEquals(const uint8_t *a, const uint8_t *b,
+                               size_t size) {
+    uint8_t difference = 0;
+    for (size_t i = 0; i < size; ++i) {
+        difference |= a[i] ^ b[i];
+    }
+
+    return difference == 0;
+}
+
+
+#endif // __SHADOWSOCKS_BYTES_INCLUDED__
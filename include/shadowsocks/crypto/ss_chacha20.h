@@ -0,0 +1,103 @@
+#ifndef __SHADOWSOCKS_CHACHA20_INCLUDED__
+#define __SHADOWSOCKS_CHACHA20_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_buffer.h"
+#include "shadowsocks/crypto/ss_poly1305.h"
+
+
+/* RFC 8439 stream cipher, whole blocks go to a runtime dispatched kernel */
+class SsChaCha20 {
+    public:
+        enum : size_t {
+            KEY_SIZE = 32,
+            NONCE_SIZE = 12,
+            HNONCE_SIZE = 16,
+            BLOCK_SIZE = 64
+        };
+        using Kernel = void (*)(uint32_t *state, const uint8_t *in,
+                                uint8_t *out, size_t blocks);
+
+    public:
+        SsChaCha20(const uint8_t *key, const uint8_t *nonce,
+                   uint32_t counter = 0);
+        void crypt(const uint8_t *in, uint8_t *out, size_t size);
+        static void hchacha20(const uint8_t *key, const uint8_t *nonce,
+                              uint8_t *subkey);
+        static const char *kernel();
+
+    private:
+        static Kernel dispatch();
+
+    private:
+        uint32_t _state[16];
+        uint8_t _keystream[BLOCK_SIZE];
+        size_t _leftover = 0;
+        Kernel _kernel;
+};
+
+
+/* chacha20-ietf-poly1305 and its extended nonce variant */
+class SsChaCha20Poly1305 {
+    public:
+        enum : size_t {
+            KEY_SIZE = SsChaCha20::KEY_SIZE,
+            NONCE_SIZE = SsChaCha20::NONCE_SIZE,
+            XNONCE_SIZE = 24,
+            TAG_SIZE = 16
+        };
+
+    public:
+        static void seal(const uint8_t *key, const uint8_t *nonce,
+                         const uint8_t *aad, size_t aadSize,
+                         const uint8_t *in, size_t size, uint8_t *out);
+        static bool open(const uint8_t *key, const uint8_t *nonce,
+                         const uint8_t *aad, size_t aadSize,
+                         const uint8_t *in, size_t size, uint8_t *out);
+        static void xseal(const uint8_t *key, const uint8_t *nonce,
+                          const uint8_t *aad, size_t aadSize,
+                          const uint8_t *in, size_t size, uint8_t *out);
+        static bool xopen(const uint8_t *key, const uint8_t *nonce,
+                          const uint8_t *aad, size_t aadSize,
+                          const uint8_t *in, size_t size, uint8_t *out);
+
+        static void seal(const uint8_t *key, const uint8_t *nonce,
+                         const uint8_t *aad, size_t aadSize,
+                         const SsBufferChain &in, size_t size, uint8_t *out);
+        static bool open(const uint8_t *key, const uint8_t *nonce,
+                         const uint8_t *aad, size_t aadSize,
+                         const SsBufferChain &in, size_t size, uint8_t *out);
+        static void xseal(const uint8_t *key, const uint8_t *nonce,
+                          const uint8_t *aad, size_t aadSize,
+                          const SsBufferChain &in, size_t size, uint8_t *out);
+        static bool xopen(const uint8_t *key, const uint8_t *nonce,
+                          const uint8_t *aad, size_t aadSize,
+                          const SsBufferChain &in, size_t size, uint8_t *out);
+
+    private:
+        static void authenticate(const uint8_t *polyKey,
+                                 const uint8_t *aad, size_t aadSize,
+                                 const uint8_t *ciphertext, size_t size,
+                                 uint8_t *tag);
+        static void finish(SsPoly1305 &poly1305, size_t aadSize, size_t size,
+                           uint8_t *tag);
+        static void extend(const uint8_t *key, const uint8_t *nonce,
+                           uint8_t *subkey, uint8_t *subnonce);
+};
+
+
+/* block kernels, selected by SsCpu runtime dispatch */
+void chacha20BlocksScalar(uint32_t *state, const uint8_t *in,
+                          uint8_t *out, size_t blocks);
+#if defined(HAVE_X86_SSSE3_INTRINSICS)
+void chacha20BlocksSsse3(uint32_t *state, const uint8_t *in,
+                         uint8_t *out, size_t blocks);
+#endif
+#if defined(HAVE_X86_AVX2_INTRINSICS)
+void chacha20BlocksAvx2(uint32_t *state, const uint8_t *in,
+                        uint8_t *out, size_t blocks);
+#endif
+
+
+#endif // __SHADOWSOCKS_CHACHA20_INCLUDED__
@@ -0,0 +1,68 @@
+#ifndef __SHADOWSOCKS_CIPHER_INCLUDED__
+#define __SHADOWSOCKS_CIPHER_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_buffer.h"
+
+
+/* AEAD session of one direction: salt, HKDF-SHA1 subkey, counter nonce */
+class SsCipher {
+    public:
+        enum class CipherMethod : uint8_t {
+            CM_CHACHA20_IETF_POLY1305   = 0x01,
+            CM_XCHACHA20_IETF_POLY1305  = 0x02
+        };
+        using Stream = std::vector<DATA_STREAM_UNIT>;
+        using Key = std::vector<DATA_STREAM_UNIT>;
+
+    public:
+        SsCipher(CipherMethod method, Key key);
+        static CipherMethod method(const char *methodName);
+        static const char *name(CipherMethod method);
+        static const std::vector<CipherMethod> &methods();
+
+        size_t keySize() const;
+        size_t saltSize() const;
+        size_t nonceSize() const;
+        size_t tagSize() const;
+        bool extendedNonce() const;
+
+        void setSalt(const uint8_t *salt);
+        void newSalt(uint8_t *salt);
+
+        void seal(const uint8_t *in, size_t size, uint8_t *out);
+        bool open(const uint8_t *in, size_t size, uint8_t *out);
+        void seal(const Stream &plaintext, Stream &ciphertext);
+        bool open(const Stream &ciphertext, Stream &plaintext);
+        void seal(const SsBufferChain &plaintext, size_t size, uint8_t *out);
+        bool open(const SsBufferChain &ciphertext, size_t size, uint8_t *out);
+
+        void sealPacket(const Stream &plaintext, Stream &packet);
+        bool openPacket(const Stream &packet, Stream &plaintext);
+        void sealDirectPacket(const Stream &plaintext, Stream &packet);
+        bool openDirectPacket(const Stream &packet, Stream &plaintext);
+
+    private:
+        void seal(const uint8_t *key, const uint8_t *nonce,
+                  const uint8_t *in, size_t size, uint8_t *out);
+        bool open(const uint8_t *key, const uint8_t *nonce,
+                  const uint8_t *in, size_t size, uint8_t *out);
+        void incrementNonce();
+
+    private:
+        CipherMethod _method;
+        Key _key;
+        uint8_t _subkey[32];
+        uint8_t _nonce[24];
+
+    friend std::ostream &operator<<(std::ostream &out, SsCipher *cipher);
+};
+
+
+/* utility methods declare */
+std::ostream &operator<<(std::ostream &out,
+                         const SsCipher::CipherMethod &method);
+
+
+#endif // __SHADOWSOCKS_CIPHER_INCLUDED__
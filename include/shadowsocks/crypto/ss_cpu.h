@@ -0,0 +1,52 @@
+#ifndef __SHADOWSOCKS_CPU_INCLUDED__
+#define __SHADOWSOCKS_CPU_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SS_CPU_X86
+#endif
+
+/* compile a single function for an instruction set extension */
+#if defined(__GNUC__) || defined(__clang__)
+#define SS_CPU_TARGET(FEATURES)         __attribute__((target(FEATURES)))
+#else
+#define SS_CPU_TARGET(FEATURES)
+#endif
+
+
+class SsCpu {
+    public:
+        enum class Feature : uint32_t {
+            CF_SSSE3        = 0x0001,
+            CF_SSE41        = 0x0002,
+            CF_AVX2         = 0x0004,
+            CF_AESNI        = 0x0008,
+            CF_PCLMUL       = 0x0010,
+            CF_SHA          = 0x0020
+        };
+        using Features = uint32_t;
+
+    public:
+        static bool supports(Feature feature);
+        static Features detected();
+        static Features enabled();
+        static void disable(Features features);
+        static void reset();
+
+    private:
+        static Features detect();
+        static Features fromEnvironment();
+
+    private:
+        static std::atomic<Features> _disabled;
+};
+
+
+/* utility methods declare */
+std::ostream &operator<<(std::ostream &out, const SsCpu::Feature &feature);
+
+
+#endif // __SHADOWSOCKS_CPU_INCLUDED__
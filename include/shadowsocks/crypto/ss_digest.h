@@ -0,0 +1,175 @@
+#ifndef __SHADOWSOCKS_DIGEST_INCLUDED__
+#define __SHADOWSOCKS_DIGEST_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+/* Merkle-Damgard hashing over a runtime dispatched compression kernel */
+template <size_t StateWords, size_t DigestSize>
+class SsBlockDigest {
+    public:
+        enum : size_t {
+            BLOCK_SIZE = 64,
+            DIGEST_SIZE = DigestSize
+        };
+        using Compressor = void (*)(uint32_t *state,
+                                    const uint8_t *blocks, size_t count);
+
+    public:
+        void update(const void *data, size_t size);
+        void final(uint8_t *digest);
+
+    protected:
+        SsBlockDigest(const uint32_t *iv, Compressor compressor);
+
+    private:
+        uint32_t _state[StateWords];
+        uint8_t _buffer[BLOCK_SIZE];
+        size_t _buffered = 0;
+        uint64_t _length = 0;
+        Compressor _compressor;
+};
+
+
+class SsSha1 : public SsBlockDigest<5, 20> {
+    public:
+        SsSha1();
+        static void digest(const void *data, size_t size, uint8_t *out);
+        static const char *kernel();
+
+    private:
+        static Compressor compressor();
+};
+
+
+class SsSha256 : public SsBlockDigest<8, 32> {
+    public:
+        SsSha256();
+        static void digest(const void *data, size_t size, uint8_t *out);
+        static const char *kernel();
+
+    private:
+        static Compressor compressor();
+};
+
+
+/* HMAC with the padded key blocks absorbed once and reused */
+template <typename Hash>
+class SsHmac {
+    public:
+        enum : size_t {
+            DIGEST_SIZE = Hash::DIGEST_SIZE
+        };
+
+    public:
+        SsHmac(const uint8_t *key, size_t size);
+        void update(const void *data, size_t size);
+        void final(uint8_t *digest);
+        void reset();
+
+    private:
+        Hash _innerKeyed;
+        Hash _outerKeyed;
+        Hash _inner;
+};
+
+
+/* RFC 5869 key derivation, HKDF-SHA1 derives every AEAD subkey */
+template <typename Hash>
+class SsHkdf {
+    public:
+        static void derive(const uint8_t *key, size_t keySize,
+                           const uint8_t *salt, size_t saltSize,
+                           const uint8_t *info, size_t infoSize,
+                           uint8_t *out, size_t outSize);
+};
+
+
+/* compression kernels, selected by SsCpu runtime dispatch */
+void sha1CompressScalar(uint32_t *state, const uint8_t *blocks, size_t count);
+void sha256CompressScalar(uint32_t *state, const uint8_t *blocks, size_t count);
+#if defined(HAVE_X86_SHA_INTRINSICS)
+void sha1CompressShaNi(uint32_t *state, const uint8_t *blocks, size_t count);
+void sha256CompressShaNi(uint32_t *state, const uint8_t *blocks, size_t count);
+#endif
+
+
+// SsHmac constructor
+template <typename Hash>
+SsHmac<Hash>::SsHmac(const uint8_t *key, size_t size) {
+    uint8_t block[Hash::BLOCK_SIZE] = {0};
+    if (size > Hash::BLOCK_SIZE) {
+        Hash::digest(key, size, block);
+    } else {
+        std::memcpy(block, key, size);
+    }
+
+    for (auto &byte : block) {
+        byte ^= 0x36;
+    }
+    _innerKeyed.update(block, sizeof(block));
+
+    for (auto &byte : block) {
+        byte ^= 0x36 ^ 0x5c;
+    }
+    _outerKeyed.update(block, sizeof(block));
+
+    _inner = _innerKeyed;
+}
+
+// absorb message
+template <typename Hash>
+void SsHmac<Hash>::update(const void *data, size_t size) {
+    _inner.update(data, size);
+}
+
+// finish authenticate code and prepare for next message with same key
+template <typename Hash>
+void SsHmac<Hash>::final(uint8_t *digest) {
+    uint8_t innerDigest[Hash::DIGEST_SIZE];
+    _inner.final(innerDigest);
+
+    Hash outer = _outerKeyed;
+    outer.update(innerDigest, sizeof(innerDigest));
+    outer.final(digest);
+
+    reset();
+}
+
+// restart message with same key
+template <typename Hash>
+void SsHmac<Hash>::reset() {
+    _inner = _innerKeyed;
+}
+
+// extract-then-expand
+template <typename Hash>
+void SsHkdf<Hash>::derive(const uint8_t *key, size_t keySize,
+                          const uint8_t *salt, size_t saltSize,
+                          const uint8_t *info, size_t infoSize,
+                          uint8_t *out, size_t outSize) {
+    uint8_t prk[Hash::DIGEST_SIZE];
+    SsHmac<Hash> extract(salt, saltSize);
+    extract.update(key, keySize);
+    extract.final(prk);
+
+    uint8_t block[Hash::DIGEST_SIZE];
+    SsHmac<Hash> expand(prk, sizeof(prk));
+    for (uint8_t counter = 1; outSize != 0; ++counter) {
+        if (counter != 1) {
+            expand.update(block, sizeof(block));
+        }
+        expand.update(info, infoSize);
+        expand.update(&counter, 1);
+        expand.final(block);
+
+        auto size = std::min<size_t>(outSize, sizeof(block));
+        std::memcpy(out, block, size);
+        out += size;
+        outSize -= size;
+    }
+}
+
+
+#endif // __SHADOWSOCKS_DIGEST_INCLUDED__
@@ -0,0 +1,42 @@
+#ifndef __SHADOWSOCKS_POLY1305_INCLUDED__
+#define __SHADOWSOCKS_POLY1305_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+/* RFC 8439 one-time authenticator */
+class SsPoly1305 {
+    public:
+        enum : size_t {
+            KEY_SIZE = 32,
+            BLOCK_SIZE = 16,
+            TAG_SIZE = 16
+        };
+
+    public:
+        explicit SsPoly1305(const uint8_t *key);
+        void update(const void *data, size_t size);
+        void pad();
+        void final(uint8_t *tag);
+        static bool verify(const uint8_t *a, const uint8_t *b);
+
+    private:
+        void blocks(const uint8_t *data, size_t size, bool last);
+
+    private:
+#if defined(__SIZEOF_INT128__)
+        uint64_t _r[3];
+        uint64_t _h[3] = {0, 0, 0};
+        uint64_t _pad[2];
+#else
+        uint32_t _r[5];
+        uint32_t _h[5] = {0, 0, 0, 0, 0};
+        uint32_t _pad[4];
+#endif
+        uint8_t _buffer[BLOCK_SIZE];
+        size_t _buffered = 0;
+};
+
+
+#endif // __SHADOWSOCKS_POLY1305_INCLUDED__
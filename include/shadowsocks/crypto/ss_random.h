@@ -0,0 +1,15 @@
+#ifndef __SHADOWSOCKS_RANDOM_INCLUDED__
+#define __SHADOWSOCKS_RANDOM_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+/* operating system CSPRNG for salts and nonces */
+class SsRandom {
+    public:
+        static void fill(uint8_t *buffer, size_t size);
+};
+
+
+#endif // __SHADOWSOCKS_RANDOM_INCLUDED__
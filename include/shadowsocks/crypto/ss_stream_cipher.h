@@ -0,0 +1,63 @@
+#ifndef __SHADOWSOCKS_STREAM_CIPHER_INCLUDED__
+#define __SHADOWSOCKS_STREAM_CIPHER_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/crypto/ss_aes.h"
+
+
+/* legacy unauthenticated session of one direction, IV leads the stream */
+class SsStreamCipher {
+    public:
+        enum class CipherMethod : uint8_t {
+            CM_AES_128_CTR  = 0x01,
+            CM_AES_192_CTR  = 0x02,
+            CM_AES_256_CTR  = 0x03,
+            CM_AES_128_CFB  = 0x04,
+            CM_AES_192_CFB  = 0x05,
+            CM_AES_256_CFB  = 0x06
+        };
+        using Stream = std::vector<DATA_STREAM_UNIT>;
+        using Key = std::vector<DATA_STREAM_UNIT>;
+
+    public:
+        SsStreamCipher(CipherMethod method, Key key);
+        static CipherMethod method(const char *methodName);
+        static const char *name(CipherMethod method);
+        static const std::vector<CipherMethod> &methods();
+        static size_t keySize(CipherMethod method);
+
+        size_t keySize() const;
+        size_t ivSize() const;
+
+        void setIv(const uint8_t *iv);
+        void newIv(uint8_t *iv);
+
+        void encrypt(const uint8_t *in, uint8_t *out, size_t size);
+        void decrypt(const uint8_t *in, uint8_t *out, size_t size);
+        void encrypt(const Stream &plaintext, Stream &ciphertext);
+        void decrypt(const Stream &ciphertext, Stream &plaintext);
+
+        void encryptPacket(const Stream &plaintext, Stream &packet);
+        bool decryptPacket(const Stream &packet, Stream &plaintext);
+
+    private:
+        bool counterMode() const;
+
+    private:
+        CipherMethod _method;
+        Key _key;
+        std::unique_ptr<SsAesCtr> _ctr;
+        std::unique_ptr<SsAesCfb> _cfb;
+
+    friend std::ostream &operator<<(std::ostream &out,
+                                    SsStreamCipher *cipher);
+};
+
+
+/* utility methods declare */
+std::ostream &operator<<(std::ostream &out,
+                         const SsStreamCipher::CipherMethod &method);
+
+
+#endif // __SHADOWSOCKS_STREAM_CIPHER_INCLUDED__
@@ -4,22 +4,37 @@
 
 #include "shadowsocks/ss_types.h"
 #include "shadowsocks/network/ss_tcp_network.h"
+#include "shadowsocks/ss_access_log.h"
 
 
+/* client and remote streams of one reactor, every closed connection
+ * leaves an access record when an access log is set */
 class SsTcpRelay {
     public:
         using Stream = std::vector<DATA_STREAM_UNIT>;
-        using StreamCallback = std::function<void(Stream&, Stream&)>;
+        // a failed callback closes the connection, e.g. with EC_BAD_HEADER
+        using StreamCallback = std::function<SsResult<void>(Stream&, Stream&)>;
+        using CloseReason = SsAccessRecord::CloseReason;
 
     public:
         void before(StreamCallback callback);
         void after(StreamCallback callback);
 
+        void setAccessLog(std::shared_ptr<SsAccessLog> accessLog);
+        void opened(SsNetwork::Descriptor descriptor, const char *user,
+                    const char *host, uint16_t port);
+        void relayed(SsNetwork::Descriptor descriptor,
+                     size_t sent, size_t received);
+        void close(SsNetwork::Descriptor descriptor, CloseReason reason);
+        void tick();
+
     private:
         std::shared_ptr<SsTcpNetwork> _source;
         std::map<
             SsNetwork::Descriptor, std::pair<SsTcpNetwork, SsTcpNetwork>
         > _streams;
+        std::shared_ptr<SsAccessLog> _accessLog;
+        std::map<SsNetwork::Descriptor, SsAccessRecord> _records;
 };
 
 
@@ -4,6 +4,7 @@
 
 #include "shadowsocks/ss_types.h"
 #include "shadowsocks/ss_selector.h"
+#include "shadowsocks/ss_result.h"
 
 
 class SsNetwork {
@@ -22,6 +23,7 @@ class SsNetwork {
         using Address = sockaddr_storage;
         using Descriptor = SsSelector::Descriptor;
         using ConnectingTuple = std::pair<Descriptor, std::shared_ptr<Address>>;
+        using AcceptResult = SsResult<ConnectingTuple>;
 
     protected:
         enum class NetworkState : uint8_t {
@@ -37,7 +39,11 @@ class SsNetwork {
         Descriptor getDescriptor() const;
         void connect(HostName host, HostPort port);
         void listen(HostName host, HostPort port);
-        virtual ConnectingTuple accept();
+        virtual AcceptResult accept();
+        SsResult<void> halfClose();
+        SsResult<void> close(bool reset);
+        SsResult<void> setIncomingCpu(int cpu);
+        SsResult<int> incomingCpu() const;
 
     protected:
         virtual void doConnect(HostName host, HostPort port);
@@ -50,9 +56,10 @@ class SsNetwork {
         Descriptor _descriptor;
 
     friend std::ostream &operator<<(std::ostream &o, SsNetwork *network);
-    friend std::ostream &operator<<(std::ostream &o, NetworkFamily &family);
-    friend std::ostream &operator<<(std::ostream &o, NetworkType &type);
-    friend std::ostream &operator<<(std::ostream &o, NetworkState &state);
+    friend std::ostream &operator<<(std::ostream &o,
+                                    const NetworkFamily &family);
+    friend std::ostream &operator<<(std::ostream &o, const NetworkType &type);
+    friend std::ostream &operator<<(std::ostream &o, const NetworkState &state);
 };
 
 
@@ -9,7 +9,7 @@ class SsTcpNetwork : public SsNetwork {
     public:
         explicit SsTcpNetwork(NetworkFamily family);
         SsTcpNetwork(Descriptor descriptor, Address address);
-        ConnectingTuple accept() final;
+        AcceptResult accept() final;
 
     protected:
         void doConnect(HostName host, HostPort port) final;
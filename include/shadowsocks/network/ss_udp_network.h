@@ -9,7 +9,7 @@ class SsUdpNetwork : public SsNetwork {
     public:
         explicit SsUdpNetwork(NetworkFamily family);
         SsUdpNetwork(Descriptor descriptor, Address address);
-        ConnectingTuple accept() final;
+        AcceptResult accept() final;
 
     protected:
         void doConnect(HostName host, HostPort port) final;
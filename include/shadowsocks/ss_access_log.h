@@ -0,0 +1,107 @@
+#ifndef __SHADOWSOCKS_ACCESS_LOG_INCLUDED__
+#define __SHADOWSOCKS_ACCESS_LOG_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_file_logger.h"
+
+
+#define ACCESS_LOG_RECORD_SIZE          (128)
+#define ACCESS_LOG_USER_SIZE            (24)
+#define ACCESS_LOG_TARGET_SIZE          (64)
+#define ACCESS_LOG_BATCH_RECORDS        (512)
+#define ACCESS_LOG_FLUSH_INTERVAL       (1000)
+
+
+/**
+ * access log file, native byte order, one record per closed connection:
+ *   [i64 opened ns][i64 closed ns][u64 sent][u64 received]
+ *   [u16 port][u8 reason][u8 reserved][u32 reserved]
+ *   [24 bytes user][64 bytes target], strings zero padded, not terminated
+ *   when they fill the field
+ */
+
+
+/* one relay connection, kept by the connection and updated in place, bytes
+ * are counted from the client's view */
+struct SsAccessRecord {
+    enum class CloseReason : uint8_t {
+        CR_CLIENT_CLOSED,
+        CR_REMOTE_CLOSED,
+        CR_TIMEOUT,
+        CR_ERROR,
+        CR_REJECTED,
+        CR_SHUTDOWN
+    };
+
+    int64_t opened = 0;
+    int64_t closed = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint16_t port = 0;
+    CloseReason reason = CloseReason::CR_CLIENT_CLOSED;
+    uint8_t reserved8 = 0;
+    uint32_t reserved32 = 0;
+    char user[ACCESS_LOG_USER_SIZE] = {};
+    char target[ACCESS_LOG_TARGET_SIZE] = {};
+
+    void open(const char *user, const char *host, uint16_t port);
+    static const char *reasonName(CloseReason reason);
+};
+
+static_assert(sizeof(SsAccessRecord) == ACCESS_LOG_RECORD_SIZE,
+              "access records are written as they are");
+
+
+/* file shared by the reactors, takes whole batches */
+class SsAccessSink {
+    public:
+        explicit SsAccessSink(std::string path,
+                              SsFileRotation rotation = SsFileRotation());
+
+        void write(const SsAccessRecord *records, size_t count);
+        void flush();
+
+    private:
+        std::mutex _mutex;
+        SsFileStream _stream;
+};
+
+
+/* per reactor batch, not thread safe, records reach the sink when the batch
+ * is full or on the first tick after the flush interval */
+class SsAccessLog {
+    public:
+        using CloseReason = SsAccessRecord::CloseReason;
+
+    public:
+        explicit SsAccessLog(std::shared_ptr<SsAccessSink> sink);
+        SsAccessLog(const SsAccessLog&) = delete;
+        SsAccessLog &operator=(const SsAccessLog&) = delete;
+        ~SsAccessLog();
+
+        void close(SsAccessRecord &record, CloseReason reason);
+        void tick();
+        void flush();
+
+    private:
+        std::shared_ptr<SsAccessSink> _sink;
+        std::unique_ptr<SsAccessRecord[]> _records;
+        size_t _count = 0;
+        std::chrono::steady_clock::time_point _lastFlush;
+};
+
+
+/* decodes an access log to logfmt lines */
+class SsAccessLogReader {
+    public:
+        explicit SsAccessLogReader(std::istream &in);
+
+        bool next(std::string &line);
+
+    private:
+        std::istream &_input;
+};
+
+
+#endif // __SHADOWSOCKS_ACCESS_LOG_INCLUDED__
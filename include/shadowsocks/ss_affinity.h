@@ -0,0 +1,43 @@
+#ifndef __SHADOWSOCKS_AFFINITY_INCLUDED__
+#define __SHADOWSOCKS_AFFINITY_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_result.h"
+
+
+#define AFFINITY_SYSFS_CPU              ("/sys/devices/system/cpu")
+#define AFFINITY_UNKNOWN_NODE           (-1)
+
+
+/* reactor placement: the cores the process may run on, interleaved across
+ * NUMA nodes so a few reactors already use every socket, memory follows
+ * the first touch, so a pinned reactor allocates its pools after pin() */
+class SsAffinity {
+    public:
+        struct Placement {
+            int cpu;
+            int node;
+        };
+
+    public:
+        static const std::vector<Placement> &placements();
+        static const Placement &placement(size_t reactor);
+        static int node(int cpu);
+        static int current();
+        static void setReactors(size_t reactors);
+        static size_t reactorOf(int cpu);
+
+        static SsResult<void> pin(int cpu);
+        static SsResult<void> pinReactor(size_t reactor);
+
+    private:
+        static std::vector<Placement> discover();
+
+    private:
+        static std::vector<std::vector<size_t>> _candidates;
+        static size_t _reactors;
+};
+
+
+#endif // __SHADOWSOCKS_AFFINITY_INCLUDED__
@@ -0,0 +1,92 @@
+#ifndef __SHADOWSOCKS_BUFFER_INCLUDED__
+#define __SHADOWSOCKS_BUFFER_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+#define BUFFER_SEGMENT_SIZE             (16 * 1024)
+#define BUFFER_POOL_IDLE_LIMIT          (256)
+
+
+/* free list of fixed size segments, owned by one reactor thread */
+class SsBufferPool {
+    public:
+        using Segment = std::unique_ptr<DATA_STREAM_UNIT[]>;
+
+    public:
+        explicit SsBufferPool(size_t segmentSize = BUFFER_SEGMENT_SIZE,
+                              size_t idleLimit = BUFFER_POOL_IDLE_LIMIT);
+        Segment acquire();
+        void release(Segment segment);
+        void reserve(size_t segments);
+        size_t segmentSize() const;
+        size_t idle() const;
+
+    private:
+        size_t _segmentSize;
+        size_t _idleLimit;
+        std::vector<Segment> _idle;
+};
+
+
+/* byte queue over pooled segments, never copied to be contiguous, the
+   piece vector keeps its capacity so steady traffic does not allocate */
+class SsBufferChain {
+    public:
+        explicit SsBufferChain(SsBufferPool &pool);
+        SsBufferChain(const SsBufferChain&) = delete;
+        SsBufferChain &operator=(const SsBufferChain&) = delete;
+        ~SsBufferChain();
+
+        size_t size() const;
+        bool empty() const;
+
+        void append(const DATA_STREAM_UNIT *data, size_t size);
+        DATA_STREAM_UNIT *reserve(size_t &available);
+        void commit(size_t size);
+        void consume(size_t size);
+        size_t copy(size_t offset, DATA_STREAM_UNIT *out, size_t size) const;
+        void clear();
+
+        template <typename Visitor>
+        void visit(size_t offset, size_t size, Visitor visitor) const;
+
+    private:
+        struct Piece {
+            SsBufferPool::Segment data;
+            size_t begin;
+            size_t end;
+        };
+
+    private:
+        SsBufferPool &_pool;
+        std::vector<Piece> _pieces;
+        size_t _head = 0;
+        size_t _size = 0;
+};
+
+
+// call visitor(data, size) for each contiguous run of [offset, offset+size)
+template <typename Visitor>
+void SsBufferChain::visit(size_t offset, size_t size, Visitor visitor) const {
+    assert(offset + size <= _size);
+
+    for (auto index = _head; index < _pieces.size() && size != 0; ++index) {
+        auto &piece = _pieces[index];
+
+        auto length = piece.end - piece.begin;
+        if (offset >= length) {
+            offset -= length;
+            continue;
+        }
+
+        auto run = std::min(length - offset, size);
+        visitor(piece.data.get() + piece.begin + offset, run);
+        size -= run;
+        offset = 0;
+    }
+}
+
+
+#endif // __SHADOWSOCKS_BUFFER_INCLUDED__
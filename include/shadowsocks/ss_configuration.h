@@ -0,0 +1,126 @@
+#ifndef __SHADOWSOCKS_CONFIGURATION_INCLUDED__
+#define __SHADOWSOCKS_CONFIGURATION_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/crypto/ss_cipher.h"
+#include "shadowsocks/network/ss_network.h"
+
+
+#define CONFIG_MAX_CONNECTIONS          (4096)
+#define CONFIG_IDLE_TIMEOUT             (300)
+
+
+/**
+ * configuration file, one directive per line, # starts a comment:
+ *   listen <host> <port>
+ *   user <name> <method> <password>
+ *   limit connections <count>
+ *   limit idle <seconds>
+ *   acl allow|deny <address>[/<prefix>]
+ * acl rules are tried in order, the first match decides, no match allows
+ */
+
+
+/* one loaded configuration, never changed afterwards, so reactors and
+ * connections share it without locks */
+class SsConfiguration {
+    public:
+        struct Listener {
+            std::string host;
+            SsNetwork::HostPort port;
+
+            bool operator==(const Listener &other) const;
+        };
+
+        struct User {
+            std::string name;
+            SsCipher::CipherMethod method;
+            std::string password;
+        };
+
+        struct Limits {
+            size_t connections = CONFIG_MAX_CONNECTIONS;
+            std::chrono::seconds idle{CONFIG_IDLE_TIMEOUT};
+        };
+
+        struct AclRule {
+            bool allow;
+            int family;
+            uint8_t address[16];
+            uint8_t prefix;
+        };
+
+        using Snapshot = std::shared_ptr<const SsConfiguration>;
+
+    public:
+        static Snapshot load(const std::string &path);
+        static Snapshot parse(std::istream &in, const std::string &name);
+
+        const std::vector<Listener> &listeners() const;
+        const std::vector<User> &users() const;
+        const User *user(const std::string &name) const;
+        const Limits &limits() const;
+        bool permitted(const SsNetwork::Address &address) const;
+
+        // listeners to open, swapped arguments give those to close
+        static std::vector<Listener> added(const SsConfiguration &before,
+                                           const SsConfiguration &after);
+
+    private:
+        void directive(std::istringstream &line, const std::string &where);
+        static AclRule rule(bool allow, const std::string &text,
+                            const std::string &where);
+        static bool matches(const AclRule &rule, int family,
+                            const uint8_t *address);
+
+    private:
+        std::vector<Listener> _listeners;
+        std::vector<User> _users;
+        Limits _limits;
+        std::vector<AclRule> _acl;
+};
+
+
+/* current configuration of the process, reloads build a new snapshot off
+ * the hot path and publish it, connections keep the snapshot they started
+ * with until they close */
+class SsConfigStore {
+    public:
+        using Snapshot = SsConfiguration::Snapshot;
+
+        /* a reactor's copy of the current snapshot, refreshed when the
+         * generation changed, a single atomic load per check otherwise */
+        class View {
+            public:
+                explicit View(const SsConfigStore &store);
+
+                const Snapshot &get() const;
+                bool refresh();
+
+            private:
+                const SsConfigStore &_store;
+                Snapshot _snapshot;
+                uint64_t _generation;
+        };
+
+    public:
+        explicit SsConfigStore(std::string path);
+
+        Snapshot current() const;
+        uint64_t generation() const;
+        bool reload();
+        bool poll();
+
+        static void requestReload();
+
+    private:
+        std::string _path;
+        Snapshot _current;
+        std::atomic<uint64_t> _generation{0};
+        static std::atomic<unsigned> _reloadRequests;
+        unsigned _reloadsSeen = 0;
+};
+
+
+#endif // __SHADOWSOCKS_CONFIGURATION_INCLUDED__
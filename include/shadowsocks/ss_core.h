@@ -4,9 +4,27 @@
 
 #include "shadowsocks/ss_types.h"
 #include "shadowsocks/ss_logger.h"
+#include "shadowsocks/ss_file_logger.h"
+
+
+#define CORE_DRAIN_PERIOD               (20000)
+#define CORE_DRAIN_IDLE                 (5000)
 
 
 class SsCore {
+    public:
+        enum class ShutdownPhase : uint8_t {
+            SP_RUNNING,
+            SP_DRAINING,
+            SP_CLOSING
+        };
+        enum class DrainAction : uint8_t {
+            DA_KEEP,
+            DA_HALF_CLOSE,
+            DA_CLOSE
+        };
+        using Clock = std::chrono::steady_clock;
+
     public:
         static void initEnvironments();
         static void atExit(std::function<void()> callback);
@@ -14,11 +32,31 @@ class SsCore {
         static void enableDebugLogger(SsLogger::LoggerLevel level);
         static void disableDebugLogger();
 
+        static void setDrainPeriod(std::chrono::milliseconds period,
+                                   std::chrono::milliseconds idle);
+        static void requestShutdown();
+        static void requestClose();
+        static ShutdownPhase shutdownPhase();
+        static bool accepting();
+        static DrainAction drainAction(Clock::time_point lastActivity);
+
     private:
         static void socketStartup();
+        static void signalStartup();
+        static void hangupHandler(int signal);
+        static void terminateHandler(int signal);
+        static void quitHandler(int signal);
+        static void recorderHandler(int signal);
+        static void fatalHandler(int signal);
 
     private:
         static std::vector<std::function<void()>> _exitCallbacks;
+        static std::atomic<bool> _drainRequested;
+        static std::atomic<bool> _closeRequested;
+        static std::atomic<bool> _polled;
+        static std::atomic<int64_t> _drainDeadline;
+        static std::chrono::milliseconds _drainPeriod;
+        static std::chrono::milliseconds _drainIdle;
 };
 
 
@@ -8,7 +8,7 @@
 
 class SsException : public std::runtime_error {
     public:
-        SsException(SsLogger::LoggerLevel level, std::string message);
+        SsException(SsLogger::LoggerLevel level, const std::string &message);
         SsException(SsLogger::LoggerLevel level, std::string &&message);
 };
 
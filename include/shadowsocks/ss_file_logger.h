@@ -0,0 +1,113 @@
+#ifndef __SHADOWSOCKS_FILE_LOGGER_INCLUDED__
+#define __SHADOWSOCKS_FILE_LOGGER_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_logger.h"
+
+
+#define FILE_LOGGER_BUFFER_SIZE         (256 * 1024)
+#define FILE_LOGGER_FLUSH_INTERVAL      (1000)
+
+
+/* rotation limits, zero disables either one */
+struct SsFileRotation {
+    size_t size = 0;
+    std::chrono::seconds interval{0};
+};
+
+
+/* appends to a file through a large buffer, rotates and reopens it, every
+ * new file starts with the header, so it can be read on its own, the rename
+ * of a rotation runs on its own thread, writes go on to the renamed file
+ * until the new one is opened */
+class SsFileBuffer : public std::streambuf {
+    public:
+        using Header = std::function<void(std::string &header)>;
+        using LocalOffset = std::function<time_t(time_t now)>;
+
+        // FP_LOGGER follows the logger, see sync(), FP_ALWAYS writes out on
+        // every flush and leaves the pace to the owner
+        enum class FlushPolicy : uint8_t {
+            FP_LOGGER,
+            FP_ALWAYS
+        };
+
+    public:
+        SsFileBuffer(std::string path, SsFileRotation rotation,
+                     FlushPolicy policy = FlushPolicy::FP_LOGGER);
+        SsFileBuffer(const SsFileBuffer&) = delete;
+        SsFileBuffer &operator=(const SsFileBuffer&) = delete;
+        ~SsFileBuffer() override;
+
+        void setHeader(Header header);
+        void setLocalOffset(LocalOffset offset);
+        static void reopenAll();
+
+    protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *data, std::streamsize size) override;
+        int sync() override;
+
+    private:
+        struct Rotation {
+            std::string path;
+            std::string suffix;
+            std::atomic<bool> done{false};
+        };
+
+    private:
+        bool open();
+        void close();
+        void rotate(time_t now);
+        void rotated();
+        void writeHeader();
+        void writeOut();
+        void writeOut(char *end);
+        time_t nextRotation(time_t now) const;
+        static void rename(const std::string &path, const std::string &suffix);
+
+    private:
+        std::string _path;
+        SsFileRotation _rotation;
+        FlushPolicy _policy;
+        std::FILE *_file = nullptr;
+        size_t _fileSize = 0;
+        time_t _rotateAt = 0;
+        unsigned _generation = 0;
+        std::unique_ptr<char[]> _buffer;
+        char *_boundary = nullptr;
+        std::chrono::steady_clock::time_point _lastWrite;
+        Header _header;
+        std::string _headerBytes;
+        LocalOffset _localOffset;
+        std::shared_ptr<Rotation> _rotating;
+        static std::atomic<unsigned> _reopenGeneration;
+};
+
+
+/* std::ostream owning its SsFileBuffer */
+class SsFileStream : public std::ostream {
+    public:
+        SsFileStream(std::string path, SsFileRotation rotation,
+                     SsFileBuffer::FlushPolicy policy =
+                         SsFileBuffer::FlushPolicy::FP_LOGGER);
+
+        void setHeader(SsFileBuffer::Header header);
+        void setLocalOffset(SsFileBuffer::LocalOffset offset);
+
+    private:
+        SsFileBuffer _buffer;
+};
+
+
+/* logger writing to a rotating file, stream is a base so it outlives SsLogger */
+class SsFileLogger : private SsFileStream, public SsLogger {
+    public:
+        explicit SsFileLogger(std::string path,
+                              SsFileRotation rotation = SsFileRotation());
+        ~SsFileLogger() override;
+};
+
+
+#endif // __SHADOWSOCKS_FILE_LOGGER_INCLUDED__
@@ -0,0 +1,122 @@
+#ifndef __SHADOWSOCKS_FLIGHT_RECORDER_INCLUDED__
+#define __SHADOWSOCKS_FLIGHT_RECORDER_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_format.h"
+#include "shadowsocks/ss_log_record.h"
+
+
+#define FLIGHT_RECORDER_SLOTS           (512)
+#define FLIGHT_RECORDER_SLOT_SIZE       (240)
+#define FLIGHT_RECORDER_THREADS         (128)
+#define FLIGHT_RECORDER_PATH_SIZE       (256)
+
+
+/* last records of one thread, overwritten in place, every slot carries a
+ * sequence number so a dump can read while the owner keeps writing */
+class SsFlightRing {
+    public:
+        SsFlightRing() = default;
+        SsFlightRing(const SsFlightRing&) = delete;
+        SsFlightRing &operator=(const SsFlightRing&) = delete;
+
+        bool acquire();
+        void release();
+        void push(const char *format, const char *record, size_t size);
+
+        template <typename Visitor>
+        void visit(Visitor visitor) const;
+
+    private:
+        struct Slot {
+            std::atomic<uint32_t> sequence{0};
+            const char *format = nullptr;
+            size_t size = 0;
+            char data[FLIGHT_RECORDER_SLOT_SIZE];
+        };
+
+    private:
+        Slot _slots[FLIGHT_RECORDER_SLOTS];
+        std::atomic<uint64_t> _next{0};
+        std::atomic<bool> _owned{false};
+};
+
+
+/* binary records of every thread kept in memory, written to a file only when
+ * dumped, rings are never freed so a signal handler can always walk them */
+class SsFlightRecorder {
+    public:
+        static void enable(uint8_t level, const std::string &path);
+        static void disable();
+        static bool enabled(uint8_t level);
+        static uint8_t level();
+        static bool dump();
+
+        template <typename Fmt, typename ...Args>
+        static void record(uint8_t level, const Args &...args);
+        static void record(uint8_t level, const char *message, size_t size);
+
+    private:
+        static SsFlightRing *threadRing();
+        static void push(const char *format, const SsFormatBuffer &record);
+
+    private:
+        static std::atomic<uint8_t> _level;
+        static char _path[FLIGHT_RECORDER_PATH_SIZE];
+        static std::atomic<SsFlightRing*> _rings[FLIGHT_RECORDER_THREADS];
+};
+
+
+// call visitor(format, record, size) for every complete slot, oldest first,
+// slots rewritten during the copy are skipped
+template <typename Visitor>
+void SsFlightRing::visit(Visitor visitor) const {
+    char data[FLIGHT_RECORDER_SLOT_SIZE];
+
+    auto next = _next.load(std::memory_order_acquire);
+    auto first = next > FLIGHT_RECORDER_SLOTS
+        ? next - FLIGHT_RECORDER_SLOTS : 0;
+    for (auto index = first; index < next; ++index) {
+        auto &slot = _slots[index % FLIGHT_RECORDER_SLOTS];
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0) {
+            continue;
+        }
+
+        auto format = slot.format;
+        auto size = std::min<size_t>(slot.size, sizeof(data));
+        std::memcpy(data, slot.data, size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence ||
+                format == nullptr) {
+            continue;
+        }
+        visitor(format, data, size);
+    }
+}
+
+// any level at or above the recorder level is kept
+inline bool SsFlightRecorder::enabled(uint8_t level) {
+    return level >= _level.load(std::memory_order_relaxed);
+}
+
+// raw arguments like a binary logger, messages too long for a slot are
+// formatted and kept truncated
+template <typename Fmt, typename ...Args>
+void SsFlightRecorder::record(uint8_t level, const Args &...args) {
+    SsFormatBuffer record;
+    SsLogRecord::encode<Fmt>(record, level, args...);
+    if (record.size() <= FLIGHT_RECORDER_SLOT_SIZE) {
+        push(Fmt::str(), record);
+        return;
+    }
+
+    SsFormatBuffer text;
+    SsFormat<Fmt>::write(text, args...);
+    SsFlightRecorder::record(level, text.data(), text.size());
+}
+
+
+#endif // __SHADOWSOCKS_FLIGHT_RECORDER_INCLUDED__
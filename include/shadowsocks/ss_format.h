@@ -0,0 +1,474 @@
+#ifndef __SHADOWSOCKS_FORMAT_INCLUDED__
+#define __SHADOWSOCKS_FORMAT_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+#define FORMAT_BUFFER_SIZE              (2048)
+
+
+/**
+ * format syntax shared by the compile time and runtime paths:
+ *   %<c><alnum...>  placeholder, any spec letter prints the next argument
+ *   %x<alnum...>    placeholder printed as 0x prefixed hex
+ *   %%              literal percent
+ */
+
+
+/* argument computed only when its message is formatted or encoded */
+template <typename Callable>
+class SsLazy {
+    public:
+        explicit SsLazy(Callable callable);
+
+        auto operator()() const -> decltype(std::declval<const Callable&>()());
+
+    private:
+        Callable _callable;
+};
+
+template <typename Type>
+struct SsIsLazy : std::false_type {
+};
+
+template <typename Callable>
+struct SsIsLazy<SsLazy<Callable>> : std::true_type {
+};
+
+// lazy argument, callable() runs only when the message is emitted
+template <typename Callable>
+inline SsLazy<typename std::decay<Callable>::type> logLazy(
+        Callable &&callable) {
+    return SsLazy<typename std::decay<Callable>::type>(
+        std::forward<Callable>(callable));
+}
+
+// SsLazy constructor
+template <typename Callable>
+SsLazy<Callable>::SsLazy(Callable callable) : _callable(std::move(callable)) {
+}
+
+// the value
+template <typename Callable>
+auto SsLazy<Callable>::operator()() const
+        -> decltype(std::declval<const Callable&>()()) {
+    return _callable();
+}
+
+
+/* fixed size output of one message, truncated when full */
+class SsFormatBuffer {
+    public:
+        enum class ArgumentKind : uint8_t {
+            AK_SIGNED,
+            AK_UNSIGNED,
+            AK_CHARACTER,
+            AK_STRING,
+            AK_FLOATING,
+            AK_STREAM,
+            AK_LAZY
+        };
+
+        template <typename Type>
+        struct Kind;
+
+        template <ArgumentKind K>
+        using KindTag = std::integral_constant<ArgumentKind, K>;
+
+    public:
+        void append(const char *data, size_t size);
+        void append(char c);
+        const char *data() const;
+        size_t size() const;
+        size_t available() const;
+        std::string str() const;
+
+        template <typename Type>
+        void write(const Type &value, bool hex);
+
+    private:
+        void writeUnsigned(unsigned long long value, bool hex);
+        void writeFloating(double value);
+
+        template <typename Type>
+        void write(const Type &value, bool hex, KindTag<ArgumentKind::AK_SIGNED>);
+        template <typename Type>
+        void write(const Type &value, bool hex, KindTag<ArgumentKind::AK_UNSIGNED>);
+        template <typename Type>
+        void write(const Type &value, bool hex, KindTag<ArgumentKind::AK_CHARACTER>);
+        template <typename Type>
+        void write(const Type &value, bool hex, KindTag<ArgumentKind::AK_FLOATING>);
+        template <typename Type>
+        void write(const Type &value, bool hex, KindTag<ArgumentKind::AK_STREAM>);
+        template <typename Type>
+        void write(const Type &value, bool hex, KindTag<ArgumentKind::AK_LAZY>);
+        void write(const char *value, bool hex, KindTag<ArgumentKind::AK_STRING>);
+        void write(const std::string &value, bool hex,
+                   KindTag<ArgumentKind::AK_STRING>);
+
+    private:
+        char _data[FORMAT_BUFFER_SIZE];
+        size_t _size = 0;
+};
+
+
+/* ostream appending to a format buffer, operator<< types are written in
+   place, a per thread stream is reused unless it is already in use */
+class SsFormatStream {
+    public:
+        SsFormatStream(SsFormatBuffer &buffer, bool hex);
+        SsFormatStream(const SsFormatStream&) = delete;
+        SsFormatStream &operator=(const SsFormatStream&) = delete;
+        ~SsFormatStream();
+
+        std::ostream &get();
+
+    private:
+        class Buffer : public std::streambuf {
+            public:
+                SsFormatBuffer *target = nullptr;
+
+            protected:
+                int_type overflow(int_type c) override;
+                std::streamsize xsputn(const char *data,
+                                       std::streamsize size) override;
+        };
+
+        struct Shared {
+            Buffer buffer;
+            std::ostream out{&buffer};
+            bool busy = false;
+        };
+
+    private:
+        static Shared &shared();
+
+    private:
+        Shared *_shared = nullptr;
+        std::unique_ptr<Shared> _nested;
+};
+
+
+/* how an argument type is written */
+template <typename Type>
+struct SsFormatBuffer::Kind {
+    using Decayed = typename std::decay<Type>::type;
+
+    static constexpr ArgumentKind value =
+        SsIsLazy<Decayed>::value
+            ? ArgumentKind::AK_LAZY :
+        std::is_same<Decayed, char>::value ||
+        std::is_same<Decayed, signed char>::value ||
+        std::is_same<Decayed, unsigned char>::value
+            ? ArgumentKind::AK_CHARACTER :
+        std::is_integral<Decayed>::value && std::is_signed<Decayed>::value
+            ? ArgumentKind::AK_SIGNED :
+        std::is_integral<Decayed>::value
+            ? ArgumentKind::AK_UNSIGNED :
+        std::is_floating_point<Decayed>::value
+            ? ArgumentKind::AK_FLOATING :
+        std::is_same<Decayed, char*>::value ||
+        std::is_same<Decayed, const char*>::value ||
+        std::is_same<Decayed, std::string>::value
+            ? ArgumentKind::AK_STRING :
+        ArgumentKind::AK_STREAM;
+};
+
+// write one argument, picked by type category
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex) {
+    write(value, hex, KindTag<Kind<Type>::value>());
+}
+
+// signed integer, hex shows the two's complement like std::hex
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex,
+                           KindTag<ArgumentKind::AK_SIGNED>) {
+    using Unsigned = typename std::make_unsigned<Type>::type;
+    if (hex || value >= 0) {
+        writeUnsigned(static_cast<Unsigned>(value), hex);
+    } else {
+        append('-');
+        writeUnsigned(0ULL - static_cast<unsigned long long>(value), false);
+    }
+}
+
+// unsigned integer and bool
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex,
+                           KindTag<ArgumentKind::AK_UNSIGNED>) {
+    writeUnsigned(static_cast<unsigned long long>(value), hex);
+}
+
+// single character, never as a number
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex,
+                           KindTag<ArgumentKind::AK_CHARACTER>) {
+    append(static_cast<char>(value));
+}
+
+// floating point, same digits as default ostream
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex,
+                           KindTag<ArgumentKind::AK_FLOATING>) {
+    writeFloating(static_cast<double>(value));
+}
+
+// anything with an operator<<, the slow path
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex,
+                           KindTag<ArgumentKind::AK_STREAM>) {
+    SsFormatStream stream(*this, hex);
+    stream.get() << value;
+}
+
+// lazy argument, evaluated here and written by its result type
+template <typename Type>
+void SsFormatBuffer::write(const Type &value, bool hex,
+                           KindTag<ArgumentKind::AK_LAZY>) {
+    write(value(), hex);
+}
+
+
+/* constexpr scanner over a literal format, runs are searched in halves of
+   doubling windows so the recursion depth is logarithmic in their length */
+constexpr bool formatAlnum(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z');
+}
+
+// a literal run stops at a percent, a placeholder at its first non alnum
+constexpr bool formatStop(char c, bool literal) {
+    return literal ? c == '\0' || c == '%' : !formatAlnum(c);
+}
+
+constexpr size_t formatScan(const char *fmt, size_t position, size_t count,
+                            bool literal);
+
+// right half only when the left one has no stop, nothing past the
+// terminator is read
+constexpr size_t formatScanRight(const char *fmt, size_t position,
+                                 size_t count, bool literal, size_t left) {
+    return left < position + count / 2 ? left :
+           formatScan(fmt, position + count / 2, count - count / 2, literal);
+}
+
+// first stop in [position, position + count), position + count when none
+constexpr size_t formatScan(const char *fmt, size_t position, size_t count,
+                            bool literal) {
+    return count == 1
+        ? (formatStop(fmt[position], literal) ? position : position + 1) :
+        formatScanRight(fmt, position, count, literal,
+                        formatScan(fmt, position, count / 2, literal));
+}
+
+constexpr size_t formatRunEnd(const char *fmt, size_t position, size_t count,
+                              bool literal);
+
+// stop found in the window, or the next window twice as large
+constexpr size_t formatRunNext(const char *fmt, size_t position, size_t count,
+                               bool literal, size_t found) {
+    return found < position + count ? found :
+           formatRunEnd(fmt, position + count, count * 2, literal);
+}
+
+// first stop at or after position
+constexpr size_t formatRunEnd(const char *fmt, size_t position, size_t count,
+                              bool literal) {
+    return formatRunNext(fmt, position, count, literal,
+                         formatScan(fmt, position, count, literal));
+}
+
+// end of the literal run starting at position
+constexpr size_t formatLiteralEnd(const char *fmt, size_t position) {
+    return formatRunEnd(fmt, position, 1, true);
+}
+
+// first position after the alnum run of a placeholder
+constexpr size_t formatSpecEnd(const char *fmt, size_t position) {
+    return formatRunEnd(fmt, position, 1, false);
+}
+
+constexpr size_t formatPlaceholders(const char *fmt, size_t position = 0);
+
+// placeholders from the percent at end on, one recursion per token
+constexpr size_t formatPlaceholdersAt(const char *fmt, size_t end) {
+    return fmt[end] == '\0' ? 0 :
+           fmt[end + 1] == '%' ? formatPlaceholders(fmt, end + 2) :
+           fmt[end + 1] == '\0' ? 0 :
+           1 + formatPlaceholders(fmt, formatSpecEnd(fmt, end + 2));
+}
+
+// number of placeholders, escapes excluded
+constexpr size_t formatPlaceholders(const char *fmt, size_t position) {
+    return formatPlaceholdersAt(fmt, formatLiteralEnd(fmt, position));
+}
+
+constexpr bool formatHex(const char *fmt, size_t index, size_t position = 0);
+
+// placeholder at index from the percent at end on
+constexpr bool formatHexAt(const char *fmt, size_t index, size_t end) {
+    return fmt[end] == '\0' ? false :
+           fmt[end + 1] == '%' ? formatHex(fmt, index, end + 2) :
+           fmt[end + 1] == '\0' ? false :
+           index == 0 ? fmt[end + 1] == 'x' :
+           formatHex(fmt, index - 1, formatSpecEnd(fmt, end + 2));
+}
+
+// placeholder at index is written as hex
+constexpr bool formatHex(const char *fmt, size_t index, size_t position) {
+    return formatHexAt(fmt, index, formatLiteralEnd(fmt, position));
+}
+
+
+/* one literal run and the token after it, unrolled at compile time */
+template <typename Fmt, size_t Position, size_t Argument>
+class SsFormatStep {
+    public:
+        enum class Token : uint8_t {
+            FT_END,
+            FT_ESCAPE,
+            FT_PLACEHOLDER
+        };
+
+        template <typename Tuple>
+        static void write(SsFormatBuffer &buffer, const Tuple &args);
+
+    private:
+        template <Token T>
+        using TokenTag = std::integral_constant<Token, T>;
+
+        static constexpr size_t LITERAL_END =
+            formatLiteralEnd(Fmt::str(), Position);
+        static constexpr Token TOKEN =
+            Fmt::str()[LITERAL_END] == '\0' ? Token::FT_END :
+            Fmt::str()[LITERAL_END + 1] == '%' ? Token::FT_ESCAPE :
+            Fmt::str()[LITERAL_END + 1] == '\0' ? Token::FT_END :
+            Token::FT_PLACEHOLDER;
+
+        template <typename Tuple>
+        static void next(SsFormatBuffer &buffer, const Tuple &args,
+                         TokenTag<Token::FT_END>);
+        template <typename Tuple>
+        static void next(SsFormatBuffer &buffer, const Tuple &args,
+                         TokenTag<Token::FT_ESCAPE>);
+        template <typename Tuple>
+        static void next(SsFormatBuffer &buffer, const Tuple &args,
+                         TokenTag<Token::FT_PLACEHOLDER>);
+};
+
+// literal is a constant sized copy, then the token
+template <typename Fmt, size_t Position, size_t Argument>
+template <typename Tuple>
+void SsFormatStep<Fmt, Position, Argument>::write(SsFormatBuffer &buffer,
+                                                  const Tuple &args) {
+    buffer.append(Fmt::str() + Position, LITERAL_END - Position);
+    next(buffer, args, TokenTag<TOKEN>());
+}
+
+// end of format, a trailing lone percent is kept
+template <typename Fmt, size_t Position, size_t Argument>
+template <typename Tuple>
+void SsFormatStep<Fmt, Position, Argument>::next(SsFormatBuffer &buffer,
+                                                 const Tuple &args,
+                                                 TokenTag<Token::FT_END>) {
+    if (Fmt::str()[LITERAL_END] == '%') {
+        buffer.append('%');
+    }
+}
+
+// escaped percent
+template <typename Fmt, size_t Position, size_t Argument>
+template <typename Tuple>
+void SsFormatStep<Fmt, Position, Argument>::next(SsFormatBuffer &buffer,
+                                                 const Tuple &args,
+                                                 TokenTag<Token::FT_ESCAPE>) {
+    buffer.append('%');
+    SsFormatStep<Fmt, LITERAL_END + 2, Argument>::write(buffer, args);
+}
+
+// argument in place of the placeholder
+template <typename Fmt, size_t Position, size_t Argument>
+template <typename Tuple>
+void SsFormatStep<Fmt, Position, Argument>::next(
+        SsFormatBuffer &buffer, const Tuple &args,
+        TokenTag<Token::FT_PLACEHOLDER>) {
+    constexpr bool hex = Fmt::str()[LITERAL_END + 1] == 'x';
+    if (hex) {
+        buffer.append("0x", 2);
+    }
+    buffer.write(std::get<Argument>(args), hex);
+
+    SsFormatStep<
+        Fmt, formatSpecEnd(Fmt::str(), LITERAL_END + 2), Argument + 1
+    >::write(buffer, args);
+}
+
+
+/* literal format known at compile time, Fmt::str() returns it */
+template <typename Fmt>
+class SsFormat {
+    public:
+        enum : size_t {
+            PLACEHOLDERS = formatPlaceholders(Fmt::str())
+        };
+
+        template <typename ...Args>
+        static void write(SsFormatBuffer &buffer, const Args &...args);
+};
+
+// validate argument count, then the unrolled steps
+template <typename Fmt>
+template <typename ...Args>
+void SsFormat<Fmt>::write(SsFormatBuffer &buffer, const Args &...args) {
+    static_assert(PLACEHOLDERS == sizeof...(Args),
+                  "format placeholders and arguments count differ");
+
+    SsFormatStep<Fmt, 0, 0>::write(buffer, std::tie(args...));
+}
+
+
+/* runtime format, same syntax for formats only known at runtime */
+void formatRuntime(SsFormatBuffer &buffer, const char *fmt);
+
+template <typename Type, typename ...Args>
+void formatRuntime(SsFormatBuffer &buffer, const char *fmt,
+                   const Type &value, const Args &...args);
+
+// advance to the next placeholder, copying literals and escapes
+const char *formatRuntimeNext(SsFormatBuffer &buffer, const char *fmt);
+
+// write value at the next placeholder, then the rest
+template <typename Type, typename ...Args>
+void formatRuntime(SsFormatBuffer &buffer, const char *fmt,
+                   const Type &value, const Args &...args) {
+    fmt = formatRuntimeNext(buffer, fmt);
+    if (*fmt == '\0') {
+        return;
+    }
+
+    bool hex = fmt[1] == 'x';
+    if (hex) {
+        buffer.append("0x", 2);
+    }
+    buffer.write(value, hex);
+
+    fmt += 2;
+    while (formatAlnum(*fmt)) {
+        ++fmt;
+    }
+    formatRuntime(buffer, fmt, args...);
+}
+
+
+/* declare a literal format as a type, for SsFormat */
+#define FORMAT_LITERAL(NAME, FMT)                                             \
+    struct NAME {                                                             \
+        static constexpr const char *str() {                                  \
+            return FMT;                                                       \
+        }                                                                     \
+    }
+
+
+#endif // __SHADOWSOCKS_FORMAT_INCLUDED__
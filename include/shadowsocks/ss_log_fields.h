@@ -0,0 +1,190 @@
+#ifndef __SHADOWSOCKS_LOG_FIELDS_INCLUDED__
+#define __SHADOWSOCKS_LOG_FIELDS_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_format.h"
+
+
+#define FIELD_VALUE_RESERVE             (32)
+#define FIELD_ESCAPE_RESERVE            (7)
+
+
+/* one typed key/value pair, the value is referenced until it is written */
+template <typename Type>
+struct SsLogField {
+    const char *key;
+    const Type &value;
+};
+
+// field for structured log calls, key should be a plain identifier
+template <typename Type>
+inline SsLogField<Type> logField(const char *key, const Type &value) {
+    return SsLogField<Type>{key, value};
+}
+
+
+/* writes fields as logfmt, JSON members or journald native fields straight
+ * into a buffer, strings are escaped as they are copied, a full buffer drops
+ * the remaining fields and closes quotes, so the output always parses */
+class SsFieldWriter {
+    public:
+        enum class FieldStyle : uint8_t {
+            FS_LOGFMT,
+            FS_JSON,
+            FS_JOURNAL
+        };
+
+    public:
+        SsFieldWriter(SsFormatBuffer &buffer, FieldStyle style);
+
+        void message(const char *data, size_t size);
+
+        template <typename Type, typename ...Fields>
+        void fields(const SsLogField<Type> &field, const Fields &...rest);
+        void fields();
+
+    private:
+        using ArgumentKind = SsFormatBuffer::ArgumentKind;
+
+        template <ArgumentKind K>
+        using KindTag = SsFormatBuffer::KindTag<K>;
+
+        void key(const char *key);
+        void open();
+        void close();
+        void string(const char *data, size_t size);
+        void journalString(const char *data, size_t size);
+        void number(double value);
+
+        template <typename Type>
+        void value(const Type &value);
+        template <typename Rep, typename Period>
+        void value(const std::chrono::duration<Rep, Period> &value);
+        void value(bool value);
+
+        template <typename Type>
+        void value(const Type &value, KindTag<ArgumentKind::AK_SIGNED>);
+        template <typename Type>
+        void value(const Type &value, KindTag<ArgumentKind::AK_UNSIGNED>);
+        template <typename Type>
+        void value(const Type &value, KindTag<ArgumentKind::AK_CHARACTER>);
+        template <typename Type>
+        void value(const Type &value, KindTag<ArgumentKind::AK_FLOATING>);
+        template <typename Type>
+        void value(const Type &value, KindTag<ArgumentKind::AK_STREAM>);
+        template <typename Type>
+        void value(const Type &value, KindTag<ArgumentKind::AK_LAZY>);
+        void value(const char *value, KindTag<ArgumentKind::AK_STRING>);
+        void value(const std::string &value, KindTag<ArgumentKind::AK_STRING>);
+
+    private:
+        SsFormatBuffer &_buffer;
+        FieldStyle _style;
+        bool _first = true;
+        bool _full = false;
+};
+
+
+/* fields following the message arguments of a structured call */
+template <size_t Skip>
+struct SsFieldsAfter {
+    template <typename Type, typename ...Args>
+    static void write(SsFieldWriter &writer, const Type &, const Args &...rest);
+};
+
+template <>
+struct SsFieldsAfter<0> {
+    template <typename ...Fields>
+    static void write(SsFieldWriter &writer, const Fields &...fields);
+};
+
+
+// key, then value by type, then the remaining fields
+template <typename Type, typename ...Fields>
+void SsFieldWriter::fields(const SsLogField<Type> &field,
+                           const Fields &...rest) {
+    key(field.key);
+    if (_full) {
+        return;
+    }
+    value(field.value);
+    close();
+    fields(rest...);
+}
+
+// skip one message argument
+template <size_t Skip>
+template <typename Type, typename ...Args>
+void SsFieldsAfter<Skip>::write(SsFieldWriter &writer, const Type &,
+                                const Args &...rest) {
+    SsFieldsAfter<Skip - 1>::write(writer, rest...);
+}
+
+// only fields left
+template <typename ...Fields>
+void SsFieldsAfter<0>::write(SsFieldWriter &writer, const Fields &...fields) {
+    writer.fields(fields...);
+}
+
+// value picked by type category
+template <typename Type>
+void SsFieldWriter::value(const Type &value) {
+    this->value(value, KindTag<SsFormatBuffer::Kind<Type>::value>());
+}
+
+// durations as fractional milliseconds
+template <typename Rep, typename Period>
+void SsFieldWriter::value(const std::chrono::duration<Rep, Period> &value) {
+    number(std::chrono::duration<double, std::milli>(value).count());
+}
+
+// signed integer
+template <typename Type>
+void SsFieldWriter::value(const Type &value,
+                          KindTag<ArgumentKind::AK_SIGNED>) {
+    open();
+    _buffer.write(value, false);
+}
+
+// unsigned integer
+template <typename Type>
+void SsFieldWriter::value(const Type &value,
+                          KindTag<ArgumentKind::AK_UNSIGNED>) {
+    open();
+    _buffer.write(value, false);
+}
+
+// single character as a one character string
+template <typename Type>
+void SsFieldWriter::value(const Type &value,
+                          KindTag<ArgumentKind::AK_CHARACTER>) {
+    auto c = static_cast<char>(value);
+    string(&c, 1);
+}
+
+// floating point
+template <typename Type>
+void SsFieldWriter::value(const Type &value,
+                          KindTag<ArgumentKind::AK_FLOATING>) {
+    number(static_cast<double>(value));
+}
+
+// operator<< types are formatted first, then escaped as a string
+template <typename Type>
+void SsFieldWriter::value(const Type &value,
+                          KindTag<ArgumentKind::AK_STREAM>) {
+    SsFormatBuffer text;
+    text.write(value, false);
+    string(text.data(), text.size());
+}
+
+// lazy value, evaluated and written by its result type
+template <typename Type>
+void SsFieldWriter::value(const Type &value,
+                          KindTag<ArgumentKind::AK_LAZY>) {
+    this->value(value());
+}
+
+
+#endif // __SHADOWSOCKS_LOG_FIELDS_INCLUDED__
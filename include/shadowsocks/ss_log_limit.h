@@ -0,0 +1,41 @@
+#ifndef __SHADOWSOCKS_LOG_LIMIT_INCLUDED__
+#define __SHADOWSOCKS_LOG_LIMIT_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+/* token bucket of one call site, kept as the time the bucket is full again
+ * (GCRA), so taking a token is a single compare and swap */
+class SsLogLimit {
+    public:
+        SsLogLimit(double rate, unsigned burst);
+        SsLogLimit(const SsLogLimit&) = delete;
+        SsLogLimit &operator=(const SsLogLimit&) = delete;
+
+        bool acquire(uint64_t &suppressed);
+
+    private:
+        int64_t _interval;
+        int64_t _tolerance;
+        std::atomic<int64_t> _arrival{0};
+        std::atomic<uint64_t> _suppressed{0};
+};
+
+
+/* every n-th message of one call site */
+class SsLogSampler {
+    public:
+        explicit SsLogSampler(uint64_t every);
+        SsLogSampler(const SsLogSampler&) = delete;
+        SsLogSampler &operator=(const SsLogSampler&) = delete;
+
+        bool acquire(uint64_t &suppressed);
+
+    private:
+        uint64_t _every;
+        std::atomic<uint64_t> _count{0};
+};
+
+
+#endif // __SHADOWSOCKS_LOG_LIMIT_INCLUDED__
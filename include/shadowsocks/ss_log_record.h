@@ -0,0 +1,240 @@
+#ifndef __SHADOWSOCKS_LOG_RECORD_INCLUDED__
+#define __SHADOWSOCKS_LOG_RECORD_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_format.h"
+
+
+/**
+ * binary log stream, native byte order:
+ *   stream   [u8 RT_STREAM][u32 pid]
+ *   format   [u8 RT_FORMAT][u32 id][u16 length][length bytes]
+ *   message  [u8 RT_MESSAGE][u32 id][u8 level][i64 nanoseconds]
+ *            [u8 type][payload]... [u8 AT_END]
+ * format ids are per process, a stream record starts every write so forked
+ * workers can share a file, the records after it belong to that process,
+ * a format record precedes the first message of the process using its id
+ */
+
+
+/* binary log records, arguments are stored raw and formatted offline */
+class SsLogRecord {
+    public:
+        enum class RecordType : uint8_t {
+            RT_FORMAT   = 0x01,
+            RT_MESSAGE  = 0x02,
+            RT_STREAM   = 0x03
+        };
+
+        enum class ArgumentType : uint8_t {
+            AT_END          = 0x00,
+            AT_SIGNED       = 0x01,
+            AT_UNSIGNED     = 0x02,
+            AT_CHARACTER    = 0x03,
+            AT_STRING       = 0x04,
+            AT_FLOATING     = 0x05
+        };
+
+        enum : size_t {
+            MESSAGE_ID_OFFSET = 1,
+            MESSAGE_HEADER_SIZE = 14
+        };
+
+    public:
+        template <typename Fmt, typename ...Args>
+        static void encode(SsFormatBuffer &buffer, uint8_t level,
+                           const Args &...args);
+        static void encodeText(SsFormatBuffer &buffer, uint8_t level,
+                               const char *text, size_t size);
+        static void encodeFormat(std::string &out, uint32_t id);
+        static void encodeStream(std::string &out, uint32_t stream);
+        static uint32_t stream();
+        static uint32_t messageFormat(const char *record);
+
+        template <typename Fmt>
+        static uint32_t formatId();
+        static const char *format(uint32_t id);
+        static const char *textFormat();
+
+    private:
+        using ArgumentKind = SsFormatBuffer::ArgumentKind;
+
+        template <ArgumentKind K>
+        using KindTag = SsFormatBuffer::KindTag<K>;
+
+        static uint32_t registerFormat(const char *fmt);
+        static void encodeHeader(SsFormatBuffer &buffer, uint32_t id,
+                                 uint8_t level);
+
+        template <typename Fmt, size_t Index>
+        static void encodeArguments(SsFormatBuffer &buffer);
+        template <typename Fmt, size_t Index, typename Type, typename ...Args>
+        static void encodeArguments(SsFormatBuffer &buffer, const Type &value,
+                                    const Args &...args);
+
+        template <typename Type>
+        static void encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                   bool hex, KindTag<ArgumentKind::AK_SIGNED>);
+        template <typename Type>
+        static void encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                   bool hex, KindTag<ArgumentKind::AK_UNSIGNED>);
+        template <typename Type>
+        static void encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                   bool hex, KindTag<ArgumentKind::AK_CHARACTER>);
+        template <typename Type>
+        static void encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                   bool hex, KindTag<ArgumentKind::AK_FLOATING>);
+        template <typename Type>
+        static void encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                   bool hex, KindTag<ArgumentKind::AK_STREAM>);
+        template <typename Type>
+        static void encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                   bool hex, KindTag<ArgumentKind::AK_LAZY>);
+        static void encodeArgument(SsFormatBuffer &buffer, const char *value,
+                                   bool hex, KindTag<ArgumentKind::AK_STRING>);
+        static void encodeArgument(SsFormatBuffer &buffer,
+                                   const std::string &value, bool hex,
+                                   KindTag<ArgumentKind::AK_STRING>);
+
+        static void encodeValue(SsFormatBuffer &buffer, ArgumentType type,
+                                const void *value, size_t size);
+        static void encodeString(SsFormatBuffer &buffer,
+                                 const char *value, size_t size);
+
+    private:
+        static std::mutex _mutex;
+        static std::vector<const char*> _formats;
+        static std::atomic<uint32_t> _stream;
+};
+
+
+/* decodes a binary log stream back to text lines */
+class SsLogRecordReader {
+    public:
+        explicit SsLogRecordReader(std::istream &in);
+
+        bool next(std::string &line);
+
+    private:
+        using ArgumentType = SsLogRecord::ArgumentType;
+
+        struct Argument {
+            ArgumentType type;
+            int64_t signedValue;
+            uint64_t unsignedValue;
+            double floatingValue;
+            std::string stringValue;
+        };
+
+        void readStream();
+        void readFormat();
+        void readMessage(std::string &line);
+        void readArguments(std::vector<Argument> &arguments);
+        void read(void *data, size_t size);
+        static void writeArgument(SsFormatBuffer &buffer,
+                                  const Argument &argument, bool hex);
+
+    private:
+        std::istream &_input;
+        uint32_t _stream = 0;
+        std::map<std::pair<uint32_t, uint32_t>, std::string> _formats;
+};
+
+
+// id of a literal format, registered on first use of the call site
+template <typename Fmt>
+uint32_t SsLogRecord::formatId() {
+    static const uint32_t id = registerFormat(Fmt::str());
+    return id;
+}
+
+// header then raw arguments, nothing is formatted except operator<< types
+template <typename Fmt, typename ...Args>
+void SsLogRecord::encode(SsFormatBuffer &buffer, uint8_t level,
+                         const Args &...args) {
+    static_assert(SsFormat<Fmt>::PLACEHOLDERS == sizeof...(Args),
+                  "format placeholders and arguments count differ");
+
+    encodeHeader(buffer, formatId<Fmt>(), level);
+    encodeArguments<Fmt, 0>(buffer, args...);
+}
+
+// all arguments written, close the record
+template <typename Fmt, size_t Index>
+void SsLogRecord::encodeArguments(SsFormatBuffer &buffer) {
+    buffer.append(static_cast<char>(ArgumentType::AT_END));
+}
+
+// one argument, hex is known from the format at compile time
+template <typename Fmt, size_t Index, typename Type, typename ...Args>
+void SsLogRecord::encodeArguments(SsFormatBuffer &buffer, const Type &value,
+                                  const Args &...args) {
+    using Kind = SsFormatBuffer::Kind<Type>;
+
+    encodeArgument(buffer, value, formatHex(Fmt::str(), Index),
+                   KindTag<Kind::value>());
+    encodeArguments<Fmt, Index + 1>(buffer, args...);
+}
+
+// signed integer widened to 64 bits
+template <typename Type>
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                 bool hex, KindTag<ArgumentKind::AK_SIGNED>) {
+    // hex shows the two's complement of the original width
+    if (hex) {
+        uint64_t bits = static_cast<typename std::make_unsigned<Type>::type>(
+            value);
+        encodeValue(buffer, ArgumentType::AT_UNSIGNED, &bits, sizeof(bits));
+    } else {
+        int64_t widened = value;
+        encodeValue(buffer, ArgumentType::AT_SIGNED,
+                    &widened, sizeof(widened));
+    }
+}
+
+// unsigned integer and bool widened to 64 bits
+template <typename Type>
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                 bool hex, KindTag<ArgumentKind::AK_UNSIGNED>) {
+    uint64_t widened = value;
+    encodeValue(buffer, ArgumentType::AT_UNSIGNED, &widened, sizeof(widened));
+}
+
+// single character
+template <typename Type>
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                 bool hex,
+                                 KindTag<ArgumentKind::AK_CHARACTER>) {
+    auto c = static_cast<char>(value);
+    encodeValue(buffer, ArgumentType::AT_CHARACTER, &c, sizeof(c));
+}
+
+// floating point as double
+template <typename Type>
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                 bool hex, KindTag<ArgumentKind::AK_FLOATING>) {
+    double widened = value;
+    encodeValue(buffer, ArgumentType::AT_FLOATING, &widened, sizeof(widened));
+}
+
+// operator<< types have no raw form, formatted now and stored as string
+template <typename Type>
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                 bool hex, KindTag<ArgumentKind::AK_STREAM>) {
+    SsFormatBuffer text;
+    text.write(value, hex);
+    encodeString(buffer, text.data(), text.size());
+}
+
+// lazy argument, the result is stored like any other argument
+template <typename Type>
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const Type &value,
+                                 bool hex, KindTag<ArgumentKind::AK_LAZY>) {
+    const auto &result = value();
+    encodeArgument(buffer, result, hex,
+                   KindTag<SsFormatBuffer::Kind<decltype(result)>::value>());
+}
+
+
+#endif // __SHADOWSOCKS_LOG_RECORD_INCLUDED__
@@ -0,0 +1,95 @@
+#ifndef __SHADOWSOCKS_LOG_RING_INCLUDED__
+#define __SHADOWSOCKS_LOG_RING_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+#define LOG_RING_SIZE                   (256 * 1024)
+#define LOG_RING_CACHE_LINE             (64)
+
+
+/* lock-free ring of log records, one producer thread and the writer thread */
+class SsLogRing {
+    public:
+        explicit SsLogRing(size_t capacity = LOG_RING_SIZE);
+        SsLogRing(const SsLogRing&) = delete;
+        SsLogRing &operator=(const SsLogRing&) = delete;
+
+        bool push(uint8_t level, uint8_t encoding, time_t time,
+                  const char *message, size_t size);
+        template <typename Visitor>
+        size_t drain(Visitor visitor);
+
+        size_t capacity() const;
+        size_t used() const;
+        void drop();
+        uint64_t dropped() const;
+        void close();
+        bool closed() const;
+
+    private:
+        struct Header {
+            uint32_t size;
+            uint8_t level;
+            uint8_t encoding;
+            int64_t time;
+        };
+
+        enum : uint32_t {
+            RECORD_SKIP = UINT32_MAX
+        };
+
+        static size_t recordSize(size_t size);
+
+    private:
+        std::unique_ptr<char[]> _data;
+        size_t _capacity;
+        std::atomic<bool> _closed{false};
+
+        // consumer and producer positions on their own cache lines
+        char _consumerLine[LOG_RING_CACHE_LINE];
+        std::atomic<size_t> _head{0};
+        char _producerLine[LOG_RING_CACHE_LINE];
+        std::atomic<size_t> _tail{0};
+        std::atomic<uint64_t> _dropped{0};
+};
+
+
+// call visitor(level, encoding, time, message, size) for every record,
+// then free them
+template <typename Visitor>
+size_t SsLogRing::drain(Visitor visitor) {
+    auto head = _head.load(std::memory_order_relaxed);
+    auto tail = _tail.load(std::memory_order_acquire);
+
+    size_t records = 0;
+    while (head != tail) {
+        auto offset = head & (_capacity - 1);
+        auto contiguous = _capacity - offset;
+        if (contiguous < sizeof(Header)) {
+            head += contiguous;
+            continue;
+        }
+
+        Header header;
+        std::memcpy(&header, _data.get() + offset, sizeof(Header));
+        if (header.size == RECORD_SKIP) {
+            head += contiguous;
+            continue;
+        }
+
+        visitor(header.level, header.encoding,
+                static_cast<time_t>(header.time),
+                _data.get() + offset + sizeof(Header),
+                static_cast<size_t>(header.size));
+        head += recordSize(header.size);
+        ++records;
+    }
+
+    _head.store(head, std::memory_order_release);
+    return records;
+}
+
+
+#endif // __SHADOWSOCKS_LOG_RING_INCLUDED__
@@ -3,52 +3,19 @@
 
 
 #include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_format.h"
+#include "shadowsocks/ss_log_ring.h"
+#include "shadowsocks/ss_log_record.h"
+#include "shadowsocks/ss_log_fields.h"
+#include "shadowsocks/ss_log_limit.h"
+#include "shadowsocks/ss_flight_recorder.h"
+#include "shadowsocks/ss_rcu.h"
 
 
-/* runtime get index of tuple */
-template <size_t I>
-struct VisitImpl {
-    template <typename Type, typename Func>
-    static void visit(Type &tuple, size_t idx, Func func) {
-        if (idx == I - 1) {
-            func(std::get<I - 1>(tuple));
-        } else {
-            VisitImpl<I - 1>::visit(tuple, idx, func);
-        }
-    }
-};
-
-template <>
-struct VisitImpl<0> {
-    template <typename Type, typename F>
-    static void visit(Type &tuple, size_t idx, F fun) {
-        assert(false);
-    }
-};
-
-template <typename Func, typename ...Types>
-void visit(const std::tuple<Types...> &tuple, size_t idx, Func func) {
-    VisitImpl<sizeof...(Types)>::visit(tuple, idx, func);
-}
-
-class TupleElementPrinter {
-    public:
-        explicit TupleElementPrinter(std::ostream &out);
-        void setFlag(std::ios::fmtflags flags);
-
-        template<typename tuple>
-        void operator()(tuple value) {
-            _output << value;
-            if (_defaultFlags) {
-                _output.setf(_defaultFlags);
-                _defaultFlags = static_cast<std::ios_base::fmtflags>(0);
-            }
-        }
-
-    private:
-        std::ostream &_output;
-        std::ios::fmtflags _defaultFlags;
-};
+#define LOGGER_BATCH_SIZE               (64 * 1024)
+#define LOGGER_ASYNC_INTERVAL           (20)
+#define LOGGER_RING_MIN_SIZE            (8 * FORMAT_BUFFER_SIZE)
+#define LOGGER_ENCODINGS                (5)
 
 
 class SsLogger {
@@ -62,9 +29,23 @@ class SsLogger {
             LL_EMERGENCY    = 0xff
         };
 
+        enum class AsyncPolicy : uint8_t {
+            AP_DROP_ON_FULL,
+            AP_BLOCK_ON_FULL
+        };
+
+        enum class LoggerEncoding : uint8_t {
+            LE_TEXT,
+            LE_BINARY,
+            LE_LOGFMT,
+            LE_JSON,
+            LE_JOURNAL
+        };
+
         using Format = const char *;
         using LoggerName = const char *;
         using SsLoggerPtr = std::shared_ptr<SsLogger>;
+        using LoggerMap = std::map<LoggerName, SsLoggerPtr>;
 
     public:
         explicit SsLogger(std::ostream &out);
@@ -72,44 +53,151 @@ class SsLogger {
 
         void setLevel(LoggerLevel level);
         void setName(LoggerName name);
+        void setEncoding(LoggerEncoding encoding);
         static void addLogger(LoggerName name, SsLoggerPtr logger);
         static bool removeLogger(LoggerName name);
+        static bool enabled(LoggerLevel level);
+        static const char *levelName(LoggerLevel level);
+
+        static void enableAsync(AsyncPolicy policy,
+                                size_t ringSize = LOG_RING_SIZE);
+        static void disableAsync();
+        static bool asyncEnabled();
+        static bool suspendAsync();
+        static void resumeAsync();
+        static uint64_t dropped();
+
+        static void enableFlightRecorder(LoggerLevel level,
+                                         const std::string &path);
+        static void disableFlightRecorder();
+        static bool dumpFlightRecorder();
 
         template <typename ...Args>
-        static void verbose(Format fmt, Args ...args);
+        static void verbose(Format fmt, Args &&...args);
 
         template <typename ...Args>
-        static void debug(Format fmt, Args ...args);
+        static void debug(Format fmt, Args &&...args);
 
         template <typename ...Args>
-        static void info(Format fmt, Args ...args);
+        static void info(Format fmt, Args &&...args);
 
         template <typename ...Args>
-        static void warning(Format fmt, Args ...args);
+        static void warning(Format fmt, Args &&...args);
 
         template <typename ...Args>
-        static void error(Format fmt, Args ...args);
+        static void error(Format fmt, Args &&...args);
 
         template <typename ...Args>
-        static void emergency(Format fmt, Args ...args);
+        static void emergency(Format fmt, Args &&...args);
 
         template <typename ...Args>
         static std::string log(SsLogger::LoggerLevel level,
-                               Format fmt, Args ...args);
+                               Format fmt, Args &&...args);
 
         template <typename ...Args>
-        static std::string format(Format fmt, Args ...args);
+        static std::string format(Format fmt, Args &&...args);
+
+        template <typename Fmt, typename ...Args>
+        static void logFormat(LoggerLevel level, const Args &...args);
+
+        template <typename Fmt, typename ...Args>
+        static void logFields(LoggerLevel level, const Args &...args);
+
+        template <typename Fmt, typename ...Args>
+        static typename std::enable_if<
+            SsFormat<Fmt>::PLACEHOLDERS == sizeof...(Args), int
+        >::type discard(const Args &...args);
+
+        template <typename Fmt, typename ...Args>
+        static typename std::enable_if<
+            SsFormat<Fmt>::PLACEHOLDERS <= sizeof...(Args), int
+        >::type discardFields(const Args &...args);
 
     private:
-        static std::string currentDate(Format fmt);
-        static void log(LoggerLevel level, std::string message);
+        static void emergencyExit();
+        static void log(LoggerLevel level, const char *message, size_t size);
+        template <typename ...Args>
+        static void logRuntime(LoggerLevel level, Format fmt,
+                               const Args &...args);
+        static bool enabled(LoggerLevel level, LoggerEncoding encoding);
+        static bool enabledMessage(LoggerLevel level);
+        static void writeMessage(LoggerLevel level,
+                                 const char *message, size_t size);
+        static SsFieldWriter::FieldStyle fieldStyle(LoggerEncoding encoding);
+        static void messagePayload(LoggerEncoding encoding,
+                                   SsFormatBuffer &payload,
+                                   const char *message, size_t size);
+        template <size_t Skip, typename ...Args>
+        static void writeFields(LoggerLevel level, LoggerEncoding encoding,
+                                const SsFormatBuffer &message,
+                                const Args &...args);
+        static void write(LoggerLevel level, LoggerEncoding encoding,
+                          const char *message, size_t size);
+        static void writeSync(LoggerLevel level, LoggerEncoding encoding,
+                              time_t time, const char *message, size_t size);
+        static bool writeAsync(LoggerLevel level, LoggerEncoding encoding,
+                               time_t time, const char *message, size_t size);
+        static void deliver(LoggerLevel level, LoggerEncoding encoding,
+                            time_t time, const char *message, size_t size);
+        static SsLogRing *threadRing();
+        static void asyncWriter();
+        static void drainRings();
+        static void updateThreshold();
+
+        bool accepts(LoggerLevel level, LoggerEncoding encoding) const;
+        void appendRecord(const char *record, size_t size);
+        const std::string &currentDate(time_t time);
+        void localTime(time_t time, std::tm &local);
+        void writeBatch();
+        void flush();
+
+    protected:
+        virtual void append(LoggerLevel level, time_t time,
+                            const char *message, size_t size);
+        void appendBatch(const char *data, size_t size);
+        void encodeFormats(std::string &out) const;
+        time_t utcOffset(time_t time);
+        static int syslogPriority(LoggerLevel level);
 
     private:
         LoggerName _name = nullptr;
         std::ostream &_output;
-        std::string _dateFormat = "%A %b %d %H:%M:%S %Y \t->\t ";
-        LoggerLevel _level = LoggerLevel::LL_INFO;
-        static std::map<SsLogger::LoggerName, SsLogger::SsLoggerPtr> _loggers;
+        std::atomic<LoggerLevel> _level{LoggerLevel::LL_INFO};
+        std::atomic<LoggerEncoding> _encoding{LoggerEncoding::LE_TEXT};
+
+        // output state, guarded by _lock, loggers never share a lock
+        std::mutex _lock;
+        std::string _dateFormat;
+        std::string _date;
+        time_t _dateTime = 0;
+        std::string _batch;
+        std::vector<bool> _formats;
+        uint32_t _stream = 0;
+
+        // utc offset of local time, valid within [_offsetBegin, _offsetEnd)
+        time_t _utcOffset = 0;
+        time_t _offsetBegin = 0;
+        time_t _offsetEnd = 0;
+        int _offsetDst = 0;
+
+        // registry is read without locks, _mutex serializes its writers,
+        // thresholds and the async state
+        static std::mutex _mutex;
+        static SsRcu<LoggerMap> _loggers;
+        static std::atomic<uint8_t> _threshold;
+        static std::atomic<uint8_t> _thresholds[LOGGER_ENCODINGS];
+
+        // async mode, rings are drained by the writer thread under _mutex
+        static std::atomic<bool> _async;
+        static std::atomic<AsyncPolicy> _policy;
+        static std::atomic<bool> _pending;
+        static size_t _ringSize;
+        static bool _stopping;
+        static uint64_t _reportedDrops;
+        static uint64_t _retiredDrops;
+        static std::vector<std::shared_ptr<SsLogRing>> _rings;
+        static std::condition_variable _wakeup;
+        static std::thread _writer;
 
     friend std::ostream &operator<<(std::ostream &out, SsLogger *logger);
 };
@@ -119,108 +207,354 @@ class SsLogger {
 std::ostream &operator<<(std::ostream &out, const SsLogger::LoggerLevel &level);
 
 
+// any registered logger accepts level, read before anything is formatted,
+// levels below the compiled minimum fold to false
+inline bool SsLogger::enabled(SsLogger::LoggerLevel level) {
+    return static_cast<uint8_t>(level) >= LOGGER_COMPILED_LEVEL &&
+           static_cast<uint8_t>(level) >=
+               _threshold.load(std::memory_order_relaxed);
+}
+
+// a logger with this encoding accepts level
+inline bool SsLogger::enabled(SsLogger::LoggerLevel level,
+                              SsLogger::LoggerEncoding encoding) {
+    auto &threshold = _thresholds[static_cast<size_t>(encoding)];
+    return static_cast<uint8_t>(level) >= LOGGER_COMPILED_LEVEL &&
+           static_cast<uint8_t>(level) >=
+               threshold.load(std::memory_order_relaxed);
+}
+
+// a logger taking free text messages accepts level, binary ones take records
+inline bool SsLogger::enabledMessage(SsLogger::LoggerLevel level) {
+    return enabled(level, LoggerEncoding::LE_TEXT) ||
+           enabled(level, LoggerEncoding::LE_LOGFMT) ||
+           enabled(level, LoggerEncoding::LE_JSON) ||
+           enabled(level, LoggerEncoding::LE_JOURNAL);
+}
+
 // all the things that happened
 template<typename ...Args>
-void SsLogger::verbose(SsLogger::Format fmt, Args... args) {
-    log(LoggerLevel::LL_VERBOSE, format(fmt, args...));
+void SsLogger::verbose(SsLogger::Format fmt, Args &&...args) {
+    if (enabled(LoggerLevel::LL_VERBOSE)) {
+        logRuntime(LoggerLevel::LL_VERBOSE, fmt, args...);
+    }
 }
 
 // detailed debug information
 template<typename ...Args>
-void SsLogger::debug(SsLogger::Format fmt, Args... args) {
-    log(LoggerLevel::LL_DEBUG, format(fmt, args...));
+void SsLogger::debug(SsLogger::Format fmt, Args &&...args) {
+    if (enabled(LoggerLevel::LL_DEBUG)) {
+        logRuntime(LoggerLevel::LL_DEBUG, fmt, args...);
+    }
 }
 
 // interesting events.
 template<typename ...Args>
-void SsLogger::info(SsLogger::Format fmt, Args... args) {
-    log(LoggerLevel::LL_INFO, format(fmt, args...));
+void SsLogger::info(SsLogger::Format fmt, Args &&...args) {
+    if (enabled(LoggerLevel::LL_INFO)) {
+        logRuntime(LoggerLevel::LL_INFO, fmt, args...);
+    }
 }
 
 // exceptional occurrences that are not errors.
 template<typename ...Args>
-void SsLogger::warning(SsLogger::Format fmt, Args... args) {
-    log(LoggerLevel::LL_WARNING, format(fmt, args...));
+void SsLogger::warning(SsLogger::Format fmt, Args &&...args) {
+    if (enabled(LoggerLevel::LL_WARNING)) {
+        logRuntime(LoggerLevel::LL_WARNING, fmt, args...);
+    }
 }
 
 // runtime errors that do not require immediate action but should typically
 // be logged and monitored.
 template<typename ...Args>
-void SsLogger::error(SsLogger::Format fmt, Args... args) {
-    log(LoggerLevel::LL_ERROR, format(fmt, args...));
+void SsLogger::error(SsLogger::Format fmt, Args &&...args) {
+    if (enabled(LoggerLevel::LL_ERROR)) {
+        logRuntime(LoggerLevel::LL_ERROR, fmt, args...);
+    }
 }
 
 // system is unusable, will be exit
 template<typename ...Args>
-void SsLogger::emergency(SsLogger::Format fmt, Args... args) {
-    log(LoggerLevel::LL_EMERGENCY, format(fmt, args...));
-    std::exit(OPERATOR_FAILURE);
+void SsLogger::emergency(SsLogger::Format fmt, Args &&...args) {
+    if (enabled(LoggerLevel::LL_EMERGENCY)) {
+        logRuntime(LoggerLevel::LL_EMERGENCY, fmt, args...);
+    }
+    emergencyExit();
 }
 
-// custom log message and return message
+// custom log message and return message, always formatted
 template<typename ...Args>
 std::string SsLogger::log(SsLogger::LoggerLevel level,
-                          SsLogger::Format fmt, Args... args) {
-    std::string message = format(fmt, args...);
+                          SsLogger::Format fmt, Args &&...args) {
+    SsFormatBuffer buffer;
+    formatRuntime(buffer, fmt, args...);
 
-    log(level, message);
+    if (enabled(level)) {
+        log(level, buffer.data(), buffer.size());
+    }
     if (level == SsLogger::LoggerLevel::LL_EMERGENCY) {
-        std::exit(OPERATOR_FAILURE);
+        emergencyExit();
     }
 
-    return message;
+    return buffer.str();
 }
 
-// format parameters and output it
+// format parameters at runtime, for formats that are not literals
 template<typename ...Args>
-std::string SsLogger::format(Format fmt, Args... args) {
-    std::stringstream ss;
-    TupleElementPrinter printer(ss);
-
-    auto tuple = std::make_tuple(args...);
-    size_t tupleSize = std::tuple_size<std::tuple<Args...>>::value;
-
-    size_t index = 0;
-    auto output = [&] (size_t &i) {
-        if (index < tupleSize) {
-            visit(tuple, index++, printer);
-            while (isalnum(fmt[++i])) {
-                ;
-            }
-            --i;
-        } else {
-            printer('%');
+std::string SsLogger::format(Format fmt, Args &&...args) {
+    SsFormatBuffer buffer;
+    formatRuntime(buffer, fmt, args...);
+
+    return buffer.str();
+}
+
+// runtime format written into a fixed buffer, no string is built
+template <typename ...Args>
+void SsLogger::logRuntime(SsLogger::LoggerLevel level, SsLogger::Format fmt,
+                          const Args &...args) {
+    SsFormatBuffer buffer;
+    formatRuntime(buffer, fmt, args...);
+    log(level, buffer.data(), buffer.size());
+}
+
+// literal format parsed at compile time, binary loggers get raw arguments
+// and text loggers a message formatted into a fixed buffer
+template <typename Fmt, typename ...Args>
+void SsLogger::logFormat(SsLogger::LoggerLevel level, const Args &...args) {
+    if (SsFlightRecorder::enabled(static_cast<uint8_t>(level))) {
+        SsFlightRecorder::record<Fmt>(static_cast<uint8_t>(level), args...);
+    }
+
+    if (enabled(level, LoggerEncoding::LE_BINARY)) {
+        SsFormatBuffer record;
+        SsLogRecord::encode<Fmt>(record, static_cast<uint8_t>(level), args...);
+        write(level, LoggerEncoding::LE_BINARY, record.data(), record.size());
+    }
+
+    if (enabledMessage(level)) {
+        SsFormatBuffer buffer;
+        SsFormat<Fmt>::write(buffer, args...);
+        writeMessage(level, buffer.data(), buffer.size());
+    }
+
+    if (level == LoggerLevel::LL_EMERGENCY) {
+        emergencyExit();
+    }
+}
+
+// literal message and its arguments, then typed fields, structured loggers
+// get the fields in their own syntax, text and binary ones as logfmt
+// after the message
+template <typename Fmt, typename ...Args>
+void SsLogger::logFields(SsLogger::LoggerLevel level, const Args &...args) {
+    static_assert(SsFormat<Fmt>::PLACEHOLDERS <= sizeof...(Args),
+                  "format placeholders outnumber the arguments");
+    constexpr size_t placeholders = SsFormat<Fmt>::PLACEHOLDERS;
+
+    SsFormatBuffer message;
+    SsFormatStep<Fmt, 0, 0>::write(message, std::tie(args...));
+
+    auto text = enabled(level, LoggerEncoding::LE_TEXT);
+    auto binary = enabled(level, LoggerEncoding::LE_BINARY);
+    auto recorded = SsFlightRecorder::enabled(static_cast<uint8_t>(level));
+    if (text || binary || recorded) {
+        SsFormatBuffer buffer;
+        buffer.append(message.data(), message.size());
+        if (sizeof...(Args) > placeholders) {
+            buffer.append(' ');
+        }
+
+        SsFieldWriter writer(buffer, SsFieldWriter::FieldStyle::FS_LOGFMT);
+        SsFieldsAfter<placeholders>::write(writer, args...);
+
+        if (recorded) {
+            SsFlightRecorder::record(static_cast<uint8_t>(level),
+                                     buffer.data(), buffer.size());
+        }
+        if (binary) {
+            SsFormatBuffer record;
+            SsLogRecord::encodeText(record, static_cast<uint8_t>(level),
+                                    buffer.data(), buffer.size());
+            write(level, LoggerEncoding::LE_BINARY,
+                  record.data(), record.size());
         }
-    };
-
-    for (size_t i = 0; i < strlen(fmt); ++i) {
-        if (fmt[i] != '%') {
-            ss << fmt[i];
-        } else {
-            /**
-             * @todo hex oct and dec
-             */
-            switch (fmt[i + 1]) {
-                case '%': ss << fmt[i++]; break;  // escape %
-                case 'x': {
-                    ss << "0x";
-                    printer.setFlag(std::ios::hex);
-                }
-                default: output(++i);
-            }
+        if (text) {
+            write(level, LoggerEncoding::LE_TEXT, buffer.data(), buffer.size());
         }
     }
 
-    return ss.str();
+    writeFields<placeholders>(level, LoggerEncoding::LE_LOGFMT,
+                              message, args...);
+    writeFields<placeholders>(level, LoggerEncoding::LE_JSON,
+                              message, args...);
+    writeFields<placeholders>(level, LoggerEncoding::LE_JOURNAL,
+                              message, args...);
+
+    if (level == LoggerLevel::LL_EMERGENCY) {
+        emergencyExit();
+    }
+}
+
+// message and fields serialized for one structured encoding
+template <size_t Skip, typename ...Args>
+void SsLogger::writeFields(SsLogger::LoggerLevel level,
+                           SsLogger::LoggerEncoding encoding,
+                           const SsFormatBuffer &message,
+                           const Args &...args) {
+    if (!enabled(level, encoding)) {
+        return;
+    }
+
+    SsFormatBuffer payload;
+    SsFieldWriter writer(payload, fieldStyle(encoding));
+    writer.message(message.data(), message.size());
+    SsFieldsAfter<Skip>::write(writer, args...);
+
+    write(level, encoding, payload.data(), payload.size());
 }
 
 
-#define VVV(FMT, ARGS...)           SsLogger::verbose(FMT, ##ARGS)
-#define DBG(FMT, ARGS...)           SsLogger::debug(FMT, ##ARGS)
-#define INF(FMT, ARGS...)           SsLogger::info(FMT, ##ARGS)
-#define WARN(FMT, ARGS...)          SsLogger::warning(FMT, ##ARGS)
-#define ERR(FMT, ARGS...)           SsLogger::error(FMT, ##ARGS)
-#define EXT(FMT, ARGS...)           SsLogger::emergency(FMT, ##ARGS)
+/* level is checked before any argument is evaluated, format is parsed and
+ * checked against the arguments at compile time */
+#define LOGGER_GATED(LEVEL, FMT, ARGS...)                                     \
+    do {                                                                      \
+        if (SsLogger::enabled(SsLogger::LoggerLevel::LEVEL)) {                \
+            FORMAT_LITERAL(LoggerFormat, FMT);                                \
+            SsLogger::logFormat<LoggerFormat>(                                \
+                SsLogger::LoggerLevel::LEVEL, ##ARGS);                        \
+        }                                                                     \
+    } while (0)
+
+/* same for structured calls, typed fields follow the format arguments */
+#define LOGGER_FIELDS(LEVEL, FMT, ARGS...)                                    \
+    do {                                                                      \
+        if (SsLogger::enabled(SsLogger::LoggerLevel::LEVEL)) {                \
+            FORMAT_LITERAL(LoggerFormat, FMT);                                \
+            SsLogger::logFields<LoggerFormat>(                                \
+                SsLogger::LoggerLevel::LEVEL, ##ARGS);                        \
+        }                                                                     \
+    } while (0)
+
+/* only messages LIMITER lets through are formatted, the first one after a
+ * suppressed run reports how many were left out */
+#define LOGGER_THROTTLED(LEVEL, LIMITER, FMT, ARGS...)                        \
+    do {                                                                      \
+        uint64_t loggerSuppressed = 0;                                        \
+        if (SsLogger::enabled(SsLogger::LoggerLevel::LEVEL) &&                \
+                (LIMITER).acquire(loggerSuppressed)) {                        \
+            if (loggerSuppressed == 0) {                                      \
+                FORMAT_LITERAL(LoggerFormat, FMT);                            \
+                SsLogger::logFormat<LoggerFormat>(                            \
+                    SsLogger::LoggerLevel::LEVEL, ##ARGS);                    \
+            } else {                                                          \
+                FORMAT_LITERAL(LoggerFormat,                                  \
+                               FMT " (suppressed %d messages)");              \
+                SsLogger::logFormat<LoggerFormat>(                            \
+                    SsLogger::LoggerLevel::LEVEL, ##ARGS, loggerSuppressed);  \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+/* token bucket per call site, RATE messages per second after BURST */
+#define LOGGER_LIMITED(LEVEL, RATE, BURST, FMT, ARGS...)                      \
+    do {                                                                      \
+        static SsLogLimit loggerLimit(RATE, BURST);                           \
+        LOGGER_THROTTLED(LEVEL, loggerLimit, FMT, ##ARGS);                    \
+    } while (0)
+
+/* one in EVERY messages per call site */
+#define LOGGER_SAMPLED(LEVEL, EVERY, FMT, ARGS...)                            \
+    do {                                                                      \
+        static SsLogSampler loggerSampler(EVERY);                             \
+        LOGGER_THROTTLED(LEVEL, loggerSampler, FMT, ##ARGS);                  \
+    } while (0)
+
+/* below LOGGER_COMPILED_LEVEL, only a lambda that is never called remains:
+ * the format and arguments are still checked, but nothing is evaluated or
+ * emitted, discard() is never defined, unlike sizeof this accepts lazy
+ * arguments built from lambdas */
+#define LOGGER_DISCARDED(FMT, ARGS...)                                        \
+    do {                                                                      \
+        FORMAT_LITERAL(LoggerFormat, FMT);                                    \
+        static_cast<void>([&] () {                                            \
+            SsLogger::discard<LoggerFormat>(ARGS);                            \
+        });                                                                   \
+    } while (0)
+
+#define LOGGER_FIELDS_DISCARDED(FMT, ARGS...)                                 \
+    do {                                                                      \
+        FORMAT_LITERAL(LoggerFormat, FMT);                                    \
+        static_cast<void>([&] () {                                            \
+            SsLogger::discardFields<LoggerFormat>(ARGS);                      \
+        });                                                                   \
+    } while (0)
+
+#if LOGGER_COMPILED_LEVEL <= 0x00
+#define VVV(FMT, ARGS...)           LOGGER_GATED(LL_VERBOSE, FMT, ##ARGS)
+#define VVV_FIELDS(FMT, ARGS...)    LOGGER_FIELDS(LL_VERBOSE, FMT, ##ARGS)
+#else
+#define VVV(FMT, ARGS...)           LOGGER_DISCARDED(FMT, ##ARGS)
+#define VVV_FIELDS(FMT, ARGS...)    LOGGER_FIELDS_DISCARDED(FMT, ##ARGS)
+#endif
+
+#if LOGGER_COMPILED_LEVEL <= 0x10
+#define DBG(FMT, ARGS...)           LOGGER_GATED(LL_DEBUG, FMT, ##ARGS)
+#define DBG_FIELDS(FMT, ARGS...)    LOGGER_FIELDS(LL_DEBUG, FMT, ##ARGS)
+#else
+#define DBG(FMT, ARGS...)           LOGGER_DISCARDED(FMT, ##ARGS)
+#define DBG_FIELDS(FMT, ARGS...)    LOGGER_FIELDS_DISCARDED(FMT, ##ARGS)
+#endif
+
+#if LOGGER_COMPILED_LEVEL <= 0x20
+#define INF(FMT, ARGS...)           LOGGER_GATED(LL_INFO, FMT, ##ARGS)
+#define INF_FIELDS(FMT, ARGS...)    LOGGER_FIELDS(LL_INFO, FMT, ##ARGS)
+#define INF_LIMIT(RATE, BURST, FMT, ARGS...) \
+    LOGGER_LIMITED(LL_INFO, RATE, BURST, FMT, ##ARGS)
+#define INF_SAMPLE(EVERY, FMT, ARGS...) \
+    LOGGER_SAMPLED(LL_INFO, EVERY, FMT, ##ARGS)
+#else
+#define INF(FMT, ARGS...)           LOGGER_DISCARDED(FMT, ##ARGS)
+#define INF_FIELDS(FMT, ARGS...)    LOGGER_FIELDS_DISCARDED(FMT, ##ARGS)
+#define INF_LIMIT(RATE, BURST, FMT, ARGS...) \
+    LOGGER_DISCARDED(FMT, ##ARGS)
+#define INF_SAMPLE(EVERY, FMT, ARGS...) \
+    LOGGER_DISCARDED(FMT, ##ARGS)
+#endif
+
+#if LOGGER_COMPILED_LEVEL <= 0x40
+#define WARN(FMT, ARGS...)          LOGGER_GATED(LL_WARNING, FMT, ##ARGS)
+#define WARN_FIELDS(FMT, ARGS...)   LOGGER_FIELDS(LL_WARNING, FMT, ##ARGS)
+#define WARN_LIMIT(RATE, BURST, FMT, ARGS...) \
+    LOGGER_LIMITED(LL_WARNING, RATE, BURST, FMT, ##ARGS)
+#define WARN_SAMPLE(EVERY, FMT, ARGS...) \
+    LOGGER_SAMPLED(LL_WARNING, EVERY, FMT, ##ARGS)
+#else
+#define WARN(FMT, ARGS...)          LOGGER_DISCARDED(FMT, ##ARGS)
+#define WARN_FIELDS(FMT, ARGS...)   LOGGER_FIELDS_DISCARDED(FMT, ##ARGS)
+#define WARN_LIMIT(RATE, BURST, FMT, ARGS...) \
+    LOGGER_DISCARDED(FMT, ##ARGS)
+#define WARN_SAMPLE(EVERY, FMT, ARGS...) \
+    LOGGER_DISCARDED(FMT, ##ARGS)
+#endif
+
+#if LOGGER_COMPILED_LEVEL <= 0x80
+#define ERR(FMT, ARGS...)           LOGGER_GATED(LL_ERROR, FMT, ##ARGS)
+#define ERR_FIELDS(FMT, ARGS...)    LOGGER_FIELDS(LL_ERROR, FMT, ##ARGS)
+#define ERR_LIMIT(RATE, BURST, FMT, ARGS...) \
+    LOGGER_LIMITED(LL_ERROR, RATE, BURST, FMT, ##ARGS)
+#define ERR_SAMPLE(EVERY, FMT, ARGS...) \
+    LOGGER_SAMPLED(LL_ERROR, EVERY, FMT, ##ARGS)
+#else
+#define ERR(FMT, ARGS...)           LOGGER_DISCARDED(FMT, ##ARGS)
+#define ERR_FIELDS(FMT, ARGS...)    LOGGER_FIELDS_DISCARDED(FMT, ##ARGS)
+#define ERR_LIMIT(RATE, BURST, FMT, ARGS...) \
+    LOGGER_DISCARDED(FMT, ##ARGS)
+#define ERR_SAMPLE(EVERY, FMT, ARGS...) \
+    LOGGER_DISCARDED(FMT, ##ARGS)
+#endif
+
+// emergency exits the process, it is never compiled out
+#define EXT(FMT, ARGS...)           LOGGER_GATED(LL_EMERGENCY, FMT, ##ARGS)
 
 
 #endif // __SHADOWSOCKS_LOGGER_INCLUDED__
@@ -0,0 +1,140 @@
+#ifndef __SHADOWSOCKS_RCU_INCLUDED__
+#define __SHADOWSOCKS_RCU_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+
+
+#define RCU_READER_SLOTS                (256)
+#define RCU_CACHE_LINE                  (64)
+
+
+/* read side critical sections of all SsRcu instances, every thread announces
+ * the epoch it entered in its own slot, so readers share no cache line,
+ * threads beyond the slots count on two shared counters instead */
+class SsRcuDomain {
+    public:
+        static void readLock();
+        static void readUnlock();
+        static void synchronize();
+
+    private:
+        struct alignas(RCU_CACHE_LINE) Slot {
+            std::atomic<uint64_t> epoch{0};
+            std::atomic<bool> owned{false};
+        };
+
+        static Slot *threadSlot();
+        static void releaseSlot(Slot *slot);
+
+    private:
+        static std::atomic<uint64_t> _epoch;
+        static Slot _slots[RCU_READER_SLOTS];
+        static std::atomic<uint64_t> _overflow[2];
+        static std::mutex _mutex;
+
+    friend struct SsRcuThreadState;
+};
+
+
+/* immutable snapshot behind an atomic pointer, readers never lock, writers
+ * copy, modify and swap, the old copy is freed after every reader that
+ * could see it has left */
+template <typename Type>
+class SsRcu {
+    public:
+        /* read side guard, the snapshot stays valid until it is destroyed */
+        class Reader {
+            public:
+                explicit Reader(const SsRcu &rcu);
+                Reader(const Reader&) = delete;
+                Reader &operator=(const Reader&) = delete;
+                ~Reader();
+
+                const Type *get() const;
+                const Type *operator->() const;
+                const Type &operator*() const;
+
+            private:
+                const Type *_value;
+        };
+
+    public:
+        SsRcu();
+        SsRcu(const SsRcu&) = delete;
+        SsRcu &operator=(const SsRcu&) = delete;
+        ~SsRcu();
+
+        template <typename Updater>
+        void update(Updater updater);
+
+    private:
+        std::atomic<Type*> _current;
+        std::mutex _mutex;
+};
+
+
+// SsRcu constructor, starts with a default constructed value
+template <typename Type>
+SsRcu<Type>::SsRcu() : _current(new Type()) {
+}
+
+// SsRcu destructor, later readers see no value
+template <typename Type>
+SsRcu<Type>::~SsRcu() {
+    std::unique_ptr<Type> last(_current.exchange(nullptr));
+    SsRcuDomain::synchronize();
+}
+
+// updater(Type&) modifies a private copy which then replaces the current
+// value, updates are serialized and wait for the old readers
+template <typename Type>
+template <typename Updater>
+void SsRcu<Type>::update(Updater updater) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto current = _current.load(std::memory_order_acquire);
+    if (current == nullptr) {
+        return;
+    }
+
+    std::unique_ptr<Type> next(new Type(*current));
+    updater(*next);
+    std::unique_ptr<Type> old(_current.exchange(next.release()));
+
+    SsRcuDomain::synchronize();
+}
+
+// enter a read section and pin the current value, null after destruction
+template <typename Type>
+SsRcu<Type>::Reader::Reader(const SsRcu &rcu) {
+    SsRcuDomain::readLock();
+    _value = rcu._current.load(std::memory_order_seq_cst);
+}
+
+// leave the read section
+template <typename Type>
+SsRcu<Type>::Reader::~Reader() {
+    SsRcuDomain::readUnlock();
+}
+
+// pinned value
+template <typename Type>
+const Type *SsRcu<Type>::Reader::get() const {
+    return _value;
+}
+
+// member of pinned value
+template <typename Type>
+const Type *SsRcu<Type>::Reader::operator->() const {
+    return _value;
+}
+
+// pinned value
+template <typename Type>
+const Type &SsRcu<Type>::Reader::operator*() const {
+    return *_value;
+}
+
+
+#endif // __SHADOWSOCKS_RCU_INCLUDED__
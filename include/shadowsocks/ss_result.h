@@ -0,0 +1,309 @@
+#ifndef __SHADOWSOCKS_RESULT_INCLUDED__
+#define __SHADOWSOCKS_RESULT_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_logger.h"
+
+
+/* failure of one operation, a code and the system error behind it, cheap
+ * to return, nothing is formatted or logged until someone asks */
+class SsError {
+    public:
+        enum class ErrorCode : uint8_t {
+            EC_NONE,
+            EC_WOULD_BLOCK,
+            EC_INTERRUPTED,
+            EC_RESET,
+            EC_TIMEOUT,
+            EC_REFUSED,
+            EC_BAD_HEADER,
+            EC_INVALID_STATE,
+            EC_UNSUPPORTED,
+            EC_SYSTEM
+        };
+
+    public:
+        SsError() = default;
+        SsError(ErrorCode code, int system = 0);
+        static SsError fromSystem(int system);
+        static SsError last();
+
+        ErrorCode code() const;
+        int system() const;
+        SsError failure() const;
+        explicit operator bool() const;
+        bool operator==(ErrorCode code) const;
+        bool operator!=(ErrorCode code) const;
+
+        static const char *name(ErrorCode code);
+        [[noreturn]] void raise(SsLogger::LoggerLevel level) const;
+
+    private:
+        ErrorCode _code = ErrorCode::EC_NONE;
+        int _system = 0;
+
+    friend std::ostream &operator<<(std::ostream &o, const SsError &error);
+};
+
+
+/* value or error of an operation that fails per connection, failures are
+ * returned rather than thrown, value() of a failure raises it */
+template <typename Type>
+class SsResult {
+    public:
+        SsResult(const Type &value);
+        SsResult(Type &&value);
+        SsResult(SsError error);
+        SsResult(SsError::ErrorCode code);
+        SsResult(const SsResult &other);
+        SsResult(SsResult &&other);
+        SsResult &operator=(const SsResult &other);
+        SsResult &operator=(SsResult &&other);
+        ~SsResult();
+
+        bool ok() const;
+        explicit operator bool() const;
+        const SsError &error() const;
+
+        Type &value();
+        const Type &value() const;
+        Type valueOr(Type fallback) const;
+        Type &operator*();
+        Type *operator->();
+
+    private:
+        void destroy();
+
+    private:
+        union {
+            Type _value;
+        };
+        SsError _error;
+};
+
+
+/* outcome of an operation without a value */
+template <>
+class SsResult<void> {
+    public:
+        SsResult() = default;
+        SsResult(SsError error);
+        SsResult(SsError::ErrorCode code);
+
+        bool ok() const;
+        explicit operator bool() const;
+        const SsError &error() const;
+        void value() const;
+
+    private:
+        SsError _error;
+};
+
+
+// SsError constructor
+inline SsError::SsError(ErrorCode code, int system) :
+    _code(code), _system(system) {
+}
+
+// what went wrong
+inline SsError::ErrorCode SsError::code() const {
+    return _code;
+}
+
+// errno or WSAGetLastError value, zero when there is none
+inline int SsError::system() const {
+    return _system;
+}
+
+// this error as a failure, EC_NONE becomes EC_INVALID_STATE, so a failed
+// result never looks like a success without a value
+inline SsError SsError::failure() const {
+    return _code != ErrorCode::EC_NONE
+        ? *this : SsError(ErrorCode::EC_INVALID_STATE, _system);
+}
+
+// true for a failure
+inline SsError::operator bool() const {
+    return _code != ErrorCode::EC_NONE;
+}
+
+// compare with a code
+inline bool SsError::operator==(ErrorCode code) const {
+    return _code == code;
+}
+
+// compare with a code
+inline bool SsError::operator!=(ErrorCode code) const {
+    return _code != code;
+}
+
+// SsResult constructor, success
+template <typename Type>
+SsResult<Type>::SsResult(const Type &value) : _value(value) {
+}
+
+// SsResult constructor, success
+template <typename Type>
+SsResult<Type>::SsResult(Type &&value) : _value(std::move(value)) {
+}
+
+// SsResult constructor, failure
+template <typename Type>
+SsResult<Type>::SsResult(SsError error) : _error(error.failure()) {
+    assert(error);
+}
+
+// SsResult constructor, failure without a system error
+template <typename Type>
+SsResult<Type>::SsResult(SsError::ErrorCode code) : SsResult(SsError(code)) {
+}
+
+// SsResult copy constructor
+template <typename Type>
+SsResult<Type>::SsResult(const SsResult &other) : _error(other._error) {
+    if (!_error) {
+        new (&_value) Type(other._value);
+    }
+}
+
+// SsResult move constructor
+template <typename Type>
+SsResult<Type>::SsResult(SsResult &&other) : _error(other._error) {
+    if (!_error) {
+        new (&_value) Type(std::move(other._value));
+    }
+}
+
+// copy assignment
+template <typename Type>
+SsResult<Type> &SsResult<Type>::operator=(const SsResult &other) {
+    if (this != &other) {
+        destroy();
+        _error = other._error;
+        if (!_error) {
+            new (&_value) Type(other._value);
+        }
+    }
+
+    return *this;
+}
+
+// move assignment
+template <typename Type>
+SsResult<Type> &SsResult<Type>::operator=(SsResult &&other) {
+    if (this != &other) {
+        destroy();
+        _error = other._error;
+        if (!_error) {
+            new (&_value) Type(std::move(other._value));
+        }
+    }
+
+    return *this;
+}
+
+// SsResult destructor
+template <typename Type>
+SsResult<Type>::~SsResult() {
+    destroy();
+}
+
+// true on success
+template <typename Type>
+bool SsResult<Type>::ok() const {
+    return !_error;
+}
+
+// true on success
+template <typename Type>
+SsResult<Type>::operator bool() const {
+    return !_error;
+}
+
+// failure, EC_NONE on success
+template <typename Type>
+const SsError &SsResult<Type>::error() const {
+    return _error;
+}
+
+// value of a success
+template <typename Type>
+Type &SsResult<Type>::value() {
+    if (_error) {
+        _error.raise(SsLogger::LoggerLevel::LL_ERROR);
+    }
+
+    return _value;
+}
+
+// value of a success
+template <typename Type>
+const Type &SsResult<Type>::value() const {
+    if (_error) {
+        _error.raise(SsLogger::LoggerLevel::LL_ERROR);
+    }
+
+    return _value;
+}
+
+// value of a success, fallback on failure
+template <typename Type>
+Type SsResult<Type>::valueOr(Type fallback) const {
+    return _error ? std::move(fallback) : _value;
+}
+
+// value of a success
+template <typename Type>
+Type &SsResult<Type>::operator*() {
+    return value();
+}
+
+// value of a success
+template <typename Type>
+Type *SsResult<Type>::operator->() {
+    return &value();
+}
+
+// only a success holds a value
+template <typename Type>
+void SsResult<Type>::destroy() {
+    if (!_error) {
+        _value.~Type();
+    }
+}
+
+// SsResult constructor, failure
+inline SsResult<void>::SsResult(SsError error) : _error(error.failure()) {
+    assert(error);
+}
+
+// SsResult constructor, failure without a system error
+inline SsResult<void>::SsResult(SsError::ErrorCode code) :
+    SsResult(SsError(code)) {
+}
+
+// true on success
+inline bool SsResult<void>::ok() const {
+    return !_error;
+}
+
+// true on success
+inline SsResult<void>::operator bool() const {
+    return !_error;
+}
+
+// failure, EC_NONE on success
+inline const SsError &SsResult<void>::error() const {
+    return _error;
+}
+
+// raise a failure, nothing on success
+inline void SsResult<void>::value() const {
+    if (_error) {
+        _error.raise(SsLogger::LoggerLevel::LL_ERROR);
+    }
+}
+
+
+#endif // __SHADOWSOCKS_RESULT_INCLUDED__
@@ -3,6 +3,7 @@
 
 
 #include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_result.h"
 
 
 #if defined(__platform_linux__)
@@ -20,21 +21,16 @@ class SsSelector {
             SE_READABLE = SELECTOR_EVENT_IN,
             SE_WRITABLE = SELECTOR_EVENT_OUT
         };
-        enum class SelectorState : uint8_t {
-            SS_TIMEOUT = 0xff,
-            SS_SUCCESS = 0x00,
-            SS_FAILURE = 0x01
-        };
         using SelectorEvents = std::initializer_list<SelectorEvent>;
 #if defined(__platform_linux__)
         using Descriptor = int;
 #elif defined(__platform_windows__)
         using Descriptor = SOCKET;
 #endif
-        using SelectResult = std::pair<
-            SelectorState,
-            std::vector<std::pair<Descriptor, std::pair<bool, bool>>>
+        using SelectEvents = std::vector<
+            std::pair<Descriptor, std::pair<bool, bool>>
         >;
+        using SelectResult = SsResult<SelectEvents>;
 
     public:
         SsSelector();
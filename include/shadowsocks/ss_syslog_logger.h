@@ -0,0 +1,85 @@
+#ifndef __SHADOWSOCKS_SYSLOG_LOGGER_INCLUDED__
+#define __SHADOWSOCKS_SYSLOG_LOGGER_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_logger.h"
+
+
+#define SYSLOG_JOURNAL_PATH             ("/run/systemd/journal/socket")
+#define SYSLOG_DEVICE_PATH              ("/dev/log")
+#define SYSLOG_BATCH_MESSAGES           (64)
+#define SYSLOG_FACILITY_DAEMON          (3 << 3)
+
+
+#if defined(__platform_linux__)
+/* sends framed records as datagrams over a unix socket, every flush goes out
+ * with as few sendmmsg calls as possible, frames are [u32 size][bytes], a
+ * daemon that cannot keep up loses messages rather than stalling the caller */
+class SsDatagramBuffer : public std::streambuf {
+    public:
+        explicit SsDatagramBuffer(std::string path);
+        SsDatagramBuffer(const SsDatagramBuffer&) = delete;
+        SsDatagramBuffer &operator=(const SsDatagramBuffer&) = delete;
+        ~SsDatagramBuffer() override;
+
+    protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char *data, std::streamsize size) override;
+        int sync() override;
+
+    private:
+        bool connect();
+        void close();
+        size_t send(size_t offset);
+
+    private:
+        std::string _path;
+        int _descriptor = -1;
+        std::string _pending;
+        uint64_t _dropped = 0;
+        uint64_t _reported = 0;
+};
+
+
+/* std::ostream owning its SsDatagramBuffer */
+class SsDatagramStream : public std::ostream {
+    public:
+        explicit SsDatagramStream(std::string path);
+
+    private:
+        SsDatagramBuffer _buffer;
+};
+
+
+/* logger sending to journald with native fields, or to the syslog socket
+ * with the message and fields as logfmt, an empty path picks the socket
+ * of the protocol */
+class SsSyslogLogger : private SsDatagramStream, public SsLogger {
+    public:
+        enum class SyslogProtocol : uint8_t {
+            SP_JOURNAL,
+            SP_SYSLOG
+        };
+
+    public:
+        explicit SsSyslogLogger(std::string identifier,
+                                SyslogProtocol protocol =
+                                    SyslogProtocol::SP_JOURNAL,
+                                std::string path = std::string());
+
+    protected:
+        void append(LoggerLevel level, time_t time,
+                    const char *message, size_t size) override;
+
+    private:
+        std::string _identifier;
+        pid_t _pid = 0;
+        std::string _pidText;
+        SyslogProtocol _protocol;
+        std::string _record;
+};
+#endif
+
+
+#endif // __SHADOWSOCKS_SYSLOG_LOGGER_INCLUDED__
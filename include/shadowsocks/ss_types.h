@@ -9,10 +9,18 @@
 // standard headers
 #include <map>
 #include <list>
+#include <mutex>
+#include <cmath>
 #include <ctime>
 #include <tuple>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <memory>
+#include <thread>
+#include <vector>
 #include <cassert>
 #include <csignal>
 #include <cstdint>
@@ -25,6 +33,7 @@
 #include <functional>
 #include <forward_list>
 #include <initializer_list>
+#include <condition_variable>
 
 
 // platform headers
@@ -33,12 +42,19 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
 #include <sys/epoll.h>
 #include <poll.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
 #elif defined(__platform_windows__)
 #include <Windows.h>
 #include <WinSock2.h>
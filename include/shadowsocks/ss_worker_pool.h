@@ -0,0 +1,71 @@
+#ifndef __SHADOWSOCKS_WORKER_POOL_INCLUDED__
+#define __SHADOWSOCKS_WORKER_POOL_INCLUDED__
+
+
+#include "shadowsocks/ss_types.h"
+#include "shadowsocks/ss_configuration.h"
+
+
+#define WORKER_MIN_UPTIME               (1000)
+#define WORKER_RESTART_DELAY            (1000)
+#define WORKER_STOP_TIMEOUT             (30000)
+#define WORKER_WAIT_INTERVAL            (200)
+
+
+#if defined(HAVE_FORK)
+/* pre-fork master: every worker binds the listeners of the configuration
+ * it was forked with and runs its own event loop, crashed workers are
+ * restarted, signals are forwarded, async logging is suspended around every
+ * fork since a child keeps no threads, workers log synchronously unless
+ * they enable it again, pinned workers run on the core of their index as
+ * placed by SsAffinity, with a configuration store SIGHUP reloads it in the
+ * master too and a changed listener set retires the workers, they drain
+ * while fresh ones forked with the new snapshot take over */
+class SsWorkerPool {
+    public:
+        using WorkerMain = std::function<int(size_t index)>;
+
+    public:
+        SsWorkerPool(size_t workers, WorkerMain main);
+        SsWorkerPool(const SsWorkerPool&) = delete;
+        SsWorkerPool &operator=(const SsWorkerPool&) = delete;
+
+        int run();
+        size_t size() const;
+        void setPinned(bool pinned);
+        void setConfigStore(SsConfigStore *store);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Worker {
+            pid_t pid;
+            Clock::time_point started;
+            Clock::time_point restartAt;
+        };
+
+        bool spawn(size_t index);
+        void reap();
+        void restart();
+        void reload();
+        void replace();
+        void forward(int signal);
+        void stop(int signal);
+        size_t alive() const;
+
+    private:
+        WorkerMain _main;
+        std::vector<Worker> _workers;
+        std::vector<pid_t> _retired;
+        SsConfigStore *_store = nullptr;
+        sigset_t _signals;
+        sigset_t _previous;
+        bool _pinned = false;
+        bool _stopping = false;
+        Clock::time_point _stopDeadline;
+        int _status = EXIT_SUCCESS;
+};
+#endif
+
+
+#endif // __SHADOWSOCKS_WORKER_POOL_INCLUDED__
@@ -0,0 +1,360 @@
+#include "shadowsocks/crypto/ss_cpu.h"
+#include "shadowsocks/crypto/ss_cipher.h"
+#include "shadowsocks/crypto/ss_stream_cipher.h"
+#include "shadowsocks/crypto/ss_chacha20.h"
+#include "shadowsocks/crypto/ss_poly1305.h"
+#include "shadowsocks/crypto/ss_digest.h"
+
+#if defined(SS_CPU_X86)
+#include <x86intrin.h>
+#endif
+
+
+#define BENCH_REPEATS                   (5)
+#define BENCH_DEFAULT_MILLISECONDS      (200)
+
+
+/* one timed run of an operation */
+struct BenchSample {
+    double seconds;
+    uint64_t cycles;
+    size_t operations;
+};
+
+/* dispatch profile, features turned off on top of SS_CPU_DISABLE */
+struct BenchProfile {
+    const char *name;
+    SsCpu::Features disabled;
+};
+
+static const size_t BENCH_SIZES[] = {64, 256, 1024, 4096, 16384, 65536};
+static const size_t BENCH_PACKET_SIZES[] = {64, 512, 1400};
+
+static const BenchProfile BENCH_PROFILES[] = {
+    {"native", 0},
+    {"no-avx2", static_cast<SsCpu::Features>(SsCpu::Feature::CF_AVX2)},
+    {"no-sha", static_cast<SsCpu::Features>(SsCpu::Feature::CF_SHA)},
+    {"no-aesni", static_cast<SsCpu::Features>(SsCpu::Feature::CF_AESNI)},
+    {"scalar", ~static_cast<SsCpu::Features>(0)}
+};
+
+static std::chrono::milliseconds benchDuration(BENCH_DEFAULT_MILLISECONDS);
+static const char *benchFilter = nullptr;
+static volatile uint8_t benchSink;
+
+
+// timestamp counter when available, cycles are reference cycles
+static inline uint64_t cycles() {
+#if defined(SS_CPU_X86)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// run operation for the configured duration, report the median run
+template <typename Operation>
+static BenchSample measure(Operation operation) {
+    // calibrate a batch that takes about a millisecond
+    size_t batch = 1;
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; ++i) {
+            operation();
+        }
+        if (std::chrono::steady_clock::now() - start >=
+                std::chrono::microseconds(1000) || batch >= (1u << 30)) {
+            break;
+        }
+        batch *= 2;
+    }
+
+    std::vector<BenchSample> samples;
+    for (size_t repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+        BenchSample sample{0, 0, 0};
+        auto start = std::chrono::steady_clock::now();
+        auto startCycles = cycles();
+        auto deadline = start + benchDuration / BENCH_REPEATS;
+
+        do {
+            for (size_t i = 0; i < batch; ++i) {
+                operation();
+            }
+            sample.operations += batch;
+        } while (std::chrono::steady_clock::now() < deadline);
+
+        sample.cycles = cycles() - startCycles;
+        sample.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        samples.push_back(sample);
+    }
+
+    std::sort(samples.begin(), samples.end(),
+        [] (const BenchSample &a, const BenchSample &b) {
+            return a.seconds / a.operations < b.seconds / b.operations;
+        }
+    );
+    return samples[BENCH_REPEATS / 2];
+}
+
+// filter by primitive or method name
+static bool selected(const char *name) {
+    return benchFilter == nullptr || std::strstr(name, benchFilter) != nullptr;
+}
+
+// throughput line, GB/s and cycles/byte
+static void reportThroughput(const char *profile, const char *name,
+                             const char *kernel, size_t size,
+                             const BenchSample &sample) {
+    auto bytes = static_cast<double>(sample.operations) * size;
+    std::printf("%-8s %-32s %-14s %6zu B %9.3f GB/s %8.2f cpb\n",
+                profile, name, kernel, size,
+                bytes / sample.seconds / 1e9,
+                static_cast<double>(sample.cycles) / bytes);
+}
+
+// latency line, nanoseconds and cycles per operation
+static void reportLatency(const char *profile, const char *name,
+                          const char *kernel, size_t size,
+                          const BenchSample &sample) {
+    auto operations = static_cast<double>(sample.operations);
+    std::printf("%-8s %-32s %-14s %6zu B %9.1f ns/op %9.0f cycles/op\n",
+                profile, name, kernel, size,
+                sample.seconds / operations * 1e9,
+                static_cast<double>(sample.cycles) / operations);
+}
+
+// raw kernels: stream cipher, authenticator and hashes
+static void benchPrimitives(const char *profile) {
+    std::vector<uint8_t> buffer(BENCH_SIZES[5] + 64, 0x5a);
+    uint8_t key[32] = {1};
+    uint8_t nonce[16] = {2};
+    uint8_t digest[32];
+
+    for (auto size : BENCH_SIZES) {
+        if (selected("chacha20")) {
+            reportThroughput(profile, "chacha20", SsChaCha20::kernel(), size,
+                measure([&] {
+                    SsChaCha20 chacha20(key, nonce, 1);
+                    chacha20.crypt(buffer.data(), buffer.data(), size);
+                    benchSink = buffer[0];
+                }));
+        }
+        if (selected("poly1305")) {
+            reportThroughput(profile, "poly1305", "scalar", size,
+                measure([&] {
+                    SsPoly1305 poly1305(key);
+                    poly1305.update(buffer.data(), size);
+                    poly1305.final(digest);
+                    benchSink = digest[0];
+                }));
+        }
+        if (selected("aes-128-ctr")) {
+            reportThroughput(profile, "aes-128-ctr", SsAes::kernel(), size,
+                measure([&] {
+                    SsAesCtr ctr(key, 16, nonce);
+                    ctr.crypt(buffer.data(), buffer.data(), size);
+                    benchSink = buffer[0];
+                }));
+        }
+        if (selected("aes-128-cfb")) {
+            SsAesCfb cfb(key, 16, nonce);
+            reportThroughput(profile, "aes-128-cfb encrypt", SsAes::kernel(),
+                size, measure([&] {
+                    cfb.encrypt(buffer.data(), buffer.data(), size);
+                    benchSink = buffer[0];
+                }));
+            reportThroughput(profile, "aes-128-cfb decrypt", SsAes::kernel(),
+                size, measure([&] {
+                    cfb.decrypt(buffer.data(), buffer.data(), size);
+                    benchSink = buffer[0];
+                }));
+        }
+        if (selected("sha1")) {
+            reportThroughput(profile, "sha1", SsSha1::kernel(), size,
+                measure([&] {
+                    SsSha1::digest(buffer.data(), size, digest);
+                    benchSink = digest[0];
+                }));
+        }
+        if (selected("sha256")) {
+            reportThroughput(profile, "sha256", SsSha256::kernel(), size,
+                measure([&] {
+                    SsSha256::digest(buffer.data(), size, digest);
+                    benchSink = digest[0];
+                }));
+        }
+    }
+}
+
+// AEAD methods: chunk sealing, session setup and UDP packets
+static void benchMethods(const char *profile, const char *kernel) {
+    for (auto method : SsCipher::methods()) {
+        auto name = SsCipher::name(method);
+        if (!selected(name)) {
+            continue;
+        }
+
+        SsCipher cipher(method, SsCipher::Key(32, 0x42));
+        std::vector<uint8_t> salt(cipher.saltSize());
+        cipher.newSalt(salt.data());
+
+        std::vector<uint8_t> in(BENCH_SIZES[5], 0x5a);
+        std::vector<uint8_t> out(BENCH_SIZES[5] + cipher.tagSize());
+        for (auto size : BENCH_SIZES) {
+            reportThroughput(profile, name, kernel, size, measure([&] {
+                cipher.seal(in.data(), size, out.data());
+                benchSink = out[0];
+            }));
+        }
+
+        // payload starts mid segment so every chunk crosses a boundary
+        SsBufferPool pool;
+        SsBufferChain chain(pool);
+        std::vector<uint8_t> head(pool.segmentSize() - BENCH_SIZES[0] / 2);
+        chain.append(head.data(), head.size());
+        chain.consume(head.size());
+        chain.append(in.data(), in.size());
+        std::vector<uint8_t> linear(BENCH_SIZES[5]);
+        auto scattered = std::string(name) + " chain";
+        auto copied = std::string(name) + " chain-copy";
+        for (auto size : BENCH_SIZES) {
+            reportThroughput(profile, scattered.c_str(), kernel, size,
+                measure([&] {
+                    cipher.seal(chain, size, out.data());
+                    benchSink = out[0];
+                }));
+            reportThroughput(profile, copied.c_str(), kernel, size,
+                measure([&] {
+                    chain.copy(0, linear.data(), size);
+                    cipher.seal(linear.data(), size, out.data());
+                    benchSink = out[0];
+                }));
+        }
+
+        // salt generation and HKDF-SHA1 subkey of a new connection
+        auto setup = std::string(name) + " setup";
+        reportLatency(profile, setup.c_str(), SsSha1::kernel(),
+            cipher.saltSize(), measure([&] {
+                cipher.newSalt(salt.data());
+                benchSink = salt[0];
+            }));
+
+        SsCipher::Stream packet;
+        for (auto size : BENCH_PACKET_SIZES) {
+            SsCipher::Stream payload(size, 0x5a);
+            auto udp = std::string(name) + " udp";
+            reportLatency(profile, udp.c_str(), kernel, size, measure([&] {
+                cipher.sealPacket(payload, packet);
+                benchSink = packet[0];
+            }));
+
+            if (cipher.extendedNonce()) {
+                auto direct = std::string(name) + " udp-direct";
+                reportLatency(profile, direct.c_str(), kernel, size,
+                    measure([&] {
+                        cipher.sealDirectPacket(payload, packet);
+                        benchSink = packet[0];
+                    }));
+            }
+        }
+    }
+}
+
+// legacy stream methods: encryption, decryption and UDP packets
+static void benchStreamMethods(const char *profile) {
+    for (auto method : SsStreamCipher::methods()) {
+        auto name = SsStreamCipher::name(method);
+        if (!selected(name)) {
+            continue;
+        }
+
+        SsStreamCipher cipher(method, SsStreamCipher::Key(
+            SsStreamCipher::keySize(method), 0x42));
+        std::vector<uint8_t> iv(cipher.ivSize());
+        cipher.newIv(iv.data());
+
+        std::vector<uint8_t> buffer(BENCH_SIZES[5], 0x5a);
+        auto encrypt = std::string(name) + " encrypt";
+        auto decrypt = std::string(name) + " decrypt";
+        for (auto size : BENCH_SIZES) {
+            reportThroughput(profile, encrypt.c_str(), SsAes::kernel(), size,
+                measure([&] {
+                    cipher.encrypt(buffer.data(), buffer.data(), size);
+                    benchSink = buffer[0];
+                }));
+            reportThroughput(profile, decrypt.c_str(), SsAes::kernel(), size,
+                measure([&] {
+                    cipher.decrypt(buffer.data(), buffer.data(), size);
+                    benchSink = buffer[0];
+                }));
+        }
+
+        SsStreamCipher::Stream packet;
+        for (auto size : BENCH_PACKET_SIZES) {
+            SsStreamCipher::Stream payload(size, 0x5a);
+            auto udp = std::string(name) + " udp";
+            reportLatency(profile, udp.c_str(), SsAes::kernel(), size,
+                measure([&] {
+                    cipher.encryptPacket(payload, packet);
+                    benchSink = packet[0];
+                }));
+        }
+    }
+}
+
+// usage message
+static void usage(const char *program) {
+    std::cout << "usage: " << program
+              << " [-t milliseconds] [-f filter] [-p profile]" << std::endl
+              << "  profiles: native no-avx2 no-sha no-aesni scalar, "
+              << "SS_CPU_DISABLE applies to all" << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+    const char *profileFilter = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            benchDuration = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            benchFilter = argv[++i];
+        } else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profileFilter = argv[++i];
+        } else {
+            usage(argv[0]);
+            return argc == 2 && std::strcmp(argv[1], "-h") == 0
+                ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    std::cout << APPLICATION_NAME << " " << APPLICATION_VERSION
+              << " cipher benchmark, cpu features = 0x" << std::hex
+              << SsCpu::detected() << std::dec << std::endl;
+
+    std::vector<std::string> seen;
+    for (auto &profile : BENCH_PROFILES) {
+        if (profileFilter != nullptr &&
+                std::strcmp(profileFilter, profile.name) != 0) {
+            continue;
+        }
+
+        SsCpu::reset();
+        SsCpu::disable(profile.disabled);
+
+        // a profile that selects the same kernels as an earlier one is noise
+        auto kernels = std::string(SsChaCha20::kernel()) + "/" +
+                       SsSha1::kernel() + "/" + SsAes::kernel();
+        if (std::find(seen.begin(), seen.end(), kernels) != seen.end()) {
+            continue;
+        }
+        seen.push_back(kernels);
+
+        benchPrimitives(profile.name);
+        benchMethods(profile.name, kernels.c_str());
+        benchStreamMethods(profile.name);
+    }
+
+    SsCpu::reset();
+    return EXIT_SUCCESS;
+}
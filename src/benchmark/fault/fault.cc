@@ -0,0 +1,269 @@
+#include "shadowsocks/ss_result.h"
+#include "shadowsocks/ss_exception.h"
+#include "shadowsocks/crypto/ss_cipher.h"
+
+
+#define BENCH_REPEATS                   (5)
+#define BENCH_DEFAULT_MILLISECONDS      (500)
+#define BENCH_CONNECTIONS               (100)
+#define BENCH_HEADER_SIZE               (19)
+#define BENCH_CHUNK_SIZE                (1400)
+#define BENCH_CHUNKS                    (4)
+#define BENCH_LENGTH_SIZE               (2)
+
+
+/* one timed run */
+struct BenchSample {
+    double seconds;
+    size_t operations;
+};
+
+/* what a client sent: salt, sealed length and address header, then sealed
+ * payload chunks */
+struct BenchConnection {
+    bool corrupted;
+    std::vector<uint8_t> salt;
+    std::vector<uint8_t> length;
+    std::vector<uint8_t> header;
+    std::vector<std::vector<uint8_t>> chunks;
+};
+
+/* discards everything, the formatting cost remains */
+class BenchNullBuffer : public std::streambuf {
+    protected:
+        int_type overflow(int_type c) override {
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize size) override {
+            return size;
+        }
+};
+
+static const int BENCH_FAULT_RATES[] = {0, 5, 20, 50};
+
+static std::chrono::milliseconds benchDuration(BENCH_DEFAULT_MILLISECONDS);
+static BenchNullBuffer benchNullBuffer;
+static std::ostream benchNull(&benchNullBuffer);
+static volatile size_t benchSink;
+
+
+// run operation for the configured duration, report the median run
+template <typename Operation>
+static BenchSample measure(Operation operation) {
+    std::vector<BenchSample> samples;
+    for (size_t repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+        BenchSample sample{0, 0};
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + benchDuration / BENCH_REPEATS;
+
+        do {
+            operation();
+            sample.operations += BENCH_CONNECTIONS;
+        } while (std::chrono::steady_clock::now() < deadline);
+
+        sample.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        samples.push_back(sample);
+    }
+
+    std::sort(samples.begin(), samples.end(),
+        [] (const BenchSample &a, const BenchSample &b) {
+            return a.seconds / a.operations < b.seconds / b.operations;
+        }
+    );
+    return samples[BENCH_REPEATS / 2];
+}
+
+// client side of BENCH_CONNECTIONS connections, rate percent of them carry
+// a corrupted header, spread evenly
+static std::vector<BenchConnection> connections(SsCipher::CipherMethod method,
+                                                int rate) {
+    SsCipher client(method, SsCipher::Key(32, 0x42));
+    std::vector<uint8_t> header(BENCH_HEADER_SIZE, 0x03);
+    std::vector<uint8_t> payload(BENCH_CHUNK_SIZE, 0x5a);
+    uint8_t length[BENCH_LENGTH_SIZE] = {0, BENCH_HEADER_SIZE};
+
+    std::vector<BenchConnection> result(BENCH_CONNECTIONS);
+    for (size_t i = 0; i < result.size(); ++i) {
+        auto &connection = result[i];
+        connection.salt.resize(client.saltSize());
+        client.newSalt(connection.salt.data());
+
+        connection.length.resize(sizeof(length) + client.tagSize());
+        client.seal(length, sizeof(length), connection.length.data());
+        connection.header.resize(header.size() + client.tagSize());
+        client.seal(header.data(), header.size(), connection.header.data());
+        for (size_t j = 0; j < BENCH_CHUNKS; ++j) {
+            std::vector<uint8_t> chunk(payload.size() + client.tagSize());
+            client.seal(payload.data(), payload.size(), chunk.data());
+            connection.chunks.push_back(std::move(chunk));
+        }
+
+        connection.corrupted = static_cast<int>(i * rate % 100) < rate;
+        if (connection.corrupted) {
+            connection.header[0] ^= 0x01;
+        }
+    }
+
+    return result;
+}
+
+// bytes opened in one pass over the pool, a bad header stops the relay
+// early, so failed connections cost less and per connection rates flatter
+// them
+static size_t opened(const std::vector<BenchConnection> &pool) {
+    size_t result = 0;
+    for (auto &connection : pool) {
+        result += connection.length.size() + connection.header.size();
+        if (!connection.corrupted) {
+            for (auto &chunk : connection.chunks) {
+                result += chunk.size();
+            }
+        }
+    }
+    return result;
+}
+
+// server side returning failures, the relay after this change
+static SsResult<size_t> relayResult(SsCipher &cipher,
+                                    const BenchConnection &connection,
+                                    uint8_t *out) {
+    cipher.setSalt(connection.salt.data());
+    if (!cipher.open(connection.length.data(), connection.length.size(), out) ||
+            !cipher.open(connection.header.data(), connection.header.size(),
+                         out)) {
+        return SsError::ErrorCode::EC_BAD_HEADER;
+    }
+
+    size_t relayed = 0;
+    for (auto &chunk : connection.chunks) {
+        if (!cipher.open(chunk.data(), chunk.size(), out)) {
+            return SsError::ErrorCode::EC_BAD_HEADER;
+        }
+        relayed += chunk.size() - cipher.tagSize();
+    }
+
+    return relayed;
+}
+
+// server side throwing SsException, which logs as it is constructed
+static size_t relayThrow(SsCipher &cipher, const BenchConnection &connection,
+                         uint8_t *out) {
+    cipher.setSalt(connection.salt.data());
+    if (!cipher.open(connection.length.data(), connection.length.size(), out) ||
+            !cipher.open(connection.header.data(), connection.header.size(),
+                         out)) {
+        throw SsException(SsLogger::LoggerLevel::LL_WARNING,
+            SsLogger::format("bad header from connection %d",
+                             connection.salt[0]));
+    }
+
+    size_t relayed = 0;
+    for (auto &chunk : connection.chunks) {
+        if (!cipher.open(chunk.data(), chunk.size(), out)) {
+            throw SsException(SsLogger::LoggerLevel::LL_WARNING,
+                SsLogger::format("bad chunk from connection %d",
+                                 connection.salt[0]));
+        }
+        relayed += chunk.size() - cipher.tagSize();
+    }
+
+    return relayed;
+}
+
+// nanoseconds per KiB opened, failed connections do less work, so runs
+// are compared per byte rather than per connection
+static double byteCost(const BenchSample &sample, size_t bytesPerPass) {
+    auto passes = static_cast<double>(sample.operations) / BENCH_CONNECTIONS;
+    return sample.seconds / (passes * bytesPerPass) * 1024 * 1e9;
+}
+
+// connections per second, cost per KiB and its share of the run without
+// faults, below 100% the error path costs more than the work it skipped
+static void report(const char *name, const char *mode, int rate,
+                   const BenchSample &sample, size_t bytesPerPass,
+                   double baseline) {
+    auto perSecond = sample.operations / sample.seconds;
+    auto cost = byteCost(sample, bytesPerPass);
+    std::printf("%-24s %-9s %3d%% faults %10.0f conn/s %8.1f us/conn "
+                "%7.0f ns/KiB %6.1f%%\n", name, mode, rate, perSecond,
+                1e6 / perSecond, cost,
+                baseline > 0 ? baseline / cost * 100 : 100.0);
+}
+
+// usage message
+static void usage(const char *program) {
+    std::cout << "usage: " << program << " [-t milliseconds]" << std::endl
+              << "  relays connections of which 0, 5, 20 and 50% carry a "
+              << "bad header," << std::endl
+              << "  failures returned as SsResult or thrown as SsException,"
+              << std::endl
+              << "  only the cipher step is timed, compare ns/KiB since "
+              << "failed connections stop early" << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            benchDuration = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else {
+            usage(argv[0]);
+            return argc == 2 && std::strcmp(argv[1], "-h") == 0
+                ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    std::cout << APPLICATION_NAME << " " << APPLICATION_VERSION
+              << " fault injection benchmark" << std::endl;
+
+    // warnings are written like in production, only the sink is free
+    auto logger = std::make_shared<SsLogger>(benchNull);
+    logger->setLevel(SsLogger::LoggerLevel::LL_INFO);
+    SsLogger::addLogger("bench", logger);
+
+    for (auto method : SsCipher::methods()) {
+        auto name = SsCipher::name(method);
+        SsCipher server(method, SsCipher::Key(32, 0x42));
+        std::vector<uint8_t> out(BENCH_CHUNK_SIZE);
+
+        double resultBaseline = 0;
+        double throwBaseline = 0;
+        for (auto rate : BENCH_FAULT_RATES) {
+            auto pool = connections(method, rate);
+            auto work = opened(pool);
+
+            auto sample = measure([&] {
+                size_t relayed = 0;
+                for (auto &connection : pool) {
+                    auto result = relayResult(server, connection, out.data());
+                    relayed += result.valueOr(0);
+                }
+                benchSink = relayed;
+            });
+            report(name, "result", rate, sample, work, resultBaseline);
+            if (rate == 0) {
+                resultBaseline = byteCost(sample, work);
+            }
+
+            sample = measure([&] {
+                size_t relayed = 0;
+                for (auto &connection : pool) {
+                    try {
+                        relayed += relayThrow(server, connection, out.data());
+                    } catch (const SsException &) {
+                    }
+                }
+                benchSink = relayed;
+            });
+            report(name, "exception", rate, sample, work, throwBaseline);
+            if (rate == 0) {
+                throwBaseline = byteCost(sample, work);
+            }
+        }
+    }
+
+    SsLogger::removeLogger("bench");
+    return EXIT_SUCCESS;
+}
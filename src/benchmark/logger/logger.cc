@@ -0,0 +1,351 @@
+#include "shadowsocks/ss_logger.h"
+#include "shadowsocks/ss_file_logger.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+
+#if defined(SS_CPU_X86)
+#include <x86intrin.h>
+#endif
+
+
+#define BENCH_REPEATS                   (5)
+#define BENCH_DEFAULT_MILLISECONDS      (200)
+#define BENCH_THREAD_BATCH              (64)
+#define BENCH_LOGGERS                   (4)
+#define BENCH_FILE_NAME                 ("ss-bench-logger.log")
+
+
+/* one timed run of a call */
+struct BenchSample {
+    double seconds;
+    uint64_t cycles;
+    size_t operations;
+};
+
+/* where the registered loggers write and what they accept */
+struct BenchSetup {
+    const char *name;
+    SsLogger::LoggerLevel level;
+    SsLogger::LoggerEncoding encoding;
+    size_t loggers;
+    bool file;
+    bool async;
+};
+
+/* discards everything, the formatting cost remains */
+class BenchNullBuffer : public std::streambuf {
+    protected:
+        int_type overflow(int_type c) override {
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char *, std::streamsize size) override {
+            return size;
+        }
+};
+
+static const BenchSetup BENCH_SETUPS[] = {
+    {"filtered", SsLogger::LoggerLevel::LL_WARNING,
+     SsLogger::LoggerEncoding::LE_TEXT, 1, false, false},
+    {"null", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_TEXT, 1, false, false},
+    {"null-binary", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_BINARY, 1, false, false},
+    {"null-json", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_JSON, 1, false, false},
+    {"null-x4", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_TEXT, BENCH_LOGGERS, false, false},
+    {"file", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_TEXT, 1, true, false},
+    {"async-null", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_TEXT, 1, false, true},
+    {"async-file", SsLogger::LoggerLevel::LL_VERBOSE,
+     SsLogger::LoggerEncoding::LE_TEXT, 1, true, true}
+};
+
+static const char *BENCH_LOGGER_NAMES[BENCH_LOGGERS] = {
+    "bench-0", "bench-1", "bench-2", "bench-3"
+};
+
+static const int BENCH_THREADS[] = {1, 2, 4, 8};
+
+static std::chrono::milliseconds benchDuration(BENCH_DEFAULT_MILLISECONDS);
+static const char *benchFilter = nullptr;
+static std::string benchFile = BENCH_FILE_NAME;
+static BenchNullBuffer benchNullBuffer;
+static std::ostream benchNull(&benchNullBuffer);
+static std::atomic<int> benchCounter{0};
+
+
+// timestamp counter when available, cycles are reference cycles
+static inline uint64_t cycles() {
+#if defined(SS_CPU_X86)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// run operation for the configured duration, report the median run
+template <typename Operation>
+static BenchSample measure(Operation operation) {
+    // calibrate a batch that takes about a millisecond
+    size_t batch = 1;
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; ++i) {
+            operation();
+        }
+        if (std::chrono::steady_clock::now() - start >=
+                std::chrono::microseconds(1000) || batch >= (1u << 30)) {
+            break;
+        }
+        batch *= 2;
+    }
+
+    std::vector<BenchSample> samples;
+    for (size_t repeat = 0; repeat < BENCH_REPEATS; ++repeat) {
+        BenchSample sample{0, 0, 0};
+        auto start = std::chrono::steady_clock::now();
+        auto startCycles = cycles();
+        auto deadline = start + benchDuration / BENCH_REPEATS;
+
+        do {
+            for (size_t i = 0; i < batch; ++i) {
+                operation();
+            }
+            sample.operations += batch;
+        } while (std::chrono::steady_clock::now() < deadline);
+
+        sample.cycles = cycles() - startCycles;
+        sample.seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        samples.push_back(sample);
+    }
+
+    std::sort(samples.begin(), samples.end(),
+        [] (const BenchSample &a, const BenchSample &b) {
+            return a.seconds / a.operations < b.seconds / b.operations;
+        }
+    );
+    return samples[BENCH_REPEATS / 2];
+}
+
+// operation from several threads at once for the configured duration, the
+// sample counts calls of all threads
+template <typename Operation>
+static BenchSample measureThreads(int threads, Operation operation) {
+    std::atomic<int> ready{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopped{false};
+    std::atomic<size_t> operations{0};
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&] {
+            ready.fetch_add(1);
+            while (!running.load()) {
+                std::this_thread::yield();
+            }
+
+            size_t count = 0;
+            while (!stopped.load(std::memory_order_relaxed)) {
+                for (size_t j = 0; j < BENCH_THREAD_BATCH; ++j) {
+                    operation();
+                }
+                count += BENCH_THREAD_BATCH;
+            }
+            operations.fetch_add(count);
+        });
+    }
+
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+
+    BenchSample sample{0, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    auto startCycles = cycles();
+    running.store(true);
+    std::this_thread::sleep_for(benchDuration);
+    stopped.store(true);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    sample.cycles = cycles() - startCycles;
+    sample.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    sample.operations = operations.load();
+    return sample;
+}
+
+// filter by setup or call name
+static bool selected(const char *setup, const char *name) {
+    return benchFilter == nullptr ||
+           std::strstr(setup, benchFilter) != nullptr ||
+           std::strstr(name, benchFilter) != nullptr;
+}
+
+// latency line, nanoseconds and cycles per call
+static void reportLatency(const char *setup, const char *name,
+                          const BenchSample &sample) {
+    auto operations = static_cast<double>(sample.operations);
+    std::printf("%-12s %-22s %9.1f ns/call %9.0f cycles/call\n",
+                setup, name, sample.seconds / operations * 1e9,
+                static_cast<double>(sample.cycles) / operations);
+}
+
+// contention line, calls per second of all threads and the time one call
+// takes on its thread
+static void reportThreads(const char *setup, const char *name, int threads,
+                          const BenchSample &sample) {
+    auto operations = static_cast<double>(sample.operations);
+    std::printf("%-12s %-14s %2d thr %9.2f Mcalls/s %9.1f ns/call\n",
+                setup, name, threads, operations / sample.seconds / 1e6,
+                sample.seconds * threads / operations * 1e9);
+}
+
+// replace the registered loggers by the ones of setup
+static void configure(const BenchSetup &setup) {
+    SsLogger::disableAsync();
+    for (auto name : BENCH_LOGGER_NAMES) {
+        SsLogger::removeLogger(name);
+    }
+
+    for (size_t i = 0; i < setup.loggers; ++i) {
+        SsLogger::SsLoggerPtr logger;
+        if (setup.file) {
+            logger = std::make_shared<SsFileLogger>(benchFile);
+        } else {
+            logger = std::make_shared<SsLogger>(benchNull);
+        }
+        logger->setLevel(setup.level);
+        logger->setEncoding(setup.encoding);
+        SsLogger::addLogger(BENCH_LOGGER_NAMES[i], logger);
+    }
+
+    if (setup.async) {
+        SsLogger::enableAsync(SsLogger::AsyncPolicy::AP_BLOCK_ON_FULL);
+    }
+}
+
+// single thread cost of typical calls, argument types and counts
+static void benchCalls(const BenchSetup &setup) {
+    std::string host("example.com");
+
+    if (selected(setup.name, "no-args")) {
+        reportLatency(setup.name, "no-args", measure([&] {
+            INF("relay closed");
+        }));
+    }
+    if (selected(setup.name, "int")) {
+        reportLatency(setup.name, "int", measure([&] {
+            INF("descriptor = %d", benchCounter.load(
+                std::memory_order_relaxed));
+        }));
+    }
+    if (selected(setup.name, "int-x4")) {
+        reportLatency(setup.name, "int-x4", measure([&] {
+            auto i = benchCounter.load(std::memory_order_relaxed);
+            INF("relay %d: %d bytes in, %d bytes out, %d ms", i, i + 1,
+                i + 2, i + 3);
+        }));
+    }
+    if (selected(setup.name, "c-string")) {
+        reportLatency(setup.name, "c-string", measure([&] {
+            INF("connecting to %s", "example.com");
+        }));
+    }
+    if (selected(setup.name, "std-string")) {
+        reportLatency(setup.name, "std-string", measure([&] {
+            INF("connecting to %s", host);
+        }));
+    }
+    if (selected(setup.name, "double")) {
+        reportLatency(setup.name, "double", measure([&] {
+            INF("ratio %d", 0.75);
+        }));
+    }
+    if (selected(setup.name, "fields")) {
+        reportLatency(setup.name, "fields", measure([&] {
+            INF_FIELDS("connected", logField("peer", host),
+                       logField("port", 8388));
+        }));
+    }
+
+    // the SsSelector and SsNetwork calls, DBG compiles out above debug
+    if (selected(setup.name, "selector-dbg")) {
+        reportLatency(setup.name, "selector-dbg", measure([&] {
+            DBG("Register descriptor = %d to selector with events = %s",
+                benchCounter.load(std::memory_order_relaxed), "EVENTS");
+        }));
+    }
+    if (selected(setup.name, "network-inf")) {
+        reportLatency(setup.name, "network-inf", measure([&] {
+            INF_FIELDS("Network connected", logField("host", host),
+                       logField("port", 8388),
+                       logField("descriptor", benchCounter.load(
+                           std::memory_order_relaxed)));
+        }));
+    }
+}
+
+// same call from growing numbers of threads
+static void benchContention(const BenchSetup &setup) {
+    if (!selected(setup.name, "contention")) {
+        return;
+    }
+
+    for (auto threads : BENCH_THREADS) {
+        reportThreads(setup.name, "contention", threads,
+            measureThreads(threads, [] {
+                INF("descriptor = %d", benchCounter.fetch_add(
+                    1, std::memory_order_relaxed));
+            }));
+    }
+}
+
+// usage message
+static void usage(const char *program) {
+    std::cout << "usage: " << program
+              << " [-t milliseconds] [-f filter] [-o file]" << std::endl
+              << "  setups: filtered null null-binary null-json null-x4 "
+              << "file async-null async-file" << std::endl
+              << "  calls: no-args int int-x4 c-string std-string double "
+              << "fields selector-dbg network-inf contention" << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            benchDuration = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            benchFilter = argv[++i];
+        } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            benchFile = argv[++i];
+        } else {
+            usage(argv[0]);
+            return argc == 2 && std::strcmp(argv[1], "-h") == 0
+                ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    std::cout << APPLICATION_NAME << " " << APPLICATION_VERSION
+              << " logger benchmark, compiled level = 0x" << std::hex
+              << LOGGER_COMPILED_LEVEL << std::dec << std::endl;
+
+    for (auto &setup : BENCH_SETUPS) {
+        configure(setup);
+        benchCalls(setup);
+        benchContention(setup);
+    }
+
+    SsLogger::disableAsync();
+    for (auto name : BENCH_LOGGER_NAMES) {
+        SsLogger::removeLogger(name);
+    }
+    std::remove(benchFile.c_str());
+
+    return EXIT_SUCCESS;
+}
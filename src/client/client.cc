@@ -2,8 +2,14 @@
 #include "shadowsocks/network/relay/ss_tcp_relay.h"
 
 
+#define CLIENT_FLIGHT_RECORDER_PATH     ("ss-cli.flight")
+
+
 int main(int argc, char *argv[]) {
     SsCore::enableDebugLogger(SsLogger::LoggerLevel::LL_DEBUG);
+    SsLogger::enableAsync(SsLogger::AsyncPolicy::AP_DROP_ON_FULL);
+    SsLogger::enableFlightRecorder(SsLogger::LoggerLevel::LL_VERBOSE,
+                                   CLIENT_FLIGHT_RECORDER_PATH);
     SsCore::initEnvironments();
 
     auto selector = std::make_shared<SsSelector>();
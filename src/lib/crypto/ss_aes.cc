@@ -0,0 +1,300 @@
+#include "shadowsocks/crypto/ss_aes.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+#include "shadowsocks/crypto/ss_bytes.h"
+
+
+static const uint8_t AES_SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16
+};
+
+static const uint8_t AES_RCON[10] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
+};
+
+/* SubBytes and MixColumns of one byte, the other columns are rotations */
+struct AesTable {
+    uint32_t te[256];
+
+    AesTable() {
+        for (size_t i = 0; i < 256; ++i) {
+            uint32_t s = AES_SBOX[i];
+            uint32_t s2 = ((s << 1) ^ ((s & 0x80) ? 0x1b : 0x00)) & 0xff;
+            te[i] = (s2 << 24) | (s << 16) | (s << 8) | (s2 ^ s);
+        }
+    }
+};
+
+#define AES_SUB_WORD(W)                                                       \
+    ((static_cast<uint32_t>(AES_SBOX[(W) >> 24]) << 24) |                     \
+     (static_cast<uint32_t>(AES_SBOX[((W) >> 16) & 0xff]) << 16) |            \
+     (static_cast<uint32_t>(AES_SBOX[((W) >> 8) & 0xff]) << 8) |              \
+     (static_cast<uint32_t>(AES_SBOX[(W) & 0xff])))
+
+#define AES_TABLE_ROUND(TE, A, B, C, D)                                       \
+    ((TE)[(A) >> 24] ^ ROTR32((TE)[((B) >> 16) & 0xff], 8) ^                  \
+     ROTR32((TE)[((C) >> 8) & 0xff], 16) ^ ROTR32((TE)[(D) & 0xff], 24))
+
+#define AES_FINAL_ROUND(A, B, C, D)                                           \
+    ((static_cast<uint32_t>(AES_SBOX[(A) >> 24]) << 24) |                     \
+     (static_cast<uint32_t>(AES_SBOX[((B) >> 16) & 0xff]) << 16) |            \
+     (static_cast<uint32_t>(AES_SBOX[((C) >> 8) & 0xff]) << 8) |              \
+     (static_cast<uint32_t>(AES_SBOX[(D) & 0xff])))
+
+
+// lookup table, built once on first use
+static const uint32_t *aesTable() {
+    static const AesTable table;
+    return table.te;
+}
+
+// portable block encryption, table driven
+static void aesEncryptScalar(const uint8_t *roundKeys, size_t rounds,
+                             const uint32_t *te,
+                             const uint8_t *in, uint8_t *out) {
+    uint32_t s0 = loadBigEndian32(in) ^ loadBigEndian32(roundKeys);
+    uint32_t s1 = loadBigEndian32(in + 4) ^ loadBigEndian32(roundKeys + 4);
+    uint32_t s2 = loadBigEndian32(in + 8) ^ loadBigEndian32(roundKeys + 8);
+    uint32_t s3 = loadBigEndian32(in + 12) ^ loadBigEndian32(roundKeys + 12);
+
+    for (size_t round = 1; round < rounds; ++round) {
+        auto rk = roundKeys + round * SsAes::BLOCK_SIZE;
+        uint32_t t0 = AES_TABLE_ROUND(te, s0, s1, s2, s3);
+        uint32_t t1 = AES_TABLE_ROUND(te, s1, s2, s3, s0);
+        uint32_t t2 = AES_TABLE_ROUND(te, s2, s3, s0, s1);
+        uint32_t t3 = AES_TABLE_ROUND(te, s3, s0, s1, s2);
+        s0 = t0 ^ loadBigEndian32(rk);
+        s1 = t1 ^ loadBigEndian32(rk + 4);
+        s2 = t2 ^ loadBigEndian32(rk + 8);
+        s3 = t3 ^ loadBigEndian32(rk + 12);
+    }
+
+    auto rk = roundKeys + rounds * SsAes::BLOCK_SIZE;
+    storeBigEndian32(out, AES_FINAL_ROUND(s0, s1, s2, s3) ^
+                          loadBigEndian32(rk));
+    storeBigEndian32(out + 4, AES_FINAL_ROUND(s1, s2, s3, s0) ^
+                              loadBigEndian32(rk + 4));
+    storeBigEndian32(out + 8, AES_FINAL_ROUND(s2, s3, s0, s1) ^
+                              loadBigEndian32(rk + 8));
+    storeBigEndian32(out + 12, AES_FINAL_ROUND(s3, s0, s1, s2) ^
+                               loadBigEndian32(rk + 12));
+}
+
+// SsAes constructor, key expansion is shared by every kernel
+SsAes::SsAes(const uint8_t *key, size_t keySize) {
+    assert(keySize == 16 || keySize == 24 || keySize == 32);
+
+    auto words = keySize / 4;
+    _rounds = words + 6;
+
+    uint32_t w[(MAX_ROUNDS + 1) * 4];
+    for (size_t i = 0; i < words; ++i) {
+        w[i] = loadBigEndian32(key + i * 4);
+    }
+    for (size_t i = words; i < (_rounds + 1) * 4; ++i) {
+        uint32_t t = w[i - 1];
+        if (i % words == 0) {
+            t = ROTL32(t, 8);
+            t = AES_SUB_WORD(t) ^
+                (static_cast<uint32_t>(AES_RCON[i / words - 1]) << 24);
+        } else if (words > 6 && i % words == 4) {
+            t = AES_SUB_WORD(t);
+        }
+        w[i] = w[i - words] ^ t;
+    }
+
+    for (size_t i = 0; i < (_rounds + 1) * 4; ++i) {
+        storeBigEndian32(_roundKeys + i * 4, w[i]);
+    }
+}
+
+// encrypt one block with the selected kernel
+void SsAes::encryptBlock(const uint8_t *in, uint8_t *out) const {
+    static const uint8_t zero[BLOCK_SIZE] = {0};
+    uint8_t iv[BLOCK_SIZE];
+    std::memcpy(iv, in, BLOCK_SIZE);
+
+    // single block CFB over zeros is the bare block cipher
+#if defined(HAVE_X86_AESNI_INTRINSICS)
+    if (hardware()) {
+        aesCfbEncryptBlocksNi(_roundKeys, _rounds, iv, zero, out, 1);
+        return;
+    }
+#endif
+    aesCfbEncryptBlocksScalar(_roundKeys, _rounds, iv, zero, out, 1);
+}
+
+// name of kernel selected by runtime dispatch
+const char *SsAes::kernel() {
+    return hardware() ? "aes-ni" : "scalar";
+}
+
+// AES-NI kernels usable, they byte swap counters with SSSE3
+bool SsAes::hardware() {
+#if defined(HAVE_X86_AESNI_INTRINSICS)
+    return SsCpu::supports(SsCpu::Feature::CF_AESNI) &&
+           SsCpu::supports(SsCpu::Feature::CF_SSSE3);
+#else
+    return false;
+#endif
+}
+
+// SsAesCtr constructor
+SsAesCtr::SsAesCtr(const uint8_t *key, size_t keySize, const uint8_t *iv) :
+    SsAes(key, keySize), _kernel(&aesCtrBlocksScalar) {
+    std::memcpy(_counter, iv, BLOCK_SIZE);
+#if defined(HAVE_X86_AESNI_INTRINSICS)
+    if (hardware()) {
+        _kernel = &aesCtrBlocksNi;
+    }
+#endif
+}
+
+// xor keystream, whole blocks go through the selected kernel
+void SsAesCtr::crypt(const uint8_t *in, uint8_t *out, size_t size) {
+    for (; _leftover != 0 && size != 0; --_leftover, --size) {
+        *out++ = *in++ ^ _keystream[BLOCK_SIZE - _leftover];
+    }
+
+    auto blocks = size / BLOCK_SIZE;
+    if (blocks != 0) {
+        _kernel(_roundKeys, _rounds, _counter, in, out, blocks);
+        in += blocks * BLOCK_SIZE;
+        out += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+    }
+
+    if (size != 0) {
+        std::memset(_keystream, 0, sizeof(_keystream));
+        _kernel(_roundKeys, _rounds, _counter, _keystream, _keystream, 1);
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = in[i] ^ _keystream[i];
+        }
+        _leftover = BLOCK_SIZE - size;
+    }
+}
+
+// SsAesCfb constructor
+SsAesCfb::SsAesCfb(const uint8_t *key, size_t keySize, const uint8_t *iv) :
+    SsAes(key, keySize),
+    _encryptKernel(&aesCfbEncryptBlocksScalar),
+    _decryptKernel(&aesCfbDecryptBlocksScalar) {
+    std::memcpy(_register, iv, BLOCK_SIZE);
+#if defined(HAVE_X86_AESNI_INTRINSICS)
+    if (hardware()) {
+        _encryptKernel = &aesCfbEncryptBlocksNi;
+        _decryptKernel = &aesCfbDecryptBlocksNi;
+    }
+#endif
+}
+
+// encrypt, each block depends on the previous ciphertext
+void SsAesCfb::encrypt(const uint8_t *in, uint8_t *out, size_t size) {
+    crypt<false>(in, out, size);
+}
+
+// decrypt, whole blocks are independent of each other
+void SsAesCfb::decrypt(const uint8_t *in, uint8_t *out, size_t size) {
+    crypt<true>(in, out, size);
+}
+
+// register holds ciphertext before _used and keystream after it
+template <bool Decrypt>
+void SsAesCfb::crypt(const uint8_t *in, uint8_t *out, size_t size) {
+    for (; _used != 0 && size != 0; --size) {
+        uint8_t c = Decrypt ? *in : *in ^ _register[_used];
+        *out++ = Decrypt ? *in ^ _register[_used] : c;
+        ++in;
+        _register[_used] = c;
+        _used = (_used + 1) % BLOCK_SIZE;
+    }
+
+    auto blocks = size / BLOCK_SIZE;
+    if (blocks != 0) {
+        (Decrypt ? _decryptKernel : _encryptKernel)(
+            _roundKeys, _rounds, _register, in, out, blocks);
+        in += blocks * BLOCK_SIZE;
+        out += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+    }
+
+    if (size != 0) {
+        encryptBlock(_register, _register);
+        for (size_t i = 0; i < size; ++i) {
+            uint8_t c = Decrypt ? in[i] : in[i] ^ _register[i];
+            out[i] = Decrypt ? in[i] ^ _register[i] : c;
+            _register[i] = c;
+        }
+        _used = size;
+    }
+}
+
+// portable counter mode, one block per iteration
+void aesCtrBlocksScalar(const uint8_t *roundKeys, size_t rounds,
+                        uint8_t *counter, const uint8_t *in,
+                        uint8_t *out, size_t blocks) {
+    auto te = aesTable();
+    uint8_t keystream[SsAes::BLOCK_SIZE];
+
+    for (; blocks != 0; --blocks) {
+        aesEncryptScalar(roundKeys, rounds, te, counter, keystream);
+        for (size_t i = 0; i < SsAes::BLOCK_SIZE; ++i) {
+            *out++ = *in++ ^ keystream[i];
+        }
+        for (size_t i = SsAes::BLOCK_SIZE; i != 0 && ++counter[i - 1] == 0;
+             --i) {
+            ;
+        }
+    }
+}
+
+// portable feedback encryption, iv ends as the last ciphertext block
+void aesCfbEncryptBlocksScalar(const uint8_t *roundKeys, size_t rounds,
+                               uint8_t *iv, const uint8_t *in,
+                               uint8_t *out, size_t blocks) {
+    auto te = aesTable();
+
+    for (; blocks != 0; --blocks) {
+        aesEncryptScalar(roundKeys, rounds, te, iv, iv);
+        for (size_t i = 0; i < SsAes::BLOCK_SIZE; ++i) {
+            iv[i] ^= *in++;
+            *out++ = iv[i];
+        }
+    }
+}
+
+// portable feedback decryption, iv ends as the last ciphertext block
+void aesCfbDecryptBlocksScalar(const uint8_t *roundKeys, size_t rounds,
+                               uint8_t *iv, const uint8_t *in,
+                               uint8_t *out, size_t blocks) {
+    auto te = aesTable();
+
+    for (; blocks != 0; --blocks) {
+        aesEncryptScalar(roundKeys, rounds, te, iv, iv);
+        for (size_t i = 0; i < SsAes::BLOCK_SIZE; ++i) {
+            uint8_t c = *in++;
+            *out++ = c ^ iv[i];
+            iv[i] = c;
+        }
+    }
+}
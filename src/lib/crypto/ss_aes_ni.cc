@@ -0,0 +1,168 @@
+#include "shadowsocks/crypto/ss_aes.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+#include "shadowsocks/crypto/ss_bytes.h"
+
+#if defined(HAVE_X86_AESNI_INTRINSICS)
+#include <immintrin.h>
+
+
+/* blocks in flight, enough to cover the aesenc latency */
+#define AES_NI_LANES                    (8)
+
+#define AES_NI_LOAD(P)                                                        \
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(P))
+#define AES_NI_STORE(P, V)                                                    \
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(P), V)
+
+
+// load expanded key schedule into registers
+SS_CPU_TARGET("aes,ssse3")
+static inline void aesNiLoadKeys(const uint8_t *roundKeys, size_t rounds,
+                                 __m128i *keys) {
+    for (size_t i = 0; i <= rounds; ++i) {
+        keys[i] = AES_NI_LOAD(roundKeys + i * SsAes::BLOCK_SIZE);
+    }
+}
+
+// big-endian counter block, then advance the counter
+SS_CPU_TARGET("aes,ssse3")
+static inline __m128i aesNiCounter(uint64_t &high, uint64_t &low) {
+    const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                      8, 9, 10, 11, 12, 13, 14, 15);
+    auto block = _mm_shuffle_epi8(
+        _mm_set_epi64x(static_cast<long long>(high),
+                       static_cast<long long>(low)), swap);
+    high += ++low == 0;
+
+    return block;
+}
+
+// encrypt one block
+SS_CPU_TARGET("aes,ssse3")
+static inline __m128i aesNiEncrypt(__m128i block, const __m128i *keys,
+                                   size_t rounds) {
+    block = _mm_xor_si128(block, keys[0]);
+    for (size_t i = 1; i < rounds; ++i) {
+        block = _mm_aesenc_si128(block, keys[i]);
+    }
+
+    return _mm_aesenclast_si128(block, keys[rounds]);
+}
+
+// encrypt AES_NI_LANES independent blocks, rounds interleaved
+SS_CPU_TARGET("aes,ssse3")
+static inline void aesNiEncryptLanes(__m128i *blocks, const __m128i *keys,
+                                     size_t rounds) {
+    for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+        blocks[lane] = _mm_xor_si128(blocks[lane], keys[0]);
+    }
+    for (size_t i = 1; i < rounds; ++i) {
+        for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+            blocks[lane] = _mm_aesenc_si128(blocks[lane], keys[i]);
+        }
+    }
+    for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+        blocks[lane] = _mm_aesenclast_si128(blocks[lane], keys[rounds]);
+    }
+}
+
+// counter mode, eight counters per iteration
+SS_CPU_TARGET("aes,ssse3")
+void aesCtrBlocksNi(const uint8_t *roundKeys, size_t rounds,
+                    uint8_t *counter, const uint8_t *in,
+                    uint8_t *out, size_t blocks) {
+    __m128i keys[SsAes::MAX_ROUNDS + 1];
+    aesNiLoadKeys(roundKeys, rounds, keys);
+
+    // counter is kept as two native words, byte swapped into blocks
+    uint64_t high = loadBigEndian64(counter);
+    uint64_t low = loadBigEndian64(counter + 8);
+
+    for (; blocks >= AES_NI_LANES; blocks -= AES_NI_LANES) {
+        __m128i lanes[AES_NI_LANES];
+        for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+            lanes[lane] = aesNiCounter(high, low);
+        }
+
+        aesNiEncryptLanes(lanes, keys, rounds);
+        for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+            AES_NI_STORE(out, _mm_xor_si128(lanes[lane], AES_NI_LOAD(in)));
+            in += SsAes::BLOCK_SIZE;
+            out += SsAes::BLOCK_SIZE;
+        }
+    }
+
+    for (; blocks != 0; --blocks) {
+        auto keystream = aesNiEncrypt(aesNiCounter(high, low),
+                                      keys, rounds);
+        AES_NI_STORE(out, _mm_xor_si128(keystream, AES_NI_LOAD(in)));
+        in += SsAes::BLOCK_SIZE;
+        out += SsAes::BLOCK_SIZE;
+    }
+
+    storeBigEndian64(counter, high);
+    storeBigEndian64(counter + 8, low);
+}
+
+// feedback encryption is inherently serial, one block at a time
+SS_CPU_TARGET("aes,ssse3")
+void aesCfbEncryptBlocksNi(const uint8_t *roundKeys, size_t rounds,
+                           uint8_t *iv, const uint8_t *in,
+                           uint8_t *out, size_t blocks) {
+    __m128i keys[SsAes::MAX_ROUNDS + 1];
+    aesNiLoadKeys(roundKeys, rounds, keys);
+
+    auto feedback = AES_NI_LOAD(iv);
+    for (; blocks != 0; --blocks) {
+        feedback = _mm_xor_si128(aesNiEncrypt(feedback, keys, rounds),
+                                 AES_NI_LOAD(in));
+        AES_NI_STORE(out, feedback);
+        in += SsAes::BLOCK_SIZE;
+        out += SsAes::BLOCK_SIZE;
+    }
+
+    AES_NI_STORE(iv, feedback);
+}
+
+// feedback decryption, ciphertext is known so eight blocks run at once
+SS_CPU_TARGET("aes,ssse3")
+void aesCfbDecryptBlocksNi(const uint8_t *roundKeys, size_t rounds,
+                           uint8_t *iv, const uint8_t *in,
+                           uint8_t *out, size_t blocks) {
+    __m128i keys[SsAes::MAX_ROUNDS + 1];
+    aesNiLoadKeys(roundKeys, rounds, keys);
+
+    auto feedback = AES_NI_LOAD(iv);
+    for (; blocks >= AES_NI_LANES; blocks -= AES_NI_LANES) {
+        // read all ciphertext first, in and out may alias
+        __m128i ciphertext[AES_NI_LANES];
+        __m128i lanes[AES_NI_LANES];
+        for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+            ciphertext[lane] = AES_NI_LOAD(in + lane * SsAes::BLOCK_SIZE);
+            lanes[lane] = lane == 0 ? feedback : ciphertext[lane - 1];
+        }
+        feedback = ciphertext[AES_NI_LANES - 1];
+
+        aesNiEncryptLanes(lanes, keys, rounds);
+        for (size_t lane = 0; lane < AES_NI_LANES; ++lane) {
+            AES_NI_STORE(out + lane * SsAes::BLOCK_SIZE,
+                         _mm_xor_si128(lanes[lane], ciphertext[lane]));
+        }
+        in += AES_NI_LANES * SsAes::BLOCK_SIZE;
+        out += AES_NI_LANES * SsAes::BLOCK_SIZE;
+    }
+
+    for (; blocks != 0; --blocks) {
+        auto ciphertext = AES_NI_LOAD(in);
+        AES_NI_STORE(out, _mm_xor_si128(aesNiEncrypt(feedback, keys, rounds),
+                                        ciphertext));
+        feedback = ciphertext;
+        in += SsAes::BLOCK_SIZE;
+        out += SsAes::BLOCK_SIZE;
+    }
+
+    AES_NI_STORE(iv, feedback);
+}
+
+
+#endif // HAVE_X86_AESNI_INTRINSICS
@@ -0,0 +1,310 @@
+#include "shadowsocks/crypto/ss_chacha20.h"
+#include "shadowsocks/crypto/ss_poly1305.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+#include "shadowsocks/crypto/ss_bytes.h"
+
+
+/* "expand 32-byte k" */
+static const uint32_t CHACHA20_CONSTANTS[4] = {
+    0x61707865, 0x3320646e, 0x79622d32, 0x6b206574
+};
+
+#define CHACHA20_QUARTER_ROUND(A, B, C, D)                                    \
+    do {                                                                      \
+        A += B; D ^= A; D = ROTL32(D, 16);                                    \
+        C += D; B ^= C; B = ROTL32(B, 12);                                    \
+        A += B; D ^= A; D = ROTL32(D, 8);                                     \
+        C += D; B ^= C; B = ROTL32(B, 7);                                     \
+    } while (0)
+
+#define CHACHA20_DOUBLE_ROUND(X)                                              \
+    do {                                                                      \
+        CHACHA20_QUARTER_ROUND(X[0], X[4], X[8], X[12]);                      \
+        CHACHA20_QUARTER_ROUND(X[1], X[5], X[9], X[13]);                      \
+        CHACHA20_QUARTER_ROUND(X[2], X[6], X[10], X[14]);                     \
+        CHACHA20_QUARTER_ROUND(X[3], X[7], X[11], X[15]);                     \
+        CHACHA20_QUARTER_ROUND(X[0], X[5], X[10], X[15]);                     \
+        CHACHA20_QUARTER_ROUND(X[1], X[6], X[11], X[12]);                     \
+        CHACHA20_QUARTER_ROUND(X[2], X[7], X[8], X[13]);                      \
+        CHACHA20_QUARTER_ROUND(X[3], X[4], X[9], X[14]);                      \
+    } while (0)
+
+
+// fill state with constants, key and nonce words
+static void chacha20Setup(uint32_t *state, const uint8_t *key,
+                          const uint8_t *nonce, size_t nonceWords) {
+    std::memcpy(state, CHACHA20_CONSTANTS, sizeof(CHACHA20_CONSTANTS));
+    for (size_t i = 0; i < 8; ++i) {
+        state[4 + i] = loadLittleEndian32(key + i * 4);
+    }
+    for (size_t i = 0; i < nonceWords; ++i) {
+        state[16 - nonceWords + i] = loadLittleEndian32(nonce + i * 4);
+    }
+}
+
+// SsChaCha20 constructor
+SsChaCha20::SsChaCha20(const uint8_t *key, const uint8_t *nonce,
+                       uint32_t counter) : _kernel(dispatch()) {
+    chacha20Setup(_state, key, nonce, NONCE_SIZE / 4);
+    _state[12] = counter;
+}
+
+// xor keystream, whole blocks go through the selected kernel
+void SsChaCha20::crypt(const uint8_t *in, uint8_t *out, size_t size) {
+    for (; _leftover != 0 && size != 0; --_leftover, --size) {
+        *out++ = *in++ ^ _keystream[BLOCK_SIZE - _leftover];
+    }
+
+    auto blocks = size / BLOCK_SIZE;
+    if (blocks != 0) {
+        _kernel(_state, in, out, blocks);
+        in += blocks * BLOCK_SIZE;
+        out += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+    }
+
+    if (size != 0) {
+        std::memset(_keystream, 0, sizeof(_keystream));
+        chacha20BlocksScalar(_state, _keystream, _keystream, 1);
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = in[i] ^ _keystream[i];
+        }
+        _leftover = BLOCK_SIZE - size;
+    }
+}
+
+// derive extended nonce subkey
+void SsChaCha20::hchacha20(const uint8_t *key, const uint8_t *nonce,
+                           uint8_t *subkey) {
+    uint32_t x[16];
+    chacha20Setup(x, key, nonce, HNONCE_SIZE / 4);
+
+    for (size_t i = 0; i < 10; ++i) {
+        CHACHA20_DOUBLE_ROUND(x);
+    }
+
+    for (size_t i = 0; i < 4; ++i) {
+        storeLittleEndian32(subkey + i * 4, x[i]);
+        storeLittleEndian32(subkey + 16 + i * 4, x[12 + i]);
+    }
+}
+
+// name of kernel selected by runtime dispatch
+const char *SsChaCha20::kernel() {
+    auto selected = dispatch();
+#if defined(HAVE_X86_AVX2_INTRINSICS)
+    if (selected == &chacha20BlocksAvx2) {
+        return "avx2";
+    }
+#endif
+#if defined(HAVE_X86_SSSE3_INTRINSICS)
+    if (selected == &chacha20BlocksSsse3) {
+        return "ssse3";
+    }
+#endif
+    return selected == &chacha20BlocksScalar ? "scalar" : "unknown";
+}
+
+// select block kernel
+SsChaCha20::Kernel SsChaCha20::dispatch() {
+#if defined(HAVE_X86_AVX2_INTRINSICS)
+    if (SsCpu::supports(SsCpu::Feature::CF_AVX2)) {
+        return &chacha20BlocksAvx2;
+    }
+#endif
+#if defined(HAVE_X86_SSSE3_INTRINSICS)
+    if (SsCpu::supports(SsCpu::Feature::CF_SSSE3)) {
+        return &chacha20BlocksSsse3;
+    }
+#endif
+    return &chacha20BlocksScalar;
+}
+
+// portable block function, one block per iteration
+void chacha20BlocksScalar(uint32_t *state, const uint8_t *in,
+                          uint8_t *out, size_t blocks) {
+    uint32_t x[16];
+
+    for (; blocks != 0; --blocks, in += 64, out += 64) {
+        std::memcpy(x, state, sizeof(x));
+        for (size_t i = 0; i < 10; ++i) {
+            CHACHA20_DOUBLE_ROUND(x);
+        }
+
+        for (size_t i = 0; i < 16; ++i) {
+            storeLittleEndian32(out + i * 4,
+                loadLittleEndian32(in + i * 4) ^ (x[i] + state[i]));
+        }
+        ++state[12];
+    }
+}
+
+
+// encrypt and append tag
+void SsChaCha20Poly1305::seal(const uint8_t *key, const uint8_t *nonce,
+                              const uint8_t *aad, size_t aadSize,
+                              const uint8_t *in, size_t size, uint8_t *out) {
+    SsChaCha20 chacha20(key, nonce);
+    uint8_t polyKey[SsChaCha20::BLOCK_SIZE] = {0};
+    chacha20.crypt(polyKey, polyKey, sizeof(polyKey));
+
+    chacha20.crypt(in, out, size);
+    authenticate(polyKey, aad, aadSize, out, size, out + size);
+}
+
+// verify tag then decrypt, size includes the tag
+bool SsChaCha20Poly1305::open(const uint8_t *key, const uint8_t *nonce,
+                              const uint8_t *aad, size_t aadSize,
+                              const uint8_t *in, size_t size, uint8_t *out) {
+    if (size < TAG_SIZE) {
+        return false;
+    }
+    size -= TAG_SIZE;
+
+    SsChaCha20 chacha20(key, nonce);
+    uint8_t polyKey[SsChaCha20::BLOCK_SIZE] = {0};
+    chacha20.crypt(polyKey, polyKey, sizeof(polyKey));
+
+    uint8_t tag[TAG_SIZE];
+    authenticate(polyKey, aad, aadSize, in, size, tag);
+    if (!SsPoly1305::verify(tag, in + size)) {
+        return false;
+    }
+
+    chacha20.crypt(in, out, size);
+    return true;
+}
+
+// seal with 24 bytes nonce through HChaCha20 subkey
+void SsChaCha20Poly1305::xseal(const uint8_t *key, const uint8_t *nonce,
+                               const uint8_t *aad, size_t aadSize,
+                               const uint8_t *in, size_t size, uint8_t *out) {
+    uint8_t subkey[KEY_SIZE];
+    uint8_t subnonce[NONCE_SIZE];
+    extend(key, nonce, subkey, subnonce);
+
+    seal(subkey, subnonce, aad, aadSize, in, size, out);
+}
+
+// open with 24 bytes nonce through HChaCha20 subkey
+bool SsChaCha20Poly1305::xopen(const uint8_t *key, const uint8_t *nonce,
+                               const uint8_t *aad, size_t aadSize,
+                               const uint8_t *in, size_t size, uint8_t *out) {
+    uint8_t subkey[KEY_SIZE];
+    uint8_t subnonce[NONCE_SIZE];
+    extend(key, nonce, subkey, subnonce);
+
+    return open(subkey, subnonce, aad, aadSize, in, size, out);
+}
+
+// seal plaintext scattered over a chain into contiguous out
+void SsChaCha20Poly1305::seal(const uint8_t *key, const uint8_t *nonce,
+                              const uint8_t *aad, size_t aadSize,
+                              const SsBufferChain &in, size_t size,
+                              uint8_t *out) {
+    SsChaCha20 chacha20(key, nonce);
+    uint8_t polyKey[SsChaCha20::BLOCK_SIZE] = {0};
+    chacha20.crypt(polyKey, polyKey, sizeof(polyKey));
+
+    auto ciphertext = out;
+    in.visit(0, size, [&] (const uint8_t *data, size_t length) {
+        chacha20.crypt(data, ciphertext, length);
+        ciphertext += length;
+    });
+    authenticate(polyKey, aad, aadSize, out, size, out + size);
+}
+
+// verify a chunk scattered over a chain, then decrypt into contiguous out
+bool SsChaCha20Poly1305::open(const uint8_t *key, const uint8_t *nonce,
+                              const uint8_t *aad, size_t aadSize,
+                              const SsBufferChain &in, size_t size,
+                              uint8_t *out) {
+    if (size < TAG_SIZE || size > in.size()) {
+        return false;
+    }
+    size -= TAG_SIZE;
+
+    SsChaCha20 chacha20(key, nonce);
+    uint8_t polyKey[SsChaCha20::BLOCK_SIZE] = {0};
+    chacha20.crypt(polyKey, polyKey, sizeof(polyKey));
+
+    SsPoly1305 poly1305(polyKey);
+    poly1305.update(aad, aadSize);
+    poly1305.pad();
+    in.visit(0, size, [&] (const uint8_t *data, size_t length) {
+        poly1305.update(data, length);
+    });
+    poly1305.pad();
+
+    // tag itself may straddle two segments
+    uint8_t tag[TAG_SIZE];
+    uint8_t expected[TAG_SIZE];
+    finish(poly1305, aadSize, size, tag);
+    in.copy(size, expected, TAG_SIZE);
+    if (!SsPoly1305::verify(tag, expected)) {
+        return false;
+    }
+
+    in.visit(0, size, [&] (const uint8_t *data, size_t length) {
+        chacha20.crypt(data, out, length);
+        out += length;
+    });
+    return true;
+}
+
+// chain seal with 24 bytes nonce through HChaCha20 subkey
+void SsChaCha20Poly1305::xseal(const uint8_t *key, const uint8_t *nonce,
+                               const uint8_t *aad, size_t aadSize,
+                               const SsBufferChain &in, size_t size,
+                               uint8_t *out) {
+    uint8_t subkey[KEY_SIZE];
+    uint8_t subnonce[NONCE_SIZE];
+    extend(key, nonce, subkey, subnonce);
+
+    seal(subkey, subnonce, aad, aadSize, in, size, out);
+}
+
+// chain open with 24 bytes nonce through HChaCha20 subkey
+bool SsChaCha20Poly1305::xopen(const uint8_t *key, const uint8_t *nonce,
+                               const uint8_t *aad, size_t aadSize,
+                               const SsBufferChain &in, size_t size,
+                               uint8_t *out) {
+    uint8_t subkey[KEY_SIZE];
+    uint8_t subnonce[NONCE_SIZE];
+    extend(key, nonce, subkey, subnonce);
+
+    return open(subkey, subnonce, aad, aadSize, in, size, out);
+}
+
+// tag over padded aad, ciphertext and their lengths
+void SsChaCha20Poly1305::authenticate(const uint8_t *polyKey,
+                                      const uint8_t *aad, size_t aadSize,
+                                      const uint8_t *ciphertext, size_t size,
+                                      uint8_t *tag) {
+    SsPoly1305 poly1305(polyKey);
+    poly1305.update(aad, aadSize);
+    poly1305.pad();
+    poly1305.update(ciphertext, size);
+    poly1305.pad();
+
+    finish(poly1305, aadSize, size, tag);
+}
+
+// lengths block closes the tag
+void SsChaCha20Poly1305::finish(SsPoly1305 &poly1305, size_t aadSize,
+                                size_t size, uint8_t *tag) {
+    uint8_t lengths[16];
+    storeLittleEndian64(lengths, aadSize);
+    storeLittleEndian64(lengths + 8, size);
+    poly1305.update(lengths, sizeof(lengths));
+    poly1305.final(tag);
+}
+
+// HChaCha20 subkey and the nonce tail
+void SsChaCha20Poly1305::extend(const uint8_t *key, const uint8_t *nonce,
+                                uint8_t *subkey, uint8_t *subnonce) {
+    SsChaCha20::hchacha20(key, nonce, subkey);
+
+    std::memset(subnonce, 0, 4);
+    std::memcpy(subnonce + 4, nonce + SsChaCha20::HNONCE_SIZE, 8);
+}
@@ -0,0 +1,262 @@
+#include "shadowsocks/crypto/ss_chacha20.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+
+#if defined(HAVE_X86_SSSE3_INTRINSICS) || defined(HAVE_X86_AVX2_INTRINSICS)
+#include <immintrin.h>
+#endif
+
+
+/* word i of every block in its own register, blocks run in the lanes */
+#define CHACHA20_VECTOR_QUARTER_ROUND(A, B, C, D)                             \
+    A = VECTOR_ADD(A, B); D = VECTOR_XOR(D, A);                               \
+    D = VECTOR_SHUFFLE(D, rotate16);                                          \
+    C = VECTOR_ADD(C, D); B = VECTOR_XOR(B, C);                               \
+    B = VECTOR_OR(VECTOR_SHL(B, 12), VECTOR_SHR(B, 20));                      \
+    A = VECTOR_ADD(A, B); D = VECTOR_XOR(D, A);                               \
+    D = VECTOR_SHUFFLE(D, rotate8);                                           \
+    C = VECTOR_ADD(C, D); B = VECTOR_XOR(B, C);                               \
+    B = VECTOR_OR(VECTOR_SHL(B, 7), VECTOR_SHR(B, 25))
+
+#define CHACHA20_VECTOR_DOUBLE_ROUND()                                        \
+    CHACHA20_VECTOR_QUARTER_ROUND(x0, x4, x8, x12);                           \
+    CHACHA20_VECTOR_QUARTER_ROUND(x1, x5, x9, x13);                           \
+    CHACHA20_VECTOR_QUARTER_ROUND(x2, x6, x10, x14);                          \
+    CHACHA20_VECTOR_QUARTER_ROUND(x3, x7, x11, x15);                          \
+    CHACHA20_VECTOR_QUARTER_ROUND(x0, x5, x10, x15);                          \
+    CHACHA20_VECTOR_QUARTER_ROUND(x1, x6, x11, x12);                          \
+    CHACHA20_VECTOR_QUARTER_ROUND(x2, x7, x8, x13);                           \
+    CHACHA20_VECTOR_QUARTER_ROUND(x3, x4, x9, x14)
+
+/* 4x4 transpose of 32 bits words inside each 128 bits lane */
+#define CHACHA20_VECTOR_TRANSPOSE(A, B, C, D)                                 \
+    do {                                                                      \
+        auto t0 = VECTOR_UNPACKLO32(A, B);                                    \
+        auto t1 = VECTOR_UNPACKLO32(C, D);                                    \
+        auto t2 = VECTOR_UNPACKHI32(A, B);                                    \
+        auto t3 = VECTOR_UNPACKHI32(C, D);                                    \
+        A = VECTOR_UNPACKLO64(t0, t1);                                        \
+        B = VECTOR_UNPACKHI64(t0, t1);                                        \
+        C = VECTOR_UNPACKLO64(t2, t3);                                        \
+        D = VECTOR_UNPACKHI64(t2, t3);                                        \
+    } while (0)
+
+/* rounds, feed-forward and transpose over the VECTOR_* primitives */
+#define CHACHA20_VECTOR_BLOCKS(TYPE, COUNTERS)                                \
+    TYPE x0 = VECTOR_LOAD(0), x1 = VECTOR_LOAD(1);                            \
+    TYPE x2 = VECTOR_LOAD(2), x3 = VECTOR_LOAD(3);                            \
+    TYPE x4 = VECTOR_LOAD(4), x5 = VECTOR_LOAD(5);                            \
+    TYPE x6 = VECTOR_LOAD(6), x7 = VECTOR_LOAD(7);                            \
+    TYPE x8 = VECTOR_LOAD(8), x9 = VECTOR_LOAD(9);                            \
+    TYPE x10 = VECTOR_LOAD(10), x11 = VECTOR_LOAD(11);                        \
+    TYPE x12 = COUNTERS, x13 = VECTOR_LOAD(13);                               \
+    TYPE x14 = VECTOR_LOAD(14), x15 = VECTOR_LOAD(15);                        \
+                                                                              \
+    for (size_t i = 0; i < 10; ++i) {                                         \
+        CHACHA20_VECTOR_DOUBLE_ROUND();                                       \
+    }                                                                         \
+                                                                              \
+    x0 = VECTOR_ADD(x0, VECTOR_LOAD(0));                                      \
+    x1 = VECTOR_ADD(x1, VECTOR_LOAD(1));                                      \
+    x2 = VECTOR_ADD(x2, VECTOR_LOAD(2));                                      \
+    x3 = VECTOR_ADD(x3, VECTOR_LOAD(3));                                      \
+    x4 = VECTOR_ADD(x4, VECTOR_LOAD(4));                                      \
+    x5 = VECTOR_ADD(x5, VECTOR_LOAD(5));                                      \
+    x6 = VECTOR_ADD(x6, VECTOR_LOAD(6));                                      \
+    x7 = VECTOR_ADD(x7, VECTOR_LOAD(7));                                      \
+    x8 = VECTOR_ADD(x8, VECTOR_LOAD(8));                                      \
+    x9 = VECTOR_ADD(x9, VECTOR_LOAD(9));                                      \
+    x10 = VECTOR_ADD(x10, VECTOR_LOAD(10));                                   \
+    x11 = VECTOR_ADD(x11, VECTOR_LOAD(11));                                   \
+    x12 = VECTOR_ADD(x12, COUNTERS);                                          \
+    x13 = VECTOR_ADD(x13, VECTOR_LOAD(13));                                   \
+    x14 = VECTOR_ADD(x14, VECTOR_LOAD(14));                                   \
+    x15 = VECTOR_ADD(x15, VECTOR_LOAD(15));                                   \
+                                                                              \
+    CHACHA20_VECTOR_TRANSPOSE(x0, x1, x2, x3);                                \
+    CHACHA20_VECTOR_TRANSPOSE(x4, x5, x6, x7);                                \
+    CHACHA20_VECTOR_TRANSPOSE(x8, x9, x10, x11);                              \
+    CHACHA20_VECTOR_TRANSPOSE(x12, x13, x14, x15)
+
+
+/* tails this long run through one staged vector batch, shorter go scalar */
+#define CHACHA20_STAGED_TAIL_MIN        (2)
+
+
+#if defined(HAVE_X86_SSSE3_INTRINSICS)
+#define VECTOR_LOAD(I)          _mm_set1_epi32(static_cast<int>(state[I]))
+#define VECTOR_ADD(A, B)        _mm_add_epi32(A, B)
+#define VECTOR_XOR(A, B)        _mm_xor_si128(A, B)
+#define VECTOR_OR(A, B)         _mm_or_si128(A, B)
+#define VECTOR_SHL(A, N)        _mm_slli_epi32(A, N)
+#define VECTOR_SHR(A, N)        _mm_srli_epi32(A, N)
+#define VECTOR_SHUFFLE(A, B)    _mm_shuffle_epi8(A, B)
+#define VECTOR_UNPACKLO32(A, B) _mm_unpacklo_epi32(A, B)
+#define VECTOR_UNPACKHI32(A, B) _mm_unpackhi_epi32(A, B)
+#define VECTOR_UNPACKLO64(A, B) _mm_unpacklo_epi64(A, B)
+#define VECTOR_UNPACKHI64(A, B) _mm_unpackhi_epi64(A, B)
+
+// xor 16 bytes of input with a keystream row
+SS_CPU_TARGET("ssse3")
+static inline void chacha20Store128(const uint8_t *in, uint8_t *out,
+                                    __m128i row) {
+    auto data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm_xor_si128(data, row));
+}
+
+// four blocks in parallel, 128 bits lanes
+SS_CPU_TARGET("ssse3")
+static void chacha20Blocks4Ssse3(uint32_t *state, const uint8_t *in,
+                                 uint8_t *out) {
+    const __m128i rotate16 = _mm_set_epi8(
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m128i rotate8 = _mm_set_epi8(
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3);
+    const __m128i counters = _mm_add_epi32(
+        _mm_set1_epi32(static_cast<int>(state[12])), _mm_set_epi32(3, 2, 1, 0));
+
+    CHACHA20_VECTOR_BLOCKS(__m128i, counters);
+
+    chacha20Store128(in, out, x0);
+    chacha20Store128(in + 16, out + 16, x4);
+    chacha20Store128(in + 32, out + 32, x8);
+    chacha20Store128(in + 48, out + 48, x12);
+    chacha20Store128(in + 64, out + 64, x1);
+    chacha20Store128(in + 80, out + 80, x5);
+    chacha20Store128(in + 96, out + 96, x9);
+    chacha20Store128(in + 112, out + 112, x13);
+    chacha20Store128(in + 128, out + 128, x2);
+    chacha20Store128(in + 144, out + 144, x6);
+    chacha20Store128(in + 160, out + 160, x10);
+    chacha20Store128(in + 176, out + 176, x14);
+    chacha20Store128(in + 192, out + 192, x3);
+    chacha20Store128(in + 208, out + 208, x7);
+    chacha20Store128(in + 224, out + 224, x11);
+    chacha20Store128(in + 240, out + 240, x15);
+
+    state[12] += 4;
+}
+
+// SSSE3 kernel, four blocks per iteration, a short tail is staged
+void chacha20BlocksSsse3(uint32_t *state, const uint8_t *in,
+                         uint8_t *out, size_t blocks) {
+    for (; blocks >= 4; blocks -= 4, in += 256, out += 256) {
+        chacha20Blocks4Ssse3(state, in, out);
+    }
+
+    if (blocks >= CHACHA20_STAGED_TAIL_MIN) {
+        uint8_t staged[256];
+        std::memcpy(staged, in, blocks * 64);
+        chacha20Blocks4Ssse3(state, staged, staged);
+        std::memcpy(out, staged, blocks * 64);
+        state[12] -= static_cast<uint32_t>(4 - blocks);
+    } else {
+        chacha20BlocksScalar(state, in, out, blocks);
+    }
+}
+
+#undef VECTOR_LOAD
+#undef VECTOR_ADD
+#undef VECTOR_XOR
+#undef VECTOR_OR
+#undef VECTOR_SHL
+#undef VECTOR_SHR
+#undef VECTOR_SHUFFLE
+#undef VECTOR_UNPACKLO32
+#undef VECTOR_UNPACKHI32
+#undef VECTOR_UNPACKLO64
+#undef VECTOR_UNPACKHI64
+#endif
+
+
+#if defined(HAVE_X86_AVX2_INTRINSICS)
+#define VECTOR_LOAD(I)          _mm256_set1_epi32(static_cast<int>(state[I]))
+#define VECTOR_ADD(A, B)        _mm256_add_epi32(A, B)
+#define VECTOR_XOR(A, B)        _mm256_xor_si256(A, B)
+#define VECTOR_OR(A, B)         _mm256_or_si256(A, B)
+#define VECTOR_SHL(A, N)        _mm256_slli_epi32(A, N)
+#define VECTOR_SHR(A, N)        _mm256_srli_epi32(A, N)
+#define VECTOR_SHUFFLE(A, B)    _mm256_shuffle_epi8(A, B)
+#define VECTOR_UNPACKLO32(A, B) _mm256_unpacklo_epi32(A, B)
+#define VECTOR_UNPACKHI32(A, B) _mm256_unpackhi_epi32(A, B)
+#define VECTOR_UNPACKLO64(A, B) _mm256_unpacklo_epi64(A, B)
+#define VECTOR_UNPACKHI64(A, B) _mm256_unpackhi_epi64(A, B)
+
+// xor two 32 bytes half blocks with keystream rows from two lanes
+SS_CPU_TARGET("avx2")
+static inline void chacha20Store256(const uint8_t *in, uint8_t *out,
+                                    __m256i low, __m256i high) {
+    auto first = _mm256_permute2x128_si256(low, high, 0x20);
+    auto second = _mm256_permute2x128_si256(low, high, 0x31);
+
+    auto data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                        _mm256_xor_si256(data, first));
+    data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 256));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 256),
+                        _mm256_xor_si256(data, second));
+}
+
+// eight blocks in parallel, 256 bits lanes
+SS_CPU_TARGET("avx2")
+static void chacha20Blocks8Avx2(uint32_t *state, const uint8_t *in,
+                                uint8_t *out) {
+    const __m256i rotate16 = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+    const __m256i rotate8 = _mm256_broadcastsi128_si256(_mm_set_epi8(
+        14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+    const __m256i counters = _mm256_add_epi32(
+        _mm256_set1_epi32(static_cast<int>(state[12])),
+        _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+    CHACHA20_VECTOR_BLOCKS(__m256i, counters);
+
+    // lane 0 holds blocks 0-3, lane 1 holds blocks 4-7
+    chacha20Store256(in, out, x0, x4);
+    chacha20Store256(in + 32, out + 32, x8, x12);
+    chacha20Store256(in + 64, out + 64, x1, x5);
+    chacha20Store256(in + 96, out + 96, x9, x13);
+    chacha20Store256(in + 128, out + 128, x2, x6);
+    chacha20Store256(in + 160, out + 160, x10, x14);
+    chacha20Store256(in + 192, out + 192, x3, x7);
+    chacha20Store256(in + 224, out + 224, x11, x15);
+
+    state[12] += 8;
+}
+
+// AVX2 kernel, eight blocks per iteration then narrower tails
+void chacha20BlocksAvx2(uint32_t *state, const uint8_t *in,
+                        uint8_t *out, size_t blocks) {
+    for (; blocks >= 8; blocks -= 8, in += 512, out += 512) {
+        chacha20Blocks8Avx2(state, in, out);
+    }
+
+    // more than half a batch left, one staged batch beats narrow kernels
+    if (blocks > 4) {
+        uint8_t staged[512];
+        std::memcpy(staged, in, blocks * 64);
+        chacha20Blocks8Avx2(state, staged, staged);
+        std::memcpy(out, staged, blocks * 64);
+        state[12] -= static_cast<uint32_t>(8 - blocks);
+        return;
+    }
+
+#if defined(HAVE_X86_SSSE3_INTRINSICS)
+    chacha20BlocksSsse3(state, in, out, blocks);
+#else
+    chacha20BlocksScalar(state, in, out, blocks);
+#endif
+}
+
+#undef VECTOR_LOAD
+#undef VECTOR_ADD
+#undef VECTOR_XOR
+#undef VECTOR_OR
+#undef VECTOR_SHL
+#undef VECTOR_SHR
+#undef VECTOR_SHUFFLE
+#undef VECTOR_UNPACKLO32
+#undef VECTOR_UNPACKHI32
+#undef VECTOR_UNPACKLO64
+#undef VECTOR_UNPACKHI64
+#endif
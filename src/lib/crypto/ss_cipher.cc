@@ -0,0 +1,275 @@
+#include "shadowsocks/crypto/ss_cipher.h"
+#include "shadowsocks/crypto/ss_chacha20.h"
+#include "shadowsocks/crypto/ss_digest.h"
+#include "shadowsocks/crypto/ss_random.h"
+#include "shadowsocks/ss_exception.h"
+
+
+#define CIPHER_SUBKEY_INFO              ("ss-subkey")
+
+
+// SsCipher constructor
+SsCipher::SsCipher(SsCipher::CipherMethod method, SsCipher::Key key) :
+    _method(method), _key(std::move(key)) {
+    if (_key.size() != keySize()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("%s requires key of %d bytes, got %d",
+                             method, keySize(), _key.size()));
+    }
+
+    std::memset(_subkey, 0, sizeof(_subkey));
+    std::memset(_nonce, 0, sizeof(_nonce));
+}
+
+// lookup cipher method by the name used in configuration
+SsCipher::CipherMethod SsCipher::method(const char *methodName) {
+    for (auto &method : methods()) {
+        if (std::strcmp(name(method), methodName) == 0) {
+            return method;
+        }
+    }
+
+    throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+        SsLogger::format("unsupported cipher method %s", methodName));
+}
+
+// name used in configuration
+const char *SsCipher::name(SsCipher::CipherMethod method) {
+    switch (method) {
+        case CipherMethod::CM_CHACHA20_IETF_POLY1305:
+            return "chacha20-ietf-poly1305";
+        case CipherMethod::CM_XCHACHA20_IETF_POLY1305:
+            return "xchacha20-ietf-poly1305";
+    }
+
+    return "unknown";
+}
+
+// all supported methods, in order of preference
+const std::vector<SsCipher::CipherMethod> &SsCipher::methods() {
+    static const std::vector<CipherMethod> methods = {
+        CipherMethod::CM_CHACHA20_IETF_POLY1305,
+        CipherMethod::CM_XCHACHA20_IETF_POLY1305
+    };
+
+    return methods;
+}
+
+// size of master key and session subkey
+size_t SsCipher::keySize() const {
+    return SsChaCha20Poly1305::KEY_SIZE;
+}
+
+// salt prefixed to every stream and packet
+size_t SsCipher::saltSize() const {
+    return keySize();
+}
+
+// size of the per message nonce
+size_t SsCipher::nonceSize() const {
+    return extendedNonce() ? SsChaCha20Poly1305::XNONCE_SIZE
+                           : SsChaCha20Poly1305::NONCE_SIZE;
+}
+
+// size of authenticate tag appended to each message
+size_t SsCipher::tagSize() const {
+    return SsChaCha20Poly1305::TAG_SIZE;
+}
+
+// nonce large enough to be chosen at random
+bool SsCipher::extendedNonce() const {
+    return _method == CipherMethod::CM_XCHACHA20_IETF_POLY1305;
+}
+
+// derive session subkey from the peer salt and restart nonce
+void SsCipher::setSalt(const uint8_t *salt) {
+    SsHkdf<SsSha1>::derive(_key.data(), _key.size(), salt, saltSize(),
+                           reinterpret_cast<const uint8_t*>(CIPHER_SUBKEY_INFO),
+                           std::strlen(CIPHER_SUBKEY_INFO),
+                           _subkey, keySize());
+    std::memset(_nonce, 0, sizeof(_nonce));
+}
+
+// generate a salt for our direction and derive subkey from it
+void SsCipher::newSalt(uint8_t *salt) {
+    SsRandom::fill(salt, saltSize());
+    setSalt(salt);
+}
+
+// seal one message with session subkey, out has size + tag bytes
+void SsCipher::seal(const uint8_t *in, size_t size, uint8_t *out) {
+    seal(_subkey, _nonce, in, size, out);
+    incrementNonce();
+}
+
+// open one message with session subkey, size includes the tag
+bool SsCipher::open(const uint8_t *in, size_t size, uint8_t *out) {
+    if (!open(_subkey, _nonce, in, size, out)) {
+        return false;
+    }
+
+    incrementNonce();
+    return true;
+}
+
+// seal and append to ciphertext stream
+void SsCipher::seal(const SsCipher::Stream &plaintext,
+                    SsCipher::Stream &ciphertext) {
+    auto offset = ciphertext.size();
+    ciphertext.resize(offset + plaintext.size() + tagSize());
+
+    seal(plaintext.data(), plaintext.size(), &ciphertext[offset]);
+}
+
+// open and append to plaintext stream
+bool SsCipher::open(const SsCipher::Stream &ciphertext,
+                    SsCipher::Stream &plaintext) {
+    if (ciphertext.size() < tagSize()) {
+        return false;
+    }
+
+    auto offset = plaintext.size();
+    plaintext.resize(offset + ciphertext.size() - tagSize());
+    if (!open(ciphertext.data(), ciphertext.size(), &plaintext[offset])) {
+        plaintext.resize(offset);
+        return false;
+    }
+
+    return true;
+}
+
+// seal head of a chain without linearising it, out has size + tag bytes
+void SsCipher::seal(const SsBufferChain &plaintext, size_t size,
+                    uint8_t *out) {
+    switch (_method) {
+        case CipherMethod::CM_CHACHA20_IETF_POLY1305:
+            SsChaCha20Poly1305::seal(_subkey, _nonce, nullptr, 0,
+                                     plaintext, size, out);
+            break;
+        case CipherMethod::CM_XCHACHA20_IETF_POLY1305:
+            SsChaCha20Poly1305::xseal(_subkey, _nonce, nullptr, 0,
+                                      plaintext, size, out);
+            break;
+    }
+    incrementNonce();
+}
+
+// open head of a chain without linearising it, size includes the tag
+bool SsCipher::open(const SsBufferChain &ciphertext, size_t size,
+                    uint8_t *out) {
+    bool opened = false;
+    switch (_method) {
+        case CipherMethod::CM_CHACHA20_IETF_POLY1305:
+            opened = SsChaCha20Poly1305::open(_subkey, _nonce, nullptr, 0,
+                                              ciphertext, size, out);
+            break;
+        case CipherMethod::CM_XCHACHA20_IETF_POLY1305:
+            opened = SsChaCha20Poly1305::xopen(_subkey, _nonce, nullptr, 0,
+                                               ciphertext, size, out);
+            break;
+    }
+
+    if (opened) {
+        incrementNonce();
+    }
+    return opened;
+}
+
+// classic packet, random salt then subkey sealed with zero nonce
+void SsCipher::sealPacket(const SsCipher::Stream &plaintext,
+                          SsCipher::Stream &packet) {
+    packet.resize(saltSize() + plaintext.size() + tagSize());
+    newSalt(packet.data());
+
+    seal(plaintext.data(), plaintext.size(), &packet[saltSize()]);
+}
+
+// classic packet, derive subkey from the leading salt
+bool SsCipher::openPacket(const SsCipher::Stream &packet,
+                          SsCipher::Stream &plaintext) {
+    if (packet.size() < saltSize() + tagSize()) {
+        return false;
+    }
+    setSalt(packet.data());
+
+    plaintext.resize(packet.size() - saltSize() - tagSize());
+    return open(&packet[saltSize()], packet.size() - saltSize(),
+                plaintext.data());
+}
+
+// random nonce packet under the master key, no per packet HKDF
+void SsCipher::sealDirectPacket(const SsCipher::Stream &plaintext,
+                                SsCipher::Stream &packet) {
+    assert(extendedNonce());
+
+    packet.resize(nonceSize() + plaintext.size() + tagSize());
+    SsRandom::fill(packet.data(), nonceSize());
+
+    seal(_key.data(), packet.data(), plaintext.data(), plaintext.size(),
+         &packet[nonceSize()]);
+}
+
+// random nonce packet under the master key, nonce leads the packet
+bool SsCipher::openDirectPacket(const SsCipher::Stream &packet,
+                                SsCipher::Stream &plaintext) {
+    assert(extendedNonce());
+    if (packet.size() < nonceSize() + tagSize()) {
+        return false;
+    }
+
+    plaintext.resize(packet.size() - nonceSize() - tagSize());
+    return open(_key.data(), packet.data(), &packet[nonceSize()],
+                packet.size() - nonceSize(), plaintext.data());
+}
+
+// dispatch seal by method
+void SsCipher::seal(const uint8_t *key, const uint8_t *nonce,
+                    const uint8_t *in, size_t size, uint8_t *out) {
+    switch (_method) {
+        case CipherMethod::CM_CHACHA20_IETF_POLY1305:
+            SsChaCha20Poly1305::seal(key, nonce, nullptr, 0, in, size, out);
+            break;
+        case CipherMethod::CM_XCHACHA20_IETF_POLY1305:
+            SsChaCha20Poly1305::xseal(key, nonce, nullptr, 0, in, size, out);
+            break;
+    }
+}
+
+// dispatch open by method
+bool SsCipher::open(const uint8_t *key, const uint8_t *nonce,
+                    const uint8_t *in, size_t size, uint8_t *out) {
+    switch (_method) {
+        case CipherMethod::CM_CHACHA20_IETF_POLY1305:
+            return SsChaCha20Poly1305::open(key, nonce, nullptr, 0,
+                                            in, size, out);
+        case CipherMethod::CM_XCHACHA20_IETF_POLY1305:
+            return SsChaCha20Poly1305::xopen(key, nonce, nullptr, 0,
+                                             in, size, out);
+    }
+
+    return false;
+}
+
+// little-endian nonce counter
+void SsCipher::incrementNonce() {
+    for (size_t i = 0; i < nonceSize() && ++_nonce[i] == 0; ++i) {
+        ;
+    }
+}
+
+// output cipher
+std::ostream &operator<<(std::ostream &out, SsCipher *cipher) {
+    out << "SsCipher["
+        << "method=" << cipher->_method
+        << "]";
+
+    return out;
+}
+
+// output method name
+std::ostream &operator<<(std::ostream &out,
+                         const SsCipher::CipherMethod &method) {
+    out << SsCipher::name(method);
+
+    return out;
+}
@@ -0,0 +1,118 @@
+#include "shadowsocks/crypto/ss_cpu.h"
+
+#if defined(SS_CPU_X86) && defined(HAVE_CPUID_H)
+#include <cpuid.h>
+#endif
+
+#define CPU_DISABLE_ENVIRONMENT         ("SS_CPU_DISABLE")
+
+
+// static members definition
+std::atomic<SsCpu::Features> SsCpu::_disabled{SsCpu::fromEnvironment()};
+
+
+// check feature detected and not disabled by override
+bool SsCpu::supports(SsCpu::Feature feature) {
+    return (enabled() & static_cast<Features>(feature)) != 0;
+}
+
+// features reported by the processor
+SsCpu::Features SsCpu::detected() {
+    static const Features features = detect();
+    return features;
+}
+
+// features used by runtime dispatch
+SsCpu::Features SsCpu::enabled() {
+    return detected() & ~_disabled.load(std::memory_order_relaxed);
+}
+
+// force kernels to fallback, e.g. compare implementations on one host
+void SsCpu::disable(SsCpu::Features features) {
+    _disabled.fetch_or(features, std::memory_order_relaxed);
+}
+
+// restore dispatch to the environment default
+void SsCpu::reset() {
+    _disabled.store(fromEnvironment(), std::memory_order_relaxed);
+}
+
+// query processor by cpuid
+SsCpu::Features SsCpu::detect() {
+    Features features = 0;
+#if defined(SS_CPU_X86) && defined(HAVE_CPUID_H)
+    unsigned int eax, ebx, ecx, edx;
+    auto add = [&] (bool supported, Feature feature) {
+        if (supported) {
+            features |= static_cast<Features>(feature);
+        }
+    };
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        add(ecx & bit_SSSE3, Feature::CF_SSSE3);
+        add(ecx & bit_SSE4_1, Feature::CF_SSE41);
+        add(ecx & bit_AES, Feature::CF_AESNI);
+        add(ecx & bit_PCLMUL, Feature::CF_PCLMUL);
+
+        // AVX state must be enabled by the operating system
+        auto osxsave = (ecx & bit_OSXSAVE) != 0;
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            add(ebx & bit_SHA, Feature::CF_SHA);
+
+            if (osxsave) {
+                uint32_t xcrLow, xcrHigh;
+                __asm__ ("xgetbv" : "=a" (xcrLow), "=d" (xcrHigh) : "c" (0));
+                add((ebx & bit_AVX2) && (xcrLow & 0x6) == 0x6,
+                    Feature::CF_AVX2);
+            }
+        }
+    }
+#endif
+    return features;
+}
+
+// parse SS_CPU_DISABLE=sha,avx2,... from environment
+SsCpu::Features SsCpu::fromEnvironment() {
+    static const std::pair<const char *, Feature> names[] = {
+        {"ssse3", Feature::CF_SSSE3},
+        {"sse4.1", Feature::CF_SSE41},
+        {"avx2", Feature::CF_AVX2},
+        {"aesni", Feature::CF_AESNI},
+        {"pclmul", Feature::CF_PCLMUL},
+        {"sha", Feature::CF_SHA}
+    };
+
+    auto environment = std::getenv(CPU_DISABLE_ENVIRONMENT);
+    if (environment == nullptr) {
+        return 0;
+    }
+
+    Features features = 0;
+    std::stringstream ss(environment);
+    for (std::string name; std::getline(ss, name, ',');) {
+        if (name == "all") {
+            features = ~static_cast<Features>(0);
+        }
+        for (auto &pair : names) {
+            if (name == pair.first) {
+                features |= static_cast<Features>(pair.second);
+            }
+        }
+    }
+
+    return features;
+}
+
+// output feature text
+std::ostream &operator<<(std::ostream &out, const SsCpu::Feature &feature) {
+    switch (feature) {
+        case SsCpu::Feature::CF_SSSE3:      out << "SSSE3";     break;
+        case SsCpu::Feature::CF_SSE41:      out << "SSE4.1";    break;
+        case SsCpu::Feature::CF_AVX2:       out << "AVX2";      break;
+        case SsCpu::Feature::CF_AESNI:      out << "AES-NI";    break;
+        case SsCpu::Feature::CF_PCLMUL:     out << "PCLMUL";    break;
+        case SsCpu::Feature::CF_SHA:        out << "SHA";       break;
+    }
+
+    return out;
+}
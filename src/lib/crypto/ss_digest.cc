@@ -0,0 +1,294 @@
+#include "shadowsocks/crypto/ss_digest.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+#include "shadowsocks/crypto/ss_bytes.h"
+
+
+static const uint32_t SHA1_IV[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+
+// SsBlockDigest constructor
+template <size_t StateWords, size_t DigestSize>
+SsBlockDigest<StateWords, DigestSize>::SsBlockDigest(
+        const uint32_t *iv, Compressor compressor) : _compressor(compressor) {
+    std::memcpy(_state, iv, sizeof(_state));
+}
+
+// absorb message, whole blocks go straight to the kernel
+template <size_t StateWords, size_t DigestSize>
+void SsBlockDigest<StateWords, DigestSize>::update(const void *data,
+                                                   size_t size) {
+    auto input = static_cast<const uint8_t*>(data);
+    _length += size;
+
+    if (_buffered != 0) {
+        auto fill = std::min<size_t>(BLOCK_SIZE - _buffered, size);
+        std::memcpy(_buffer + _buffered, input, fill);
+        _buffered += fill;
+        input += fill;
+        size -= fill;
+
+        if (_buffered != BLOCK_SIZE) {
+            return;
+        }
+        _compressor(_state, _buffer, 1);
+        _buffered = 0;
+    }
+
+    if (size >= BLOCK_SIZE) {
+        _compressor(_state, input, size / BLOCK_SIZE);
+        input += size & ~static_cast<size_t>(BLOCK_SIZE - 1);
+        size &= BLOCK_SIZE - 1;
+    }
+
+    if (size != 0) {
+        std::memcpy(_buffer, input, size);
+        _buffered = size;
+    }
+}
+
+// pad with message bit length and output digest
+template <size_t StateWords, size_t DigestSize>
+void SsBlockDigest<StateWords, DigestSize>::final(uint8_t *digest) {
+    auto bits = _length << 3;
+
+    _buffer[_buffered++] = 0x80;
+    if (_buffered > BLOCK_SIZE - 8) {
+        std::memset(_buffer + _buffered, 0, BLOCK_SIZE - _buffered);
+        _compressor(_state, _buffer, 1);
+        _buffered = 0;
+    }
+    std::memset(_buffer + _buffered, 0, BLOCK_SIZE - 8 - _buffered);
+    storeBigEndian32(_buffer + BLOCK_SIZE - 8, static_cast<uint32_t>(bits >> 32));
+    storeBigEndian32(_buffer + BLOCK_SIZE - 4, static_cast<uint32_t>(bits));
+    _compressor(_state, _buffer, 1);
+
+    for (size_t i = 0; i < DigestSize / 4; ++i) {
+        storeBigEndian32(digest + i * 4, _state[i]);
+    }
+}
+
+template class SsBlockDigest<5, 20>;
+template class SsBlockDigest<8, 32>;
+
+
+// SsSha1 constructor
+SsSha1::SsSha1() : SsBlockDigest(SHA1_IV, compressor()) {
+}
+
+// one-shot digest
+void SsSha1::digest(const void *data, size_t size, uint8_t *out) {
+    SsSha1 sha1;
+    sha1.update(data, size);
+    sha1.final(out);
+}
+
+// name of kernel selected by runtime dispatch
+const char *SsSha1::kernel() {
+#if defined(HAVE_X86_SHA_INTRINSICS)
+    if (compressor() == &sha1CompressShaNi) {
+        return "sha-ni";
+    }
+#endif
+    return "scalar";
+}
+
+// select compression kernel
+SsSha1::Compressor SsSha1::compressor() {
+#if defined(HAVE_X86_SHA_INTRINSICS)
+    if (SsCpu::supports(SsCpu::Feature::CF_SHA) &&
+            SsCpu::supports(SsCpu::Feature::CF_SSE41)) {
+        return &sha1CompressShaNi;
+    }
+#endif
+    return &sha1CompressScalar;
+}
+
+// SsSha256 constructor
+SsSha256::SsSha256() : SsBlockDigest(SHA256_IV, compressor()) {
+}
+
+// one-shot digest
+void SsSha256::digest(const void *data, size_t size, uint8_t *out) {
+    SsSha256 sha256;
+    sha256.update(data, size);
+    sha256.final(out);
+}
+
+// name of kernel selected by runtime dispatch
+const char *SsSha256::kernel() {
+#if defined(HAVE_X86_SHA_INTRINSICS)
+    if (compressor() == &sha256CompressShaNi) {
+        return "sha-ni";
+    }
+#endif
+    return "scalar";
+}
+
+// select compression kernel
+SsSha256::Compressor SsSha256::compressor() {
+#if defined(HAVE_X86_SHA_INTRINSICS)
+    if (SsCpu::supports(SsCpu::Feature::CF_SHA) &&
+            SsCpu::supports(SsCpu::Feature::CF_SSE41)) {
+        return &sha256CompressShaNi;
+    }
+#endif
+    return &sha256CompressScalar;
+}
+
+
+/* SHA-1 rounds with a 16 words rolling message schedule */
+#define SHA1_SCHEDULE(W, I)                                                   \
+    (W[(I) & 15] = ROTL32(W[((I) + 13) & 15] ^ W[((I) + 8) & 15] ^           \
+                          W[((I) + 2) & 15] ^ W[(I) & 15], 1))
+#define SHA1_ROUND(A, B, C, D, E, F, K, M)                                    \
+    do {                                                                      \
+        E += ROTL32(A, 5) + (F) + (K) + (M);                                  \
+        B = ROTL32(B, 30);                                                    \
+    } while (0)
+#define SHA1_F0(B, C, D)                (D ^ (B & (C ^ D)))
+#define SHA1_F1(B, C, D)                (B ^ C ^ D)
+#define SHA1_F2(B, C, D)                ((B & C) | (D & (B | C)))
+#define SHA1_R0(A, B, C, D, E, I)                                             \
+    SHA1_ROUND(A, B, C, D, E, SHA1_F0(B, C, D), 0x5a827999, W[I])
+#define SHA1_R1(A, B, C, D, E, I)                                             \
+    SHA1_ROUND(A, B, C, D, E, SHA1_F0(B, C, D), 0x5a827999, SHA1_SCHEDULE(W, I))
+#define SHA1_R2(A, B, C, D, E, I)                                             \
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1(B, C, D), 0x6ed9eba1, SHA1_SCHEDULE(W, I))
+#define SHA1_R3(A, B, C, D, E, I)                                             \
+    SHA1_ROUND(A, B, C, D, E, SHA1_F2(B, C, D), 0x8f1bbcdc, SHA1_SCHEDULE(W, I))
+#define SHA1_R4(A, B, C, D, E, I)                                             \
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1(B, C, D), 0xca62c1d6, SHA1_SCHEDULE(W, I))
+#define SHA1_FIVE(R, I)                                                       \
+    R(a, b, c, d, e, (I));                                                    \
+    R(e, a, b, c, d, (I) + 1);                                                \
+    R(d, e, a, b, c, (I) + 2);                                                \
+    R(c, d, e, a, b, (I) + 3);                                                \
+    R(b, c, d, e, a, (I) + 4)
+
+// portable SHA-1 compression, fully unrolled
+void sha1CompressScalar(uint32_t *state, const uint8_t *blocks, size_t count) {
+    uint32_t W[16];
+
+    for (; count != 0; --count, blocks += 64) {
+        for (size_t i = 0; i < 16; ++i) {
+            W[i] = loadBigEndian32(blocks + i * 4);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2];
+        uint32_t d = state[3], e = state[4];
+
+        SHA1_FIVE(SHA1_R0, 0);
+        SHA1_FIVE(SHA1_R0, 5);
+        SHA1_FIVE(SHA1_R0, 10);
+        SHA1_R0(a, b, c, d, e, 15);
+        SHA1_R1(e, a, b, c, d, 16);
+        SHA1_R1(d, e, a, b, c, 17);
+        SHA1_R1(c, d, e, a, b, 18);
+        SHA1_R1(b, c, d, e, a, 19);
+        SHA1_FIVE(SHA1_R2, 20);
+        SHA1_FIVE(SHA1_R2, 25);
+        SHA1_FIVE(SHA1_R2, 30);
+        SHA1_FIVE(SHA1_R2, 35);
+        SHA1_FIVE(SHA1_R3, 40);
+        SHA1_FIVE(SHA1_R3, 45);
+        SHA1_FIVE(SHA1_R3, 50);
+        SHA1_FIVE(SHA1_R3, 55);
+        SHA1_FIVE(SHA1_R4, 60);
+        SHA1_FIVE(SHA1_R4, 65);
+        SHA1_FIVE(SHA1_R4, 70);
+        SHA1_FIVE(SHA1_R4, 75);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+
+/* SHA-256 rounds with a 16 words rolling message schedule */
+#define SHA256_S0(X)                    (ROTR32(X, 2) ^ ROTR32(X, 13) ^ ROTR32(X, 22))
+#define SHA256_S1(X)                    (ROTR32(X, 6) ^ ROTR32(X, 11) ^ ROTR32(X, 25))
+#define SHA256_G0(X)                    (ROTR32(X, 7) ^ ROTR32(X, 18) ^ ((X) >> 3))
+#define SHA256_G1(X)                    (ROTR32(X, 17) ^ ROTR32(X, 19) ^ ((X) >> 10))
+#define SHA256_SCHEDULE(W, I)                                                 \
+    (W[(I) & 15] += SHA256_G1(W[((I) + 14) & 15]) + W[((I) + 9) & 15] +      \
+                    SHA256_G0(W[((I) + 1) & 15]))
+#define SHA256_ROUND(A, B, C, D, E, F, G, H, I, M)                            \
+    do {                                                                      \
+        uint32_t t1 = H + SHA256_S1(E) + (G ^ (E & (F ^ G))) +                \
+                      SHA256_K[I] + (M);                                      \
+        uint32_t t2 = SHA256_S0(A) + ((A & B) | (C & (A | B)));               \
+        D += t1;                                                              \
+        H = t1 + t2;                                                          \
+    } while (0)
+#define SHA256_EIGHT(I, M)                                                    \
+    SHA256_ROUND(a, b, c, d, e, f, g, h, (I), M(W, (I)));                     \
+    SHA256_ROUND(h, a, b, c, d, e, f, g, (I) + 1, M(W, (I) + 1));             \
+    SHA256_ROUND(g, h, a, b, c, d, e, f, (I) + 2, M(W, (I) + 2));             \
+    SHA256_ROUND(f, g, h, a, b, c, d, e, (I) + 3, M(W, (I) + 3));             \
+    SHA256_ROUND(e, f, g, h, a, b, c, d, (I) + 4, M(W, (I) + 4));             \
+    SHA256_ROUND(d, e, f, g, h, a, b, c, (I) + 5, M(W, (I) + 5));             \
+    SHA256_ROUND(c, d, e, f, g, h, a, b, (I) + 6, M(W, (I) + 6));             \
+    SHA256_ROUND(b, c, d, e, f, g, h, a, (I) + 7, M(W, (I) + 7))
+#define SHA256_MESSAGE(W, I)            (W[(I) & 15])
+
+// portable SHA-256 compression, fully unrolled
+void sha256CompressScalar(uint32_t *state, const uint8_t *blocks,
+                          size_t count) {
+    uint32_t W[16];
+
+    for (; count != 0; --count, blocks += 64) {
+        for (size_t i = 0; i < 16; ++i) {
+            W[i] = loadBigEndian32(blocks + i * 4);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        SHA256_EIGHT(0, SHA256_MESSAGE);
+        SHA256_EIGHT(8, SHA256_MESSAGE);
+        SHA256_EIGHT(16, SHA256_SCHEDULE);
+        SHA256_EIGHT(24, SHA256_SCHEDULE);
+        SHA256_EIGHT(32, SHA256_SCHEDULE);
+        SHA256_EIGHT(40, SHA256_SCHEDULE);
+        SHA256_EIGHT(48, SHA256_SCHEDULE);
+        SHA256_EIGHT(56, SHA256_SCHEDULE);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
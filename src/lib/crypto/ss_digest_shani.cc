@@ -0,0 +1,224 @@
+#include "shadowsocks/crypto/ss_digest.h"
+#include "shadowsocks/crypto/ss_cpu.h"
+
+#if defined(HAVE_X86_SHA_INTRINSICS)
+#include <immintrin.h>
+
+
+/* four SHA-1 rounds per group, message words kept in four registers */
+#define SHA1_NI_LOAD(M, OFFSET)                                               \
+    M = _mm_shuffle_epi8(_mm_loadu_si128(                                     \
+        reinterpret_cast<const __m128i*>(blocks + (OFFSET))), mask)
+#define SHA1_NI_GROUP(EN, EC, FUNC, MC)                                       \
+    EN = _mm_sha1nexte_epu32(EN, MC);                                         \
+    EC = abcd;                                                                \
+    abcd = _mm_sha1rnds4_epu32(abcd, EN, FUNC)
+#define SHA1_NI_MSG1(MP, MC)            MP = _mm_sha1msg1_epu32(MP, MC)
+#define SHA1_NI_XOR(MPP, MC)            MPP = _mm_xor_si128(MPP, MC)
+
+// SHA-1 compression with Intel SHA extensions
+SS_CPU_TARGET("sha,sse4.1")
+void sha1CompressShaNi(uint32_t *state, const uint8_t *blocks, size_t count) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+                                        0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(state)), 0x1b);
+    __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    __m128i e1, m0, m1, m2, m3;
+
+    for (; count != 0; --count, blocks += 64) {
+        auto abcdSave = abcd;
+        auto e0Save = e0;
+
+        // rounds 0-3
+        SHA1_NI_LOAD(m0, 0);
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        // rounds 4-15
+        SHA1_NI_LOAD(m1, 16);
+        SHA1_NI_GROUP(e1, e0, 0, m1);
+        SHA1_NI_MSG1(m0, m1);
+        SHA1_NI_LOAD(m2, 32);
+        SHA1_NI_GROUP(e0, e1, 0, m2);
+        SHA1_NI_MSG1(m1, m2);
+        SHA1_NI_XOR(m0, m2);
+        SHA1_NI_LOAD(m3, 48);
+        e1 = _mm_sha1nexte_epu32(e1, m3);
+        e0 = abcd;
+        m0 = _mm_sha1msg2_epu32(m0, m3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        SHA1_NI_MSG1(m2, m3);
+        SHA1_NI_XOR(m1, m3);
+
+        // rounds 16-67, message schedule in flight
+#define SHA1_NI_FULL(EN, EC, FUNC, MC, MN, MP, MPP)                           \
+        EN = _mm_sha1nexte_epu32(EN, MC);                                     \
+        EC = abcd;                                                            \
+        MN = _mm_sha1msg2_epu32(MN, MC);                                      \
+        abcd = _mm_sha1rnds4_epu32(abcd, EN, FUNC);                           \
+        SHA1_NI_MSG1(MP, MC);                                                 \
+        SHA1_NI_XOR(MPP, MC)
+
+        SHA1_NI_FULL(e0, e1, 0, m0, m1, m3, m2);
+        SHA1_NI_FULL(e1, e0, 1, m1, m2, m0, m3);
+        SHA1_NI_FULL(e0, e1, 1, m2, m3, m1, m0);
+        SHA1_NI_FULL(e1, e0, 1, m3, m0, m2, m1);
+        SHA1_NI_FULL(e0, e1, 1, m0, m1, m3, m2);
+        SHA1_NI_FULL(e1, e0, 1, m1, m2, m0, m3);
+        SHA1_NI_FULL(e0, e1, 2, m2, m3, m1, m0);
+        SHA1_NI_FULL(e1, e0, 2, m3, m0, m2, m1);
+        SHA1_NI_FULL(e0, e1, 2, m0, m1, m3, m2);
+        SHA1_NI_FULL(e1, e0, 2, m1, m2, m0, m3);
+        SHA1_NI_FULL(e0, e1, 2, m2, m3, m1, m0);
+        SHA1_NI_FULL(e1, e0, 3, m3, m0, m2, m1);
+        SHA1_NI_FULL(e0, e1, 3, m0, m1, m3, m2);
+#undef SHA1_NI_FULL
+
+        // rounds 68-79, schedule drains
+        e1 = _mm_sha1nexte_epu32(e1, m1);
+        e0 = abcd;
+        m2 = _mm_sha1msg2_epu32(m2, m1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        SHA1_NI_XOR(m3, m1);
+
+        e0 = _mm_sha1nexte_epu32(e0, m2);
+        e1 = abcd;
+        m3 = _mm_sha1msg2_epu32(m3, m2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        SHA1_NI_GROUP(e1, e0, 3, m3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0Save);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), abcd);
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+
+/* four SHA-256 rounds per group, message words kept in four registers */
+#define SHA256_NI_K(I)                                                        \
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_NI_CONSTANTS + (I)))
+#define SHA256_NI_ROUNDS(MC, I)                                               \
+    message = _mm_add_epi32(MC, SHA256_NI_K(I));                              \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, message)
+#define SHA256_NI_FINISH()                                                    \
+    message = _mm_shuffle_epi32(message, 0x0e);                               \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, message)
+#define SHA256_NI_EXPAND(MC, MP, MN)                                          \
+    tmp = _mm_alignr_epi8(MC, MP, 4);                                         \
+    MN = _mm_add_epi32(MN, tmp);                                              \
+    MN = _mm_sha256msg2_epu32(MN, MC)
+#define SHA256_NI_MSG1(MP, MC)          MP = _mm_sha256msg1_epu32(MP, MC)
+
+alignas(16) static const uint32_t SHA256_NI_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// SHA-256 compression with Intel SHA extensions
+SS_CPU_TARGET("sha,sse4.1")
+void sha256CompressShaNi(uint32_t *state, const uint8_t *blocks,
+                         size_t count) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+
+    // state words reordered to ABEF/CDGH as the instructions expect
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+    __m128i state1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(state + 4));
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    __m128i message, m0, m1, m2, m3;
+    for (; count != 0; --count, blocks += 64) {
+        auto abefSave = state0;
+        auto cdghSave = state1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(blocks)), mask);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(blocks + 16)), mask);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(blocks + 32)), mask);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(blocks + 48)), mask);
+
+        // rounds 0-15
+        SHA256_NI_ROUNDS(m0, 0);
+        SHA256_NI_FINISH();
+        SHA256_NI_ROUNDS(m1, 4);
+        SHA256_NI_FINISH();
+        SHA256_NI_MSG1(m0, m1);
+        SHA256_NI_ROUNDS(m2, 8);
+        SHA256_NI_FINISH();
+        SHA256_NI_MSG1(m1, m2);
+        SHA256_NI_ROUNDS(m3, 12);
+        SHA256_NI_EXPAND(m3, m2, m0);
+        SHA256_NI_FINISH();
+        SHA256_NI_MSG1(m2, m3);
+
+        // rounds 16-51, message schedule in flight
+#define SHA256_NI_FULL(MC, MP, MN, MPP, I)                                    \
+        SHA256_NI_ROUNDS(MC, I);                                              \
+        SHA256_NI_EXPAND(MC, MP, MN);                                         \
+        SHA256_NI_FINISH();                                                   \
+        SHA256_NI_MSG1(MPP, MC)
+
+        SHA256_NI_FULL(m0, m3, m1, m3, 16);
+        SHA256_NI_FULL(m1, m0, m2, m0, 20);
+        SHA256_NI_FULL(m2, m1, m3, m1, 24);
+        SHA256_NI_FULL(m3, m2, m0, m2, 28);
+        SHA256_NI_FULL(m0, m3, m1, m3, 32);
+        SHA256_NI_FULL(m1, m0, m2, m0, 36);
+        SHA256_NI_FULL(m2, m1, m3, m1, 40);
+        SHA256_NI_FULL(m3, m2, m0, m2, 44);
+        SHA256_NI_FULL(m0, m3, m1, m3, 48);
+#undef SHA256_NI_FULL
+
+        // rounds 52-63, schedule drains
+        SHA256_NI_ROUNDS(m1, 52);
+        SHA256_NI_EXPAND(m1, m0, m2);
+        SHA256_NI_FINISH();
+        SHA256_NI_ROUNDS(m2, 56);
+        SHA256_NI_EXPAND(m2, m1, m3);
+        SHA256_NI_FINISH();
+        SHA256_NI_ROUNDS(m3, 60);
+        SHA256_NI_FINISH();
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+
+#endif // HAVE_X86_SHA_INTRINSICS
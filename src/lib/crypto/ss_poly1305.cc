@@ -0,0 +1,275 @@
+#include "shadowsocks/crypto/ss_poly1305.h"
+#include "shadowsocks/crypto/ss_bytes.h"
+
+
+#if defined(__SIZEOF_INT128__)
+using uint128_t = unsigned __int128;
+
+#define POLY1305_MASK44                 (0xfffffffffffULL)
+#define POLY1305_MASK42                 (0x3ffffffffffULL)
+
+// SsPoly1305 constructor, clamp r and keep s as the final pad
+SsPoly1305::SsPoly1305(const uint8_t *key) {
+    auto t0 = loadLittleEndian64(key);
+    auto t1 = loadLittleEndian64(key + 8);
+
+    _r[0] = t0 & 0xffc0fffffffULL;
+    _r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+    _r[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+
+    _pad[0] = loadLittleEndian64(key + 16);
+    _pad[1] = loadLittleEndian64(key + 24);
+}
+
+// 44/44/42 bit limbs with 128 bits products
+void SsPoly1305::blocks(const uint8_t *data, size_t size, bool last) {
+    const uint64_t hibit = last ? 0 : (1ULL << 40);
+    const uint64_t r0 = _r[0], r1 = _r[1], r2 = _r[2];
+    const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+    uint64_t h0 = _h[0], h1 = _h[1], h2 = _h[2];
+
+    for (; size >= BLOCK_SIZE; size -= BLOCK_SIZE, data += BLOCK_SIZE) {
+        auto t0 = loadLittleEndian64(data);
+        auto t1 = loadLittleEndian64(data + 8);
+
+        h0 += t0 & POLY1305_MASK44;
+        h1 += ((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44;
+        h2 += ((t1 >> 24) & POLY1305_MASK42) | hibit;
+
+        auto d0 = static_cast<uint128_t>(h0) * r0 +
+                  static_cast<uint128_t>(h1) * s2 +
+                  static_cast<uint128_t>(h2) * s1;
+        auto d1 = static_cast<uint128_t>(h0) * r1 +
+                  static_cast<uint128_t>(h1) * r0 +
+                  static_cast<uint128_t>(h2) * s2;
+        auto d2 = static_cast<uint128_t>(h0) * r2 +
+                  static_cast<uint128_t>(h1) * r1 +
+                  static_cast<uint128_t>(h2) * r0;
+
+        uint64_t c = static_cast<uint64_t>(d0 >> 44);
+        h0 = static_cast<uint64_t>(d0) & POLY1305_MASK44;
+        d1 += c;
+        c = static_cast<uint64_t>(d1 >> 44);
+        h1 = static_cast<uint64_t>(d1) & POLY1305_MASK44;
+        d2 += c;
+        c = static_cast<uint64_t>(d2 >> 42);
+        h2 = static_cast<uint64_t>(d2) & POLY1305_MASK42;
+        h0 += c * 5;
+        c = h0 >> 44;
+        h0 &= POLY1305_MASK44;
+        h1 += c;
+    }
+
+    _h[0] = h0;
+    _h[1] = h1;
+    _h[2] = h2;
+}
+
+// fully reduce, add pad and output tag
+void SsPoly1305::final(uint8_t *tag) {
+    if (_buffered != 0) {
+        _buffer[_buffered++] = 1;
+        std::memset(_buffer + _buffered, 0, BLOCK_SIZE - _buffered);
+        blocks(_buffer, BLOCK_SIZE, true);
+        _buffered = 0;
+    }
+
+    uint64_t h0 = _h[0], h1 = _h[1], h2 = _h[2], c;
+    c = h1 >> 44; h1 &= POLY1305_MASK44;
+    h2 += c; c = h2 >> 42; h2 &= POLY1305_MASK42;
+    h0 += c * 5; c = h0 >> 44; h0 &= POLY1305_MASK44;
+    h1 += c; c = h1 >> 44; h1 &= POLY1305_MASK44;
+    h2 += c; c = h2 >> 42; h2 &= POLY1305_MASK42;
+    h0 += c * 5; c = h0 >> 44; h0 &= POLY1305_MASK44;
+    h1 += c;
+
+    // h - p, selected in constant time when h >= p
+    uint64_t g0 = h0 + 5; c = g0 >> 44; g0 &= POLY1305_MASK44;
+    uint64_t g1 = h1 + c; c = g1 >> 44; g1 &= POLY1305_MASK44;
+    uint64_t g2 = h2 + c - (1ULL << 42);
+
+    c = (g2 >> 63) - 1;
+    g0 &= c; g1 &= c; g2 &= c;
+    c = ~c;
+    h0 = (h0 & c) | g0;
+    h1 = (h1 & c) | g1;
+    h2 = (h2 & c) | g2;
+
+    auto t0 = _pad[0], t1 = _pad[1];
+    h0 += t0 & POLY1305_MASK44; c = h0 >> 44; h0 &= POLY1305_MASK44;
+    h1 += (((t0 >> 44) | (t1 << 20)) & POLY1305_MASK44) + c;
+    c = h1 >> 44; h1 &= POLY1305_MASK44;
+    h2 += ((t1 >> 24) & POLY1305_MASK42) + c; h2 &= POLY1305_MASK42;
+
+    storeLittleEndian64(tag, h0 | (h1 << 44));
+    storeLittleEndian64(tag + 8, (h1 >> 20) | (h2 << 24));
+}
+
+#else
+
+#define POLY1305_MASK26                 (0x3ffffff)
+
+// SsPoly1305 constructor, clamp r and keep s as the final pad
+SsPoly1305::SsPoly1305(const uint8_t *key) {
+    _r[0] = (loadLittleEndian32(key)) & 0x3ffffff;
+    _r[1] = (loadLittleEndian32(key + 3) >> 2) & 0x3ffff03;
+    _r[2] = (loadLittleEndian32(key + 6) >> 4) & 0x3ffc0ff;
+    _r[3] = (loadLittleEndian32(key + 9) >> 6) & 0x3f03fff;
+    _r[4] = (loadLittleEndian32(key + 12) >> 8) & 0x00fffff;
+
+    for (size_t i = 0; i < 4; ++i) {
+        _pad[i] = loadLittleEndian32(key + 16 + i * 4);
+    }
+}
+
+// 26 bits limbs with 64 bits products
+void SsPoly1305::blocks(const uint8_t *data, size_t size, bool last) {
+    const uint32_t hibit = last ? 0 : (1UL << 24);
+    const uint32_t r0 = _r[0], r1 = _r[1], r2 = _r[2], r3 = _r[3], r4 = _r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4];
+
+    for (; size >= BLOCK_SIZE; size -= BLOCK_SIZE, data += BLOCK_SIZE) {
+        h0 += (loadLittleEndian32(data)) & POLY1305_MASK26;
+        h1 += (loadLittleEndian32(data + 3) >> 2) & POLY1305_MASK26;
+        h2 += (loadLittleEndian32(data + 6) >> 4) & POLY1305_MASK26;
+        h3 += (loadLittleEndian32(data + 9) >> 6) & POLY1305_MASK26;
+        h4 += (loadLittleEndian32(data + 12) >> 8) | hibit;
+
+        uint64_t d0 = static_cast<uint64_t>(h0) * r0 +
+                      static_cast<uint64_t>(h1) * s4 +
+                      static_cast<uint64_t>(h2) * s3 +
+                      static_cast<uint64_t>(h3) * s2 +
+                      static_cast<uint64_t>(h4) * s1;
+        uint64_t d1 = static_cast<uint64_t>(h0) * r1 +
+                      static_cast<uint64_t>(h1) * r0 +
+                      static_cast<uint64_t>(h2) * s4 +
+                      static_cast<uint64_t>(h3) * s3 +
+                      static_cast<uint64_t>(h4) * s2;
+        uint64_t d2 = static_cast<uint64_t>(h0) * r2 +
+                      static_cast<uint64_t>(h1) * r1 +
+                      static_cast<uint64_t>(h2) * r0 +
+                      static_cast<uint64_t>(h3) * s4 +
+                      static_cast<uint64_t>(h4) * s3;
+        uint64_t d3 = static_cast<uint64_t>(h0) * r3 +
+                      static_cast<uint64_t>(h1) * r2 +
+                      static_cast<uint64_t>(h2) * r1 +
+                      static_cast<uint64_t>(h3) * r0 +
+                      static_cast<uint64_t>(h4) * s4;
+        uint64_t d4 = static_cast<uint64_t>(h0) * r4 +
+                      static_cast<uint64_t>(h1) * r3 +
+                      static_cast<uint64_t>(h2) * r2 +
+                      static_cast<uint64_t>(h3) * r1 +
+                      static_cast<uint64_t>(h4) * r0;
+
+        uint32_t c = static_cast<uint32_t>(d0 >> 26);
+        h0 = static_cast<uint32_t>(d0) & POLY1305_MASK26;
+        d1 += c; c = static_cast<uint32_t>(d1 >> 26);
+        h1 = static_cast<uint32_t>(d1) & POLY1305_MASK26;
+        d2 += c; c = static_cast<uint32_t>(d2 >> 26);
+        h2 = static_cast<uint32_t>(d2) & POLY1305_MASK26;
+        d3 += c; c = static_cast<uint32_t>(d3 >> 26);
+        h3 = static_cast<uint32_t>(d3) & POLY1305_MASK26;
+        d4 += c; c = static_cast<uint32_t>(d4 >> 26);
+        h4 = static_cast<uint32_t>(d4) & POLY1305_MASK26;
+        h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_MASK26;
+        h1 += c;
+    }
+
+    _h[0] = h0; _h[1] = h1; _h[2] = h2; _h[3] = h3; _h[4] = h4;
+}
+
+// fully reduce, add pad and output tag
+void SsPoly1305::final(uint8_t *tag) {
+    if (_buffered != 0) {
+        _buffer[_buffered++] = 1;
+        std::memset(_buffer + _buffered, 0, BLOCK_SIZE - _buffered);
+        blocks(_buffer, BLOCK_SIZE, true);
+        _buffered = 0;
+    }
+
+    uint32_t h0 = _h[0], h1 = _h[1], h2 = _h[2], h3 = _h[3], h4 = _h[4], c;
+    c = h1 >> 26; h1 &= POLY1305_MASK26;
+    h2 += c; c = h2 >> 26; h2 &= POLY1305_MASK26;
+    h3 += c; c = h3 >> 26; h3 &= POLY1305_MASK26;
+    h4 += c; c = h4 >> 26; h4 &= POLY1305_MASK26;
+    h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_MASK26;
+    h1 += c;
+
+    // h - p, selected in constant time when h >= p
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= POLY1305_MASK26;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= POLY1305_MASK26;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= POLY1305_MASK26;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= POLY1305_MASK26;
+    uint32_t g4 = h4 + c - (1UL << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    h0 = (h0 | (h1 << 26));
+    h1 = ((h1 >> 6) | (h2 << 20));
+    h2 = ((h2 >> 12) | (h3 << 14));
+    h3 = ((h3 >> 18) | (h4 << 8));
+
+    uint64_t f = static_cast<uint64_t>(h0) + _pad[0];
+    storeLittleEndian32(tag, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(h1) + _pad[1] + (f >> 32);
+    storeLittleEndian32(tag + 4, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(h2) + _pad[2] + (f >> 32);
+    storeLittleEndian32(tag + 8, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(h3) + _pad[3] + (f >> 32);
+    storeLittleEndian32(tag + 12, static_cast<uint32_t>(f));
+}
+
+#endif
+
+// absorb message, whole blocks are processed in place
+void SsPoly1305::update(const void *data, size_t size) {
+    auto input = static_cast<const uint8_t*>(data);
+
+    if (_buffered != 0) {
+        auto fill = std::min<size_t>(BLOCK_SIZE - _buffered, size);
+        std::memcpy(_buffer + _buffered, input, fill);
+        _buffered += fill;
+        input += fill;
+        size -= fill;
+
+        if (_buffered != BLOCK_SIZE) {
+            return;
+        }
+        blocks(_buffer, BLOCK_SIZE, false);
+        _buffered = 0;
+    }
+
+    if (size >= BLOCK_SIZE) {
+        auto whole = size & ~static_cast<size_t>(BLOCK_SIZE - 1);
+        blocks(input, whole, false);
+        input += whole;
+        size -= whole;
+    }
+
+    if (size != 0) {
+        std::memcpy(_buffer, input, size);
+        _buffered = size;
+    }
+}
+
+// zero pad the pending partial block, as the AEAD construction requires
+void SsPoly1305::pad() {
+    if (_buffered != 0) {
+        std::memset(_buffer + _buffered, 0, BLOCK_SIZE - _buffered);
+        blocks(_buffer, BLOCK_SIZE, false);
+        _buffered = 0;
+    }
+}
+
+// compare tags in constant time
+bool SsPoly1305::verify(const uint8_t *a, const uint8_t *b) {
+    return constantTimeEquals(a, b, TAG_SIZE);
+}
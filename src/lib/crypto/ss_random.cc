@@ -0,0 +1,37 @@
+#include "shadowsocks/crypto/ss_random.h"
+#include "shadowsocks/ss_logger.h"
+
+#if defined(HAVE_GETRANDOM)
+#include <sys/random.h>
+#elif defined(__platform_windows__)
+#include <bcrypt.h>
+#endif
+
+
+// fill buffer with random bytes, no way to continue without entropy
+void SsRandom::fill(uint8_t *buffer, size_t size) {
+#if defined(HAVE_GETRANDOM)
+    while (size != 0) {
+        auto result = ::getrandom(buffer, size, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            EXT("getrandom failure with errno = %d", errno);
+        }
+        buffer += result;
+        size -= static_cast<size_t>(result);
+    }
+#elif defined(__platform_linux__)
+    static std::ifstream urandom("/dev/urandom", std::ios::binary);
+    if (!urandom.read(reinterpret_cast<char*>(buffer), size)) {
+        EXT("read from /dev/urandom failure");
+    }
+#elif defined(__platform_windows__)
+    auto status = BCryptGenRandom(nullptr, buffer, static_cast<ULONG>(size),
+                                  BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+    if (!BCRYPT_SUCCESS(status)) {
+        EXT("BCryptGenRandom failure with status = %x", status);
+    }
+#endif
+}
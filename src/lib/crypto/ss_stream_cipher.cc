@@ -0,0 +1,189 @@
+#include "shadowsocks/crypto/ss_stream_cipher.h"
+#include "shadowsocks/crypto/ss_random.h"
+#include "shadowsocks/ss_exception.h"
+
+
+// SsStreamCipher constructor
+SsStreamCipher::SsStreamCipher(SsStreamCipher::CipherMethod method,
+                               SsStreamCipher::Key key) :
+    _method(method), _key(std::move(key)) {
+    if (_key.size() != keySize()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("%s requires key of %d bytes, got %d",
+                             method, keySize(), _key.size()));
+    }
+}
+
+// lookup cipher method by the name used in configuration
+SsStreamCipher::CipherMethod SsStreamCipher::method(const char *methodName) {
+    for (auto &method : methods()) {
+        if (std::strcmp(name(method), methodName) == 0) {
+            return method;
+        }
+    }
+
+    throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+        SsLogger::format("unsupported cipher method %s", methodName));
+}
+
+// name used in configuration
+const char *SsStreamCipher::name(SsStreamCipher::CipherMethod method) {
+    switch (method) {
+        case CipherMethod::CM_AES_128_CTR:
+            return "aes-128-ctr";
+        case CipherMethod::CM_AES_192_CTR:
+            return "aes-192-ctr";
+        case CipherMethod::CM_AES_256_CTR:
+            return "aes-256-ctr";
+        case CipherMethod::CM_AES_128_CFB:
+            return "aes-128-cfb";
+        case CipherMethod::CM_AES_192_CFB:
+            return "aes-192-cfb";
+        case CipherMethod::CM_AES_256_CFB:
+            return "aes-256-cfb";
+    }
+
+    return "unknown";
+}
+
+// all supported methods
+const std::vector<SsStreamCipher::CipherMethod> &SsStreamCipher::methods() {
+    static const std::vector<CipherMethod> methods = {
+        CipherMethod::CM_AES_128_CTR,
+        CipherMethod::CM_AES_192_CTR,
+        CipherMethod::CM_AES_256_CTR,
+        CipherMethod::CM_AES_128_CFB,
+        CipherMethod::CM_AES_192_CFB,
+        CipherMethod::CM_AES_256_CFB
+    };
+
+    return methods;
+}
+
+// size of the key, already derived from the password
+size_t SsStreamCipher::keySize(SsStreamCipher::CipherMethod method) {
+    switch (method) {
+        case CipherMethod::CM_AES_128_CTR:
+        case CipherMethod::CM_AES_128_CFB:
+            return 16;
+        case CipherMethod::CM_AES_192_CTR:
+        case CipherMethod::CM_AES_192_CFB:
+            return 24;
+        case CipherMethod::CM_AES_256_CTR:
+        case CipherMethod::CM_AES_256_CFB:
+            return 32;
+    }
+
+    return 0;
+}
+
+// size of the key of this session
+size_t SsStreamCipher::keySize() const {
+    return keySize(_method);
+}
+
+// IV prefixed to every stream and packet
+size_t SsStreamCipher::ivSize() const {
+    return SsAes::BLOCK_SIZE;
+}
+
+// start keystream from the peer IV
+void SsStreamCipher::setIv(const uint8_t *iv) {
+    if (counterMode()) {
+        _ctr.reset(new SsAesCtr(_key.data(), _key.size(), iv));
+    } else {
+        _cfb.reset(new SsAesCfb(_key.data(), _key.size(), iv));
+    }
+}
+
+// generate an IV for our direction
+void SsStreamCipher::newIv(uint8_t *iv) {
+    SsRandom::fill(iv, ivSize());
+    setIv(iv);
+}
+
+// encrypt next part of the stream
+void SsStreamCipher::encrypt(const uint8_t *in, uint8_t *out, size_t size) {
+    if (counterMode()) {
+        assert(_ctr);
+        _ctr->crypt(in, out, size);
+    } else {
+        assert(_cfb);
+        _cfb->encrypt(in, out, size);
+    }
+}
+
+// decrypt next part of the stream
+void SsStreamCipher::decrypt(const uint8_t *in, uint8_t *out, size_t size) {
+    if (counterMode()) {
+        assert(_ctr);
+        _ctr->crypt(in, out, size);
+    } else {
+        assert(_cfb);
+        _cfb->decrypt(in, out, size);
+    }
+}
+
+// encrypt and append to ciphertext stream
+void SsStreamCipher::encrypt(const SsStreamCipher::Stream &plaintext,
+                             SsStreamCipher::Stream &ciphertext) {
+    auto offset = ciphertext.size();
+    ciphertext.resize(offset + plaintext.size());
+
+    encrypt(plaintext.data(), ciphertext.data() + offset, plaintext.size());
+}
+
+// decrypt and append to plaintext stream
+void SsStreamCipher::decrypt(const SsStreamCipher::Stream &ciphertext,
+                             SsStreamCipher::Stream &plaintext) {
+    auto offset = plaintext.size();
+    plaintext.resize(offset + ciphertext.size());
+
+    decrypt(ciphertext.data(), plaintext.data() + offset, ciphertext.size());
+}
+
+// packet, random IV then payload
+void SsStreamCipher::encryptPacket(const SsStreamCipher::Stream &plaintext,
+                                   SsStreamCipher::Stream &packet) {
+    packet.resize(ivSize() + plaintext.size());
+    newIv(packet.data());
+
+    encrypt(plaintext.data(), packet.data() + ivSize(), plaintext.size());
+}
+
+// packet, restart keystream from the leading IV
+bool SsStreamCipher::decryptPacket(const SsStreamCipher::Stream &packet,
+                                   SsStreamCipher::Stream &plaintext) {
+    if (packet.size() < ivSize()) {
+        return false;
+    }
+    setIv(packet.data());
+
+    plaintext.resize(packet.size() - ivSize());
+    decrypt(packet.data() + ivSize(), plaintext.data(), plaintext.size());
+    return true;
+}
+
+// CTR or CFB family
+bool SsStreamCipher::counterMode() const {
+    return _method == CipherMethod::CM_AES_128_CTR ||
+           _method == CipherMethod::CM_AES_192_CTR ||
+           _method == CipherMethod::CM_AES_256_CTR;
+}
+
+// output cipher
+std::ostream &operator<<(std::ostream &out, SsStreamCipher *cipher) {
+    out << "SsStreamCipher["
+        << "method=" << cipher->_method
+        << "]";
+
+    return out;
+}
+
+// output method name
+std::ostream &operator<<(std::ostream &out,
+                         const SsStreamCipher::CipherMethod &method) {
+    out << SsStreamCipher::name(method);
+
+    return out;
+}
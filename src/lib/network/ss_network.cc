@@ -2,11 +2,16 @@
 #include "shadowsocks/ss_logger.h"
 
 
+// accept errors come in bursts when descriptors run out
+#define NETWORK_ACCEPT_ERROR_RATE       (1)
+#define NETWORK_ACCEPT_ERROR_BURST      (10)
+
+
 // SsNetwork constructor
 SsNetwork::SsNetwork(SsNetwork::NetworkFamily family,
                      SsNetwork::NetworkType type) :
     _family(family), _type(type), _descriptor(0) {
-    SsLogger::debug("%s created", this);
+    DBG("%s created", this);
 }
 
 // SsNetwork constructor
@@ -18,7 +23,7 @@ SsNetwork::SsNetwork(SsNetwork::Descriptor descriptor,
 
 // SsNetwork destructor
 SsNetwork::~SsNetwork() {
-    SsLogger::debug("%s closed", this);
+    DBG("%s closed", this);
 }
 
 // get network descriptor
@@ -29,8 +34,8 @@ SsNetwork::Descriptor SsNetwork::getDescriptor() const {
 // connecting to host:port
 void SsNetwork::connect(SsNetwork::HostName host, SsNetwork::HostPort port) {
     if (_state != NetworkState::NS_NONE) {
-        SsLogger::warning("cannot convert state form %s to %s",
-                          _state, NetworkState::NS_ESTABLISHED);
+        WARN("cannot convert state form %s to %s",
+             _state, NetworkState::NS_ESTABLISHED);
     }
     _state = NetworkState::NS_ESTABLISHED;
 
@@ -40,8 +45,8 @@ void SsNetwork::connect(SsNetwork::HostName host, SsNetwork::HostPort port) {
 // listening on host:port
 void SsNetwork::listen(SsNetwork::HostName host, SsNetwork::HostPort port) {
     if (_state != NetworkState::NS_NONE) {
-        SsLogger::warning("cannot convert state form %s to %s",
-                          _state, NetworkState::NS_LISTEN);
+        WARN("cannot convert state form %s to %s",
+             _state, NetworkState::NS_LISTEN);
     }
     _state = NetworkState::NS_LISTEN;
 
@@ -50,16 +55,19 @@ void SsNetwork::listen(SsNetwork::HostName host, SsNetwork::HostPort port) {
 
 // connecting to host:port
 void SsNetwork::doConnect(SsNetwork::HostName host, SsNetwork::HostPort port) {
-    SsLogger::info("%s connecting to %s:%d", this, host, port);
+    INF_FIELDS("%s connecting", this,
+               logField("host", host), logField("port", port));
 }
 
 // listening on host:port
 void SsNetwork::doListen(SsNetwork::HostName host, SsNetwork::HostPort port) {
-    SsLogger::info("%s listening on %s:%d", this, host, port);
+    INF_FIELDS("%s listening", this,
+               logField("host", host), logField("port", port));
 }
 
-// from server accept a new client
-SsNetwork::ConnectingTuple SsNetwork::accept() {
+// from server accept a new client, failures of the client are returned,
+// only those of the listener are logged
+SsNetwork::AcceptResult SsNetwork::accept() {
     Descriptor client;
     auto address = std::make_shared<SsNetwork::Address>();
 #if defined(__platform_linux__)
@@ -69,16 +77,86 @@ SsNetwork::ConnectingTuple SsNetwork::accept() {
 #endif
 
     if (_state != NetworkState::NS_LISTEN) {
-        SsLogger::error("accept client from non-listening network");
-        return {INVALID_DESCRIPTOR, address};
+        return SsError::ErrorCode::EC_INVALID_STATE;
     }
 
     client = ::accept(getDescriptor(), (sockaddr*) address.get(), &length);
     if (client == INVALID_DESCRIPTOR || client < 0) {
-        SsLogger::error("accept connection error from %s", this);
+        auto error = SsError::last();
+        if (error == SsError::ErrorCode::EC_SYSTEM) {
+            ERR_LIMIT(NETWORK_ACCEPT_ERROR_RATE, NETWORK_ACCEPT_ERROR_BURST,
+                      "accept connection error from %s: %s", this, error);
+        }
+        return error;
+    }
+
+    return ConnectingTuple{client, address};
+}
+
+// no more data from us, the peer reads to the end and closes its side
+SsResult<void> SsNetwork::halfClose() {
+#if defined(__platform_linux__)
+    if (::shutdown(_descriptor, SHUT_WR) != OPERATOR_SUCCESS) {
+#elif defined(__platform_windows__)
+    if (::shutdown(_descriptor, SD_SEND) != OPERATOR_SUCCESS) {
+#endif
+        return SsError::last();
+    }
+
+    return SsResult<void>();
+}
+
+// release the descriptor, reset drops unsent data and skips TIME_WAIT, for
+// relays still open when a drain runs out
+SsResult<void> SsNetwork::close(bool reset) {
+    if (reset) {
+        linger option{1, 0};
+        ::setsockopt(_descriptor, SOL_SOCKET, SO_LINGER,
+                     reinterpret_cast<const char*>(&option), sizeof(option));
     }
 
-    return {client, address};
+#if defined(__platform_linux__)
+    auto result = ::close(_descriptor);
+#elif defined(__platform_windows__)
+    auto result = ::closesocket(_descriptor);
+#endif
+    _descriptor = INVALID_DESCRIPTOR;
+    _state = NetworkState::NS_NONE;
+
+    if (result != OPERATOR_SUCCESS) {
+        return SsError::last();
+    }
+    return SsResult<void>();
+}
+
+// listener of a reuseport group that takes connections received on cpu,
+// the kernel picks the listener matching the core handling the packets
+SsResult<void> SsNetwork::setIncomingCpu(int cpu) {
+#if defined(SO_INCOMING_CPU)
+    if (::setsockopt(_descriptor, SOL_SOCKET, SO_INCOMING_CPU,
+                     &cpu, sizeof(cpu)) != OPERATOR_SUCCESS) {
+        return SsError::last();
+    }
+    return SsResult<void>();
+#else
+    return SsError::ErrorCode::EC_UNSUPPORTED;
+#endif
+}
+
+// core that received the packets of this connection, for handing it to
+// the reactor pinned there
+SsResult<int> SsNetwork::incomingCpu() const {
+#if defined(SO_INCOMING_CPU)
+    int cpu = 0;
+    socklen_t length = sizeof(cpu);
+    if (::getsockopt(_descriptor, SOL_SOCKET, SO_INCOMING_CPU,
+                     &cpu, &length) != OPERATOR_SUCCESS) {
+        return SsError::last();
+    }
+    return cpu;
+#else
+    return SsError::ErrorCode::EC_UNSUPPORTED;
+#endif
 }
 
 // network toString and output
@@ -94,7 +172,8 @@ std::ostream &operator<<(std::ostream &o, SsNetwork *network) {
 }
 
 // network family output
-std::ostream &operator<<(std::ostream &o, SsNetwork::NetworkFamily &family) {
+std::ostream &operator<<(std::ostream &o,
+                         const SsNetwork::NetworkFamily &family) {
     switch (family) {
         case SsNetwork::NetworkFamily::NF_INET_4: o << "INET4"; break;
         case SsNetwork::NetworkFamily::NF_INET_6: o << "INET6"; break;
@@ -104,7 +183,8 @@ std::ostream &operator<<(std::ostream &o, SsNetwork::NetworkFamily &family) {
 }
 
 // network type output
-std::ostream &operator<<(std::ostream &o, SsNetwork::NetworkType &type) {
+std::ostream &operator<<(std::ostream &o,
+                         const SsNetwork::NetworkType &type) {
     switch (type) {
         case SsNetwork::NetworkType::NT_TCP: o << "TCP"; break;
         case SsNetwork::NetworkType::NT_UDP: o << "UDP"; break;
@@ -115,7 +195,8 @@ std::ostream &operator<<(std::ostream &o, SsNetwork::NetworkType &type) {
 }
 
 // network state output
-std::ostream &operator<<(std::ostream &o, SsNetwork::NetworkState &state) {
+std::ostream &operator<<(std::ostream &o,
+                         const SsNetwork::NetworkState &state) {
     switch (state) {
         case SsNetwork::NetworkState::NS_NONE: o << "NONE"; break;
         case SsNetwork::NetworkState::NS_LISTEN: o << "LISTEN"; break;
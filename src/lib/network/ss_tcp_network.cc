@@ -13,7 +13,7 @@ SsTcpNetwork::SsTcpNetwork(SsNetwork::Descriptor descriptor,
 }
 
 // accept new connecting
-SsNetwork::ConnectingTuple SsTcpNetwork::accept() {
+SsNetwork::AcceptResult SsTcpNetwork::accept() {
     return SsNetwork::accept();
 }
 
@@ -8,3 +8,57 @@ void SsTcpRelay::before(SsTcpRelay::StreamCallback callback) {
 // when stream after calling
 void SsTcpRelay::after(SsTcpRelay::StreamCallback callback) {
 }
+
+// access log of this reactor, nullptr turns records off
+void SsTcpRelay::setAccessLog(std::shared_ptr<SsAccessLog> accessLog) {
+    _accessLog = std::move(accessLog);
+    if (!_accessLog) {
+        _records.clear();
+    }
+}
+
+// client authenticated and its target known, the record starts here
+void SsTcpRelay::opened(SsNetwork::Descriptor descriptor, const char *user,
+                        const char *host, uint16_t port) {
+    if (_accessLog) {
+        _records[descriptor].open(user, host, port);
+    }
+}
+
+// bytes moved, counted from the client's view
+void SsTcpRelay::relayed(SsNetwork::Descriptor descriptor,
+                         size_t sent, size_t received) {
+    auto record = _records.find(descriptor);
+    if (record != _records.end()) {
+        record->second.sent += sent;
+        record->second.received += received;
+    }
+}
+
+// close both streams, errors and rejections reset them, then the record
+// goes to the access log
+void SsTcpRelay::close(SsNetwork::Descriptor descriptor, CloseReason reason) {
+    auto stream = _streams.find(descriptor);
+    if (stream != _streams.end()) {
+        auto reset = reason == CloseReason::CR_ERROR ||
+                     reason == CloseReason::CR_REJECTED;
+        stream->second.first.close(reset);
+        stream->second.second.close(reset);
+        _streams.erase(stream);
+    }
+
+    auto record = _records.find(descriptor);
+    if (record != _records.end()) {
+        if (_accessLog) {
+            _accessLog->close(record->second, reason);
+        }
+        _records.erase(record);
+    }
+}
+
+// reactor loop, pending access records reach the file once per interval
+void SsTcpRelay::tick() {
+    if (_accessLog) {
+        _accessLog->tick();
+    }
+}
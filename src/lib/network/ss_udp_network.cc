@@ -14,14 +14,14 @@ SsUdpNetwork::SsUdpNetwork(SsNetwork::Descriptor descriptor,
 }
 
 // udp server unsupported accept connection
-SsNetwork::ConnectingTuple SsUdpNetwork::accept() {
-    return {INVALID_DESCRIPTOR, nullptr};
+SsNetwork::AcceptResult SsUdpNetwork::accept() {
+    return SsError::ErrorCode::EC_UNSUPPORTED;
 }
 
 // UDP network unsupported connect action
 void SsUdpNetwork::doConnect(SsNetwork::HostName host,
                              SsNetwork::HostPort port) {
-    SsLogger::warning("UDP network unsupported connect operator");
+    WARN("UDP network unsupported connect operator");
 }
 
 // listening on host:port via UDP
@@ -0,0 +1,162 @@
+#include "shadowsocks/ss_access_log.h"
+#include "shadowsocks/ss_log_fields.h"
+#include "shadowsocks/ss_exception.h"
+
+
+#define ACCESS_LOG_TIME_SIZE            (32)
+
+
+// wall clock in nanoseconds
+static int64_t wallClock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// zero padded copy, cut to the field
+static void copyField(char *field, size_t size, const char *value) {
+    std::memset(field, 0, size);
+    if (value != nullptr) {
+        std::memcpy(field, value, strnlen(value, size));
+    }
+}
+
+// connection accepted and its target known
+void SsAccessRecord::open(const char *user, const char *host, uint16_t port) {
+    opened = wallClock();
+    this->port = port;
+    copyField(this->user, sizeof(this->user), user);
+    copyField(target, sizeof(target), host);
+}
+
+// close reason as written to text
+const char *SsAccessRecord::reasonName(CloseReason reason) {
+    switch (reason) {
+        case CloseReason::CR_CLIENT_CLOSED: return "client";
+        case CloseReason::CR_REMOTE_CLOSED: return "remote";
+        case CloseReason::CR_TIMEOUT:       return "timeout";
+        case CloseReason::CR_ERROR:         return "error";
+        case CloseReason::CR_REJECTED:      return "rejected";
+        case CloseReason::CR_SHUTDOWN:      return "shutdown";
+    }
+
+    return "unknown";
+}
+
+// SsAccessSink constructor, the file is opened right away, flushes write
+// it out whatever the logger does, SsAccessLog paces them
+SsAccessSink::SsAccessSink(std::string path, SsFileRotation rotation) :
+    _stream(std::move(path), rotation,
+            SsFileBuffer::FlushPolicy::FP_ALWAYS) {
+}
+
+// one batch, never split across files
+void SsAccessSink::write(const SsAccessRecord *records, size_t count) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stream.write(reinterpret_cast<const char*>(records),
+                  static_cast<std::streamsize>(count * sizeof(*records)));
+}
+
+// everything written so far to the file
+void SsAccessSink::flush() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stream.flush();
+}
+
+// SsAccessLog constructor
+SsAccessLog::SsAccessLog(std::shared_ptr<SsAccessSink> sink) :
+    _sink(std::move(sink)),
+    _records(new SsAccessRecord[ACCESS_LOG_BATCH_RECORDS]),
+    _lastFlush(std::chrono::steady_clock::now()) {
+}
+
+// SsAccessLog destructor, nothing is left behind
+SsAccessLog::~SsAccessLog() {
+    flush();
+}
+
+// connection closed, its record is copied into the batch
+void SsAccessLog::close(SsAccessRecord &record, CloseReason reason) {
+    record.closed = wallClock();
+    record.reason = reason;
+    _records[_count++] = record;
+
+    if (_count == ACCESS_LOG_BATCH_RECORDS) {
+        _sink->write(_records.get(), _count);
+        _count = 0;
+    }
+}
+
+// reactor loop, idle reactors still get their records out
+void SsAccessLog::tick() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - _lastFlush >=
+            std::chrono::milliseconds(ACCESS_LOG_FLUSH_INTERVAL)) {
+        flush();
+    }
+}
+
+// batch to the sink and the sink to its file
+void SsAccessLog::flush() {
+    if (_count != 0) {
+        _sink->write(_records.get(), _count);
+        _count = 0;
+    }
+    _sink->flush();
+    _lastFlush = std::chrono::steady_clock::now();
+}
+
+// SsAccessLogReader constructor
+SsAccessLogReader::SsAccessLogReader(std::istream &in) : _input(in) {
+}
+
+// next record as logfmt, false at the end of the stream
+bool SsAccessLogReader::next(std::string &line) {
+    SsAccessRecord record;
+    _input.read(reinterpret_cast<char*>(&record), sizeof(record));
+    if (_input.gcount() == 0) {
+        return false;
+    }
+    if (_input.gcount() != sizeof(record)) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("truncated access record of %d bytes",
+                             static_cast<int64_t>(_input.gcount())));
+    }
+    if (record.reason > SsAccessRecord::CloseReason::CR_SHUTDOWN) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("unknown close reason %d",
+                             static_cast<int>(record.reason)));
+    }
+
+    // UTC wall clock with milliseconds
+    time_t seconds = record.opened / 1000000000;
+    std::tm utc{};
+#if defined(__platform_windows__)
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char date[ACCESS_LOG_TIME_SIZE];
+    auto length = std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(date + length, sizeof(date) - length, ".%03dZ",
+                  static_cast<int>(record.opened / 1000000 % 1000));
+
+    std::string user(record.user, strnlen(record.user, sizeof(record.user)));
+    std::string target(record.target,
+                       strnlen(record.target, sizeof(record.target)));
+    std::chrono::nanoseconds duration(record.closed - record.opened);
+
+    SsFormatBuffer buffer;
+    SsFieldWriter writer(buffer, SsFieldWriter::FieldStyle::FS_LOGFMT);
+    writer.fields(logField("opened", static_cast<const char*>(date)),
+                  logField("duration", duration),
+                  logField("user", user),
+                  logField("target", target),
+                  logField("port", record.port),
+                  logField("sent", record.sent),
+                  logField("received", record.received),
+                  logField("reason",
+                           SsAccessRecord::reasonName(record.reason)));
+
+    line = buffer.str();
+    return true;
+}
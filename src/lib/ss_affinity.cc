@@ -0,0 +1,179 @@
+#include "shadowsocks/ss_affinity.h"
+
+
+// static members definition
+std::vector<std::vector<size_t>> SsAffinity::_candidates;
+size_t SsAffinity::_reactors = 0;
+
+
+// allowed cores interleaved by node, computed once
+const std::vector<SsAffinity::Placement> &SsAffinity::placements() {
+    static const std::vector<Placement> placements = discover();
+    return placements;
+}
+
+// core of reactor, reactors beyond the core count share cores in order
+const SsAffinity::Placement &SsAffinity::placement(size_t reactor) {
+    auto &all = placements();
+    return all[reactor % all.size()];
+}
+
+// NUMA node of cpu from sysfs, unknown without NUMA support
+int SsAffinity::node(int cpu) {
+#if defined(__platform_linux__)
+    auto path = std::string(AFFINITY_SYSFS_CPU) + "/cpu" + std::to_string(cpu);
+    auto directory = ::opendir(path.c_str());
+    if (directory == nullptr) {
+        return AFFINITY_UNKNOWN_NODE;
+    }
+
+    auto result = AFFINITY_UNKNOWN_NODE;
+    while (auto entry = ::readdir(directory)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+                std::isdigit(static_cast<unsigned char>(entry->d_name[4]))) {
+            result = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    ::closedir(directory);
+
+    return result;
+#elif defined(__platform_windows__)
+    return AFFINITY_UNKNOWN_NODE;
+#endif
+}
+
+// core running the calling thread
+int SsAffinity::current() {
+#if defined(__platform_linux__)
+    return ::sched_getcpu();
+#elif defined(__platform_windows__)
+    return static_cast<int>(GetCurrentProcessorNumber());
+#endif
+}
+
+// reactors to pick from, candidates of every core are computed here: those
+// pinned there, else those on the same node, call before the reactors run
+void SsAffinity::setReactors(size_t reactors) {
+    std::vector<std::vector<size_t>> table;
+    for (auto &placement : placements()) {
+        if (placement.cpu >= static_cast<int>(table.size())) {
+            table.resize(static_cast<size_t>(placement.cpu) + 1);
+        }
+    }
+
+    for (size_t cpu = 0; cpu < table.size(); ++cpu) {
+        auto cpuNode = node(static_cast<int>(cpu));
+
+        // every reactor counts, placement() wraps beyond the core count
+        std::vector<size_t> local;
+        for (size_t i = 0; i < reactors; ++i) {
+            auto &where = placement(i);
+            if (where.cpu == static_cast<int>(cpu)) {
+                table[cpu].push_back(i);
+            } else if (cpuNode != AFFINITY_UNKNOWN_NODE &&
+                       where.node == cpuNode) {
+                local.push_back(i);
+            }
+        }
+        if (table[cpu].empty()) {
+            table[cpu] = std::move(local);
+        }
+    }
+
+    _candidates = std::move(table);
+    _reactors = reactors;
+}
+
+// reactor for a connection received on cpu (SO_INCOMING_CPU), a lookup in
+// the table of setReactors(), reactors sharing a core take turns, any
+// reactor for a core without candidates, zero without reactors
+size_t SsAffinity::reactorOf(int cpu) {
+    static std::atomic<size_t> turn{0};
+    if (_reactors == 0) {
+        return 0;
+    }
+
+    auto next = turn.fetch_add(1, std::memory_order_relaxed);
+    if (cpu >= 0 && static_cast<size_t>(cpu) < _candidates.size()) {
+        auto &candidates = _candidates[static_cast<size_t>(cpu)];
+        if (!candidates.empty()) {
+            return candidates[next % candidates.size()];
+        }
+    }
+
+    return next % _reactors;
+}
+
+// bind the calling thread to cpu
+SsResult<void> SsAffinity::pin(int cpu) {
+#if defined(__platform_linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return SsError(SsError::ErrorCode::EC_SYSTEM, EINVAL);
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (::sched_setaffinity(0, sizeof(set), &set) != OPERATOR_SUCCESS) {
+        return SsError::last();
+    }
+#elif defined(__platform_windows__)
+    if (cpu >= 64 || SetThreadAffinityMask(GetCurrentThread(),
+                                           DWORD_PTR(1) << cpu) == 0) {
+        return SsError(SsError::ErrorCode::EC_SYSTEM, GetLastError());
+    }
+#endif
+
+    return SsResult<void>();
+}
+
+// bind the calling thread to the core of reactor
+SsResult<void> SsAffinity::pinReactor(size_t reactor) {
+    return pin(placement(reactor).cpu);
+}
+
+// cores of the affinity mask the process started with, one node after the
+// other in turn
+std::vector<SsAffinity::Placement> SsAffinity::discover() {
+    std::map<int, std::vector<int>> nodes;
+#if defined(__platform_linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == OPERATOR_SUCCESS) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                nodes[node(cpu)].push_back(cpu);
+            }
+        }
+    }
+#elif defined(__platform_windows__)
+    DWORD_PTR process, system;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) {
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if (process & (DWORD_PTR(1) << cpu)) {
+                nodes[AFFINITY_UNKNOWN_NODE].push_back(cpu);
+            }
+        }
+    }
+#endif
+
+    std::vector<Placement> result;
+    for (size_t i = 0; ; ++i) {
+        auto added = false;
+        for (auto &node : nodes) {
+            if (i < node.second.size()) {
+                result.push_back(Placement{node.second[i], node.first});
+                added = true;
+            }
+        }
+        if (!added) {
+            break;
+        }
+    }
+
+    if (result.empty()) {
+        result.push_back(Placement{0, AFFINITY_UNKNOWN_NODE});
+    }
+    return result;
+}
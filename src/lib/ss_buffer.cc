@@ -0,0 +1,153 @@
+#include "shadowsocks/ss_buffer.h"
+
+
+// SsBufferPool constructor
+SsBufferPool::SsBufferPool(size_t segmentSize, size_t idleLimit) :
+    _segmentSize(segmentSize), _idleLimit(idleLimit) {
+    assert(segmentSize != 0);
+}
+
+// reuse an idle segment or allocate a new one
+SsBufferPool::Segment SsBufferPool::acquire() {
+    if (_idle.empty()) {
+        return Segment(new DATA_STREAM_UNIT[_segmentSize]);
+    }
+
+    auto segment = std::move(_idle.back());
+    _idle.pop_back();
+    return segment;
+}
+
+// keep segment for reuse unless enough are idle already
+void SsBufferPool::release(SsBufferPool::Segment segment) {
+    if (segment && _idle.size() < _idleLimit) {
+        _idle.push_back(std::move(segment));
+    }
+}
+
+// allocate idle segments up front and touch them, memory comes from the
+// NUMA node of the calling thread, so a pinned reactor reserves its own
+void SsBufferPool::reserve(size_t segments) {
+    segments = std::min(segments, _idleLimit);
+    while (_idle.size() < segments) {
+        Segment segment(new DATA_STREAM_UNIT[_segmentSize]);
+        std::memset(segment.get(), 0, _segmentSize);
+        _idle.push_back(std::move(segment));
+    }
+}
+
+// capacity of every segment
+size_t SsBufferPool::segmentSize() const {
+    return _segmentSize;
+}
+
+// number of segments ready for reuse
+size_t SsBufferPool::idle() const {
+    return _idle.size();
+}
+
+// SsBufferChain constructor
+SsBufferChain::SsBufferChain(SsBufferPool &pool) : _pool(pool) {
+}
+
+// SsBufferChain destructor
+SsBufferChain::~SsBufferChain() {
+    clear();
+}
+
+// readable bytes
+size_t SsBufferChain::size() const {
+    return _size;
+}
+
+// no readable bytes
+bool SsBufferChain::empty() const {
+    return _size == 0;
+}
+
+// copy data to the tail, filling the last segment first
+void SsBufferChain::append(const DATA_STREAM_UNIT *data, size_t size) {
+    while (size != 0) {
+        size_t available = 0;
+        auto tail = reserve(available);
+
+        auto length = std::min(available, size);
+        std::memcpy(tail, data, length);
+        commit(length);
+        data += length;
+        size -= length;
+    }
+}
+
+// writable space at the tail, e.g. for recv()
+DATA_STREAM_UNIT *SsBufferChain::reserve(size_t &available) {
+    if (_head == _pieces.size() ||
+            _pieces.back().end == _pool.segmentSize()) {
+        _pieces.push_back(Piece{_pool.acquire(), 0, 0});
+    }
+
+    auto &piece = _pieces.back();
+    available = _pool.segmentSize() - piece.end;
+    return piece.data.get() + piece.end;
+}
+
+// make bytes written after reserve() readable
+void SsBufferChain::commit(size_t size) {
+    assert(_head < _pieces.size());
+    assert(_pieces.back().end + size <= _pool.segmentSize());
+
+    _pieces.back().end += size;
+    _size += size;
+}
+
+// drop bytes from the head, drained segments go back to the pool, drained
+// pieces are compacted away once they are half of the vector
+void SsBufferChain::consume(size_t size) {
+    assert(size <= _size);
+    _size -= size;
+
+    while (size != 0) {
+        auto &piece = _pieces[_head];
+        auto length = std::min(piece.end - piece.begin, size);
+        piece.begin += length;
+        size -= length;
+
+        if (piece.begin == piece.end) {
+            _pool.release(std::move(piece.data));
+            ++_head;
+        }
+    }
+
+    if (_head == _pieces.size()) {
+        _pieces.clear();
+        _head = 0;
+    } else if (_head * 2 >= _pieces.size()) {
+        _pieces.erase(_pieces.begin(), _pieces.begin() + _head);
+        _head = 0;
+    }
+}
+
+// copy out without consuming, returns bytes copied
+size_t SsBufferChain::copy(size_t offset, DATA_STREAM_UNIT *out,
+                           size_t size) const {
+    if (offset >= _size) {
+        return 0;
+    }
+
+    size = std::min(size, _size - offset);
+    visit(offset, size, [&] (const DATA_STREAM_UNIT *data, size_t length) {
+        std::memcpy(out, data, length);
+        out += length;
+    });
+    return size;
+}
+
+// release every segment
+void SsBufferChain::clear() {
+    for (auto index = _head; index < _pieces.size(); ++index) {
+        _pool.release(std::move(_pieces[index].data));
+    }
+    _pieces.clear();
+    _head = 0;
+    _size = 0;
+}
@@ -0,0 +1,339 @@
+#include "shadowsocks/ss_configuration.h"
+#include "shadowsocks/ss_exception.h"
+
+
+// static members definition
+std::atomic<unsigned> SsConfigStore::_reloadRequests{0};
+
+
+// same address and port
+bool SsConfiguration::Listener::operator==(const Listener &other) const {
+    return port == other.port && host == other.host;
+}
+
+// read and check a configuration file, errors name the file and line
+SsConfiguration::Snapshot SsConfiguration::load(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("cannot open configuration %s: %s",
+                             path, std::strerror(errno)));
+    }
+
+    return parse(in, path);
+}
+
+// one directive per line, the whole configuration is checked before use
+SsConfiguration::Snapshot SsConfiguration::parse(std::istream &in,
+                                                 const std::string &name) {
+    std::shared_ptr<SsConfiguration> configuration(new SsConfiguration());
+
+    std::string text;
+    for (size_t number = 1; std::getline(in, text); ++number) {
+        auto comment = text.find('#');
+        if (comment != std::string::npos) {
+            text.erase(comment);
+        }
+
+        std::istringstream line(text);
+        configuration->directive(line, name + ":" + std::to_string(number));
+    }
+
+    if (configuration->_listeners.empty()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("%s: no listen directive", name));
+    }
+    if (configuration->_users.empty()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("%s: no user directive", name));
+    }
+
+    return configuration;
+}
+
+// addresses and ports to listen on
+const std::vector<SsConfiguration::Listener> &
+SsConfiguration::listeners() const {
+    return _listeners;
+}
+
+// users with their cipher and password
+const std::vector<SsConfiguration::User> &SsConfiguration::users() const {
+    return _users;
+}
+
+// user by name, nullptr when unknown
+const SsConfiguration::User *SsConfiguration::user(
+        const std::string &name) const {
+    for (auto &user : _users) {
+        if (user.name == name) {
+            return &user;
+        }
+    }
+
+    return nullptr;
+}
+
+// connection limits
+const SsConfiguration::Limits &SsConfiguration::limits() const {
+    return _limits;
+}
+
+// acl decision for a client or target address, IPv4 mapped IPv6 addresses
+// match IPv4 rules
+bool SsConfiguration::permitted(const SsNetwork::Address &address) const {
+    int family = address.ss_family;
+    const uint8_t *bytes = nullptr;
+    if (family == AF_INET) {
+        bytes = reinterpret_cast<const uint8_t*>(
+            &reinterpret_cast<const sockaddr_in&>(address).sin_addr);
+    } else if (family == AF_INET6) {
+        bytes = reinterpret_cast<const uint8_t*>(
+            &reinterpret_cast<const sockaddr_in6&>(address).sin6_addr);
+        static const uint8_t mapped[12] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff
+        };
+        if (std::memcmp(bytes, mapped, sizeof(mapped)) == 0) {
+            family = AF_INET;
+            bytes += sizeof(mapped);
+        }
+    } else {
+        return true;
+    }
+
+    for (auto &rule : _acl) {
+        if (matches(rule, family, bytes)) {
+            return rule.allow;
+        }
+    }
+
+    return true;
+}
+
+// listeners of after that before does not have
+std::vector<SsConfiguration::Listener> SsConfiguration::added(
+        const SsConfiguration &before, const SsConfiguration &after) {
+    std::vector<Listener> result;
+    for (auto &listener : after._listeners) {
+        if (std::find(before._listeners.begin(), before._listeners.end(),
+                      listener) == before._listeners.end()) {
+            result.push_back(listener);
+        }
+    }
+
+    return result;
+}
+
+// apply one line, blank lines have no keyword
+void SsConfiguration::directive(std::istringstream &line,
+                                const std::string &where) {
+    std::string keyword;
+    if (!(line >> keyword)) {
+        return;
+    }
+
+    auto invalid = [&] (const char *what) {
+        return SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("%s: %s", where, what));
+    };
+
+    if (keyword == "listen") {
+        Listener listener;
+        if (!(line >> listener.host >> listener.port) ||
+                listener.port <= 0 || listener.port > UINT16_MAX) {
+            throw invalid("expected listen <host> <port>");
+        }
+        if (std::find(_listeners.begin(), _listeners.end(), listener) ==
+                _listeners.end()) {
+            _listeners.push_back(std::move(listener));
+        }
+    } else if (keyword == "user") {
+        User user;
+        std::string method;
+        if (!(line >> user.name >> method >> user.password)) {
+            throw invalid("expected user <name> <method> <password>");
+        }
+        if (this->user(user.name) != nullptr) {
+            throw invalid("duplicate user");
+        }
+
+        auto &methods = SsCipher::methods();
+        auto found = std::find_if(methods.begin(), methods.end(),
+            [&] (SsCipher::CipherMethod candidate) {
+                return method == SsCipher::name(candidate);
+            }
+        );
+        if (found == methods.end()) {
+            throw invalid("unsupported cipher method");
+        }
+        user.method = *found;
+        _users.push_back(std::move(user));
+    } else if (keyword == "limit") {
+        std::string limit;
+        long long value;
+        if (!(line >> limit >> value) || value <= 0) {
+            throw invalid("expected limit <name> <positive value>");
+        }
+
+        if (limit == "connections") {
+            _limits.connections = static_cast<size_t>(value);
+        } else if (limit == "idle") {
+            _limits.idle = std::chrono::seconds(value);
+        } else {
+            throw invalid("unknown limit");
+        }
+    } else if (keyword == "acl") {
+        std::string action, address;
+        if (!(line >> action >> address) ||
+                (action != "allow" && action != "deny")) {
+            throw invalid("expected acl allow|deny <address>[/<prefix>]");
+        }
+        _acl.push_back(rule(action == "allow", address, where));
+    } else {
+        throw invalid("unknown directive");
+    }
+
+    std::string extra;
+    if (line >> extra) {
+        throw invalid("unexpected text at the end of the line");
+    }
+}
+
+// address with an optional prefix length, the whole address without one
+SsConfiguration::AclRule SsConfiguration::rule(bool allow,
+                                               const std::string &text,
+                                               const std::string &where) {
+    AclRule rule{allow, AF_INET, {}, 0};
+
+    auto slash = text.find('/');
+    auto address = text.substr(0, slash);
+    if (::inet_pton(AF_INET, address.c_str(), rule.address) == 1) {
+        rule.family = AF_INET;
+    } else if (::inet_pton(AF_INET6, address.c_str(), rule.address) == 1) {
+        rule.family = AF_INET6;
+    } else {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("%s: invalid address %s", where, address));
+    }
+
+    auto bits = rule.family == AF_INET ? 32 : 128;
+    auto prefix = bits;
+    if (slash != std::string::npos) {
+        char *end = nullptr;
+        prefix = static_cast<int>(std::strtol(text.c_str() + slash + 1,
+                                              &end, 10));
+        if (end == text.c_str() + slash + 1 || *end != '\0' ||
+                prefix < 0 || prefix > bits) {
+            throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+                SsLogger::format("%s: invalid prefix in %s", where, text));
+        }
+    }
+    rule.prefix = static_cast<uint8_t>(prefix);
+
+    return rule;
+}
+
+// first prefix bits equal
+bool SsConfiguration::matches(const AclRule &rule, int family,
+                              const uint8_t *address) {
+    if (rule.family != family) {
+        return false;
+    }
+
+    auto bytes = rule.prefix / 8;
+    if (std::memcmp(rule.address, address, bytes) != 0) {
+        return false;
+    }
+
+    auto bits = rule.prefix % 8;
+    if (bits == 0) {
+        return true;
+    }
+
+    auto mask = static_cast<uint8_t>(0xff << (8 - bits));
+    return (rule.address[bytes] & mask) == (address[bytes] & mask);
+}
+
+// SsConfigStore constructor, a broken configuration fails the startup
+SsConfigStore::SsConfigStore(std::string path) :
+    _path(std::move(path)), _current(SsConfiguration::load(_path)),
+    _reloadsSeen(_reloadRequests.load(std::memory_order_relaxed)) {
+}
+
+// snapshot for a new connection, kept by it until it closes
+SsConfigStore::Snapshot SsConfigStore::current() const {
+    return std::atomic_load(&_current);
+}
+
+// bumped by every successful reload
+uint64_t SsConfigStore::generation() const {
+    return _generation.load(std::memory_order_acquire);
+}
+
+// build the new snapshot, then publish it, a broken file keeps the current
+// configuration running
+bool SsConfigStore::reload() {
+    Snapshot next;
+    try {
+        next = SsConfiguration::load(_path);
+    } catch (const SsException &) {
+        ERR("configuration %s not reloaded, generation %d stays",
+            _path, generation());
+        return false;
+    }
+
+    auto before = current();
+    auto opened = SsConfiguration::added(*before, *next);
+    auto closed = SsConfiguration::added(*next, *before);
+
+    std::atomic_store(&_current, next);
+    _generation.fetch_add(1, std::memory_order_release);
+
+    INF_FIELDS("configuration reloaded", logField("path", _path),
+               logField("generation", generation()),
+               logField("users", next->users().size()),
+               logField("opened", opened.size()),
+               logField("closed", closed.size()));
+    return true;
+}
+
+// reload if one was requested since the last call, from the main thread
+// or a control command, never from a reactor
+bool SsConfigStore::poll() {
+    auto requests = _reloadRequests.load(std::memory_order_relaxed);
+    if (requests == _reloadsSeen) {
+        return false;
+    }
+
+    _reloadsSeen = requests;
+    return reload();
+}
+
+// ask every store to reload on its next poll, async signal safe (SIGHUP)
+void SsConfigStore::requestReload() {
+    _reloadRequests.fetch_add(1, std::memory_order_relaxed);
+}
+
+// View constructor
+SsConfigStore::View::View(const SsConfigStore &store) :
+    _store(store), _generation(store.generation()) {
+    _snapshot = _store.current();
+}
+
+// snapshot as of the last refresh
+const SsConfigStore::Snapshot &SsConfigStore::View::get() const {
+    return _snapshot;
+}
+
+// pick up a new snapshot, true when it changed, the reactor then opens and
+// closes listeners with SsConfiguration::added
+bool SsConfigStore::View::refresh() {
+    auto generation = _store.generation();
+    if (generation == _generation) {
+        return false;
+    }
+
+    _snapshot = _store.current();
+    _generation = generation;
+    return true;
+}
@@ -1,8 +1,15 @@
 #include "shadowsocks/ss_core.h"
+#include "shadowsocks/ss_configuration.h"
 #define DEBUG_LOGGER_NAME       ("debug")
 
 // SsCore static members
 std::vector<std::function<void()>> SsCore::_exitCallbacks;
+std::atomic<bool> SsCore::_drainRequested{false};
+std::atomic<bool> SsCore::_closeRequested{false};
+std::atomic<bool> SsCore::_polled{false};
+std::atomic<int64_t> SsCore::_drainDeadline{0};
+std::chrono::milliseconds SsCore::_drainPeriod(CORE_DRAIN_PERIOD);
+std::chrono::milliseconds SsCore::_drainIdle(CORE_DRAIN_IDLE);
 
 
 // shadowsocks environment initializing
@@ -10,6 +17,7 @@ void SsCore::initEnvironments() {
     std::atexit(&SsCore::shutdownHandler);
 
     socketStartup();
+    signalStartup();
 }
 
 // on internal error occurs, cleanup resources
@@ -29,25 +37,69 @@ void SsCore::socketStartup() {
 #if defined(__platform_windows__)
     WSAData winSocketData{};
     if (WSAStartup(MAKEWORD(2, 2), &winSocketData) != OPERATOR_SUCCESS) {
-        SsLogger::emergency("Socket environment startup failure on windows");
+        EXT("Socket environment startup failure on windows");
     }
 
     auto socketCleanup = [] () {
         if (WSACleanup() != OPERATOR_SUCCESS) {
-            SsLogger::emergency("Socket environment cleanup failure");
+            EXT("Socket environment cleanup failure");
         }
     };
     SsCore::atExit(socketCleanup);
-    SsLogger::debug("Socket environment startup on windows");
+    DBG("Socket environment startup on windows");
 #endif
 }
 
-// enable debug logger with stdout
+// signal handlers shared by all binaries, SIGTERM, SIGINT and SIGQUIT keep
+// their default action until an event loop polls the shutdown phase, a
+// process nobody drains just ends
+void SsCore::signalStartup() {
+#if defined(__platform_linux__)
+    std::signal(SIGHUP, &SsCore::hangupHandler);
+    std::signal(SIGUSR1, &SsCore::recorderHandler);
+    for (auto signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+        std::signal(signal, &SsCore::fatalHandler);
+    }
+#endif
+}
+
+// SIGHUP, log files are reopened on their next write, the configuration
+// on the next SsConfigStore::poll
+void SsCore::hangupHandler(int signal) {
+    SsFileBuffer::reopenAll();
+    SsConfigStore::requestReload();
+}
+
+// SIGTERM and SIGINT, only recorded, the event loops drain, close and
+// return, repeating them changes nothing, e.g. when a service manager and
+// the master both send one
+void SsCore::terminateHandler(int signal) {
+    requestShutdown();
+}
+
+// SIGQUIT, connections are closed without draining
+void SsCore::quitHandler(int signal) {
+    requestClose();
+}
+
+// SIGUSR1, flight recorder dumped on request
+void SsCore::recorderHandler(int signal) {
+    SsLogger::dumpFlightRecorder();
+}
+
+// crash, the flight recorder is dumped, then the default action runs
+void SsCore::fatalHandler(int signal) {
+    SsLogger::dumpFlightRecorder();
+
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+// enable debug logger with stdout, levels below the compiled minimum are
+// never emitted whatever is set here
 void SsCore::enableDebugLogger(SsLogger::LoggerLevel level) {
     auto logger = std::make_shared<SsLogger>(std::cout);
-#if defined(__type_debug__)
     logger->setLevel(level);
-#endif
 
     SsLogger::addLogger(DEBUG_LOGGER_NAME, std::move(logger));
 }
@@ -56,3 +108,76 @@ void SsCore::enableDebugLogger(SsLogger::LoggerLevel level) {
 void SsCore::disableDebugLogger() {
     SsLogger::removeLogger(DEBUG_LOGGER_NAME);
 }
+
+// drain period after a shutdown request, and the idle time after which a
+// draining relay is half closed, set before the event loops start
+void SsCore::setDrainPeriod(std::chrono::milliseconds period,
+                            std::chrono::milliseconds idle) {
+    _drainPeriod = period;
+    _drainIdle = idle;
+}
+
+// stop accepting and drain, async signal safe
+void SsCore::requestShutdown() {
+    _drainRequested.store(true, std::memory_order_relaxed);
+}
+
+// stop accepting and close every connection now, async signal safe
+void SsCore::requestClose() {
+    _closeRequested.store(true, std::memory_order_relaxed);
+}
+
+// polled by the event loops, the first poll takes SIGTERM, SIGINT and
+// SIGQUIT over from their default action, the drain period starts when the
+// first loop sees the request
+SsCore::ShutdownPhase SsCore::shutdownPhase() {
+    if (!_polled.load(std::memory_order_relaxed) &&
+            !_polled.exchange(true, std::memory_order_relaxed)) {
+#if defined(__platform_linux__)
+        std::signal(SIGTERM, &SsCore::terminateHandler);
+        std::signal(SIGINT, &SsCore::terminateHandler);
+        std::signal(SIGQUIT, &SsCore::quitHandler);
+#endif
+    }
+
+    if (_closeRequested.load(std::memory_order_relaxed)) {
+        return ShutdownPhase::SP_CLOSING;
+    } else if (!_drainRequested.load(std::memory_order_relaxed)) {
+        return ShutdownPhase::SP_RUNNING;
+    }
+
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+    auto deadline = _drainDeadline.load(std::memory_order_relaxed);
+    if (deadline == 0) {
+        auto ours = now + std::chrono::duration_cast<std::chrono::nanoseconds>(
+            _drainPeriod).count();
+        if (_drainDeadline.compare_exchange_strong(deadline, ours)) {
+            INF("shutdown requested, draining connections for %d ms",
+                _drainPeriod.count());
+            deadline = ours;
+        }
+    }
+
+    return now < deadline ? ShutdownPhase::SP_DRAINING
+                          : ShutdownPhase::SP_CLOSING;
+}
+
+// listeners stop accepting as soon as a shutdown is requested
+bool SsCore::accepting() {
+    return shutdownPhase() == ShutdownPhase::SP_RUNNING;
+}
+
+// what to do with a relay last active at lastActivity: idle ones are half
+// closed while draining so their peers finish, all are closed afterwards
+SsCore::DrainAction SsCore::drainAction(Clock::time_point lastActivity) {
+    switch (shutdownPhase()) {
+        case ShutdownPhase::SP_RUNNING:
+            return DrainAction::DA_KEEP;
+        case ShutdownPhase::SP_DRAINING:
+            return Clock::now() - lastActivity >= _drainIdle
+                ? DrainAction::DA_HALF_CLOSE : DrainAction::DA_KEEP;
+        default:
+            return DrainAction::DA_CLOSE;
+    }
+}
@@ -2,7 +2,8 @@
 
 
 // SsException constructor
-SsException::SsException(SsLogger::LoggerLevel level, std::string message):
+SsException::SsException(SsLogger::LoggerLevel level,
+                         const std::string &message):
     std::runtime_error(message) {
     SsLogger::log(level, message.c_str());
 }
@@ -0,0 +1,327 @@
+#include "shadowsocks/ss_file_logger.h"
+#include "shadowsocks/ss_exception.h"
+
+
+#define FILE_LOGGER_SUFFIX_SIZE         (32)
+
+
+// static members definition
+std::atomic<unsigned> SsFileBuffer::_reopenGeneration{0};
+
+
+// SsFileBuffer constructor, the file is opened right away
+SsFileBuffer::SsFileBuffer(std::string path, SsFileRotation rotation,
+                           FlushPolicy policy) :
+    _path(std::move(path)), _rotation(rotation), _policy(policy),
+    _generation(_reopenGeneration.load(std::memory_order_relaxed)),
+    _buffer(new char[FILE_LOGGER_BUFFER_SIZE]),
+    _lastWrite(std::chrono::steady_clock::now()) {
+    setp(_buffer.get(), _buffer.get() + FILE_LOGGER_BUFFER_SIZE);
+    _boundary = pbase();
+
+    if (!open()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("cannot open log file %s: %s",
+                             _path, std::strerror(errno)));
+    }
+    _rotateAt = nextRotation(std::time(nullptr));
+}
+
+// SsFileBuffer destructor, everything buffered is written
+SsFileBuffer::~SsFileBuffer() {
+    writeOut();
+    close();
+}
+
+// bytes written at the head of every rotated or reopened file, called with
+// the writer's lock held
+void SsFileBuffer::setHeader(Header header) {
+    _header = std::move(header);
+}
+
+// utc offset of local time for interval rotation, called with the
+// writer's lock held, the timezone is asked directly without one
+void SsFileBuffer::setLocalOffset(LocalOffset offset) {
+    _localOffset = std::move(offset);
+}
+
+// reopen every log file on the next write, async signal safe (SIGHUP)
+void SsFileBuffer::reopenAll() {
+    _reopenGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+// buffer full, write it out and keep the character
+SsFileBuffer::int_type SsFileBuffer::overflow(int_type c) {
+    writeOut(_boundary);
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+        _boundary = pptr();
+    }
+
+    return traits_type::not_eof(c);
+}
+
+// copy into the buffer, a full buffer is written up to the end of the last
+// complete call, so lines and binary records never span two files
+std::streamsize SsFileBuffer::xsputn(const char *data, std::streamsize size) {
+    auto remaining = size;
+    while (remaining > 0) {
+        if (pptr() == epptr()) {
+            writeOut(_boundary);
+        }
+
+        auto length = std::min<std::streamsize>(remaining, epptr() - pptr());
+        std::memcpy(pptr(), data, static_cast<size_t>(length));
+        pbump(static_cast<int>(length));
+        data += length;
+        remaining -= length;
+    }
+
+    _boundary = pptr();
+    return size;
+}
+
+// ostream::flush, synchronous logging writes out right away since nothing
+// flushes later, the async writer flushes on its interval, so the file is
+// written at most once per flush interval, FP_ALWAYS leaves that to the owner
+int SsFileBuffer::sync() {
+    auto now = std::chrono::steady_clock::now();
+    if (pptr() != pbase() && (_policy == FlushPolicy::FP_ALWAYS ||
+            !SsLogger::asyncEnabled() ||
+            now - _lastWrite >=
+                std::chrono::milliseconds(FILE_LOGGER_FLUSH_INTERVAL))) {
+        writeOut();
+    }
+
+    return 0;
+}
+
+// append mode, unbuffered since the buffer is ours
+bool SsFileBuffer::open() {
+    _file = std::fopen(_path.c_str(), "ab");
+    if (_file == nullptr) {
+        return false;
+    }
+
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+    std::fseek(_file, 0, SEEK_END);
+    auto size = std::ftell(_file);
+    _fileSize = size > 0 ? static_cast<size_t>(size) : 0;
+
+    return true;
+}
+
+// close current file
+void SsFileBuffer::close() {
+    if (_file != nullptr) {
+        std::fclose(_file);
+        _file = nullptr;
+    }
+}
+
+// rename to path.<date>[.n] and continue in a new file, no data is copied,
+// the rename runs on its own thread so the writer's lock is not held over
+// it, windows cannot rename an open file and rotates inline
+void SsFileBuffer::rotate(time_t now) {
+    char date[FILE_LOGGER_SUFFIX_SIZE];
+    std::tm local{};
+#if defined(__platform_windows__)
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    std::strftime(date, sizeof(date), ".%Y%m%d-%H%M%S", &local);
+    _rotateAt = nextRotation(now);
+
+#if !defined(__platform_windows__)
+    std::shared_ptr<Rotation> rotation(new Rotation());
+    rotation->path = _path;
+    rotation->suffix = date;
+    try {
+        std::thread([rotation] {
+            rename(rotation->path, rotation->suffix);
+            rotation->done.store(true, std::memory_order_release);
+        }).detach();
+        _rotating = std::move(rotation);
+        return;
+    } catch (const std::system_error &) {
+        // no thread available, rotate inline
+    }
+#endif
+
+    close();
+    rename(_path, date);
+    if (open()) {
+        writeHeader();
+    }
+}
+
+// the rename finished, continue in a new file at path
+void SsFileBuffer::rotated() {
+    _rotating.reset();
+    close();
+    if (open()) {
+        writeHeader();
+    }
+}
+
+// first free path.<suffix>[.n], the file keeps its inode
+void SsFileBuffer::rename(const std::string &path, const std::string &suffix) {
+    auto target = path + suffix;
+    for (int n = 1; ; ++n) {
+        auto exists = std::fopen(target.c_str(), "rb");
+        if (exists == nullptr) {
+            break;
+        }
+        std::fclose(exists);
+        target = path + suffix + "." + std::to_string(n);
+    }
+    std::rename(path.c_str(), target.c_str());
+}
+
+// header of a new file, before anything of the buffer
+void SsFileBuffer::writeHeader() {
+    if (!_header) {
+        return;
+    }
+
+    _headerBytes.clear();
+    _header(_headerBytes);
+    if (!_headerBytes.empty() &&
+            std::fwrite(_headerBytes.data(), 1, _headerBytes.size(), _file) ==
+                _headerBytes.size()) {
+        _fileSize += _headerBytes.size();
+    }
+}
+
+// write the whole buffer
+void SsFileBuffer::writeOut() {
+    writeOut(pptr());
+}
+
+// write [pbase, end) with a single call, rotating or reopening first, the
+// rest moves to the front, without a boundary everything is written
+void SsFileBuffer::writeOut(char *end) {
+    if (end == pbase()) {
+        end = pptr();
+    }
+
+    auto size = static_cast<size_t>(end - pbase());
+    if (size == 0) {
+        return;
+    }
+
+    // SIGHUP, e.g. after logrotate moved the file
+    auto generation = _reopenGeneration.load(std::memory_order_relaxed);
+    if (generation != _generation) {
+        _generation = generation;
+        if (_rotating && _rotating->done.load(std::memory_order_acquire)) {
+            _rotating.reset();
+        }
+        close();
+        if (open()) {
+            writeHeader();
+        }
+    }
+
+    auto now = std::time(nullptr);
+    if (_rotating) {
+        // the renamed file may outgrow its limit once, not without bound
+        while (_rotation.size != 0 && _fileSize > 2 * _rotation.size &&
+               !_rotating->done.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        if (_rotating->done.load(std::memory_order_acquire)) {
+            rotated();
+        }
+    } else if (_file != nullptr &&
+            ((_rotation.size != 0 && _fileSize != 0 &&
+              _fileSize + size > _rotation.size) ||
+             (_rotateAt != 0 && now >= _rotateAt))) {
+        rotate(now);
+    }
+
+    // the logger lock is held here, so failures cannot be logged
+    if (_file == nullptr && !open()) {
+        std::fprintf(stderr, "log file %s unavailable: %s, %zu bytes lost\n",
+                     _path.c_str(), std::strerror(errno), size);
+    } else if (std::fwrite(pbase(), 1, size, _file) != size) {
+        std::fprintf(stderr, "log file %s write failed: %s\n",
+                     _path.c_str(), std::strerror(errno));
+    } else {
+        _fileSize += size;
+    }
+
+    auto rest = pptr() - end;
+    std::memmove(_buffer.get(), end, static_cast<size_t>(rest));
+    setp(_buffer.get(), _buffer.get() + FILE_LOGGER_BUFFER_SIZE);
+    pbump(static_cast<int>(rest));
+    _boundary = pbase();
+    _lastWrite = std::chrono::steady_clock::now();
+}
+
+// next interval boundary in local time, daily rotation happens at local
+// midnight, zero when time rotation is off
+time_t SsFileBuffer::nextRotation(time_t now) const {
+    auto interval = static_cast<time_t>(_rotation.interval.count());
+    if (interval <= 0) {
+        return 0;
+    }
+
+    time_t offset;
+    if (_localOffset) {
+        offset = _localOffset(now);
+    } else {
+        std::tm local{};
+#if defined(__platform_windows__)
+        localtime_s(&local, &now);
+        std::tm utc{};
+        gmtime_s(&utc, &now);
+        utc.tm_isdst = local.tm_isdst;
+        offset = now - std::mktime(&utc);
+#else
+        localtime_r(&now, &local);
+        offset = static_cast<time_t>(local.tm_gmtoff);
+#endif
+    }
+
+    return ((now + offset) / interval + 1) * interval - offset;
+}
+
+// SsFileStream constructor
+SsFileStream::SsFileStream(std::string path, SsFileRotation rotation,
+                           SsFileBuffer::FlushPolicy policy) :
+    std::ostream(nullptr), _buffer(std::move(path), rotation, policy) {
+    rdbuf(&_buffer);
+}
+
+// header of every new file
+void SsFileStream::setHeader(SsFileBuffer::Header header) {
+    _buffer.setHeader(std::move(header));
+}
+
+// utc offset for interval rotation
+void SsFileStream::setLocalOffset(SsFileBuffer::LocalOffset offset) {
+    _buffer.setLocalOffset(std::move(offset));
+}
+
+// SsFileLogger constructor
+SsFileLogger::SsFileLogger(std::string path, SsFileRotation rotation) :
+    SsFileStream(std::move(path), rotation),
+    SsLogger(static_cast<std::ostream&>(*this)) {
+    // binary records refer to formats written earlier, a rotated file
+    // repeats them all
+    setHeader([this] (std::string &header) {
+        encodeFormats(header);
+    });
+    setLocalOffset([this] (time_t now) {
+        return utcOffset(now);
+    });
+}
+
+// SsFileLogger destructor, the buffer outlives the logger part
+SsFileLogger::~SsFileLogger() {
+    setHeader(nullptr);
+    setLocalOffset(nullptr);
+}
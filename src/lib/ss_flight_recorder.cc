@@ -0,0 +1,206 @@
+#include "shadowsocks/ss_flight_recorder.h"
+
+
+// room a "%s" record needs besides the text
+#define FLIGHT_RECORDER_TEXT_OVERHEAD   (SsLogRecord::MESSAGE_HEADER_SIZE + 4)
+
+
+// static members definition, off until enabled
+std::atomic<uint8_t> SsFlightRecorder::_level{UINT8_MAX};
+char SsFlightRecorder::_path[FLIGHT_RECORDER_PATH_SIZE] = {};
+std::atomic<SsFlightRing*> SsFlightRecorder::_rings[FLIGHT_RECORDER_THREADS];
+
+
+/* ring of the calling thread, handed to another thread after it exits */
+struct SsFlightThreadRing {
+    SsFlightRing *ring = nullptr;
+    ~SsFlightThreadRing();
+};
+
+static thread_local bool flightRetired = false;
+static thread_local SsFlightThreadRing flightRingHolder;
+
+// records stay in the ring until the next owner overwrites them
+SsFlightThreadRing::~SsFlightThreadRing() {
+    if (ring != nullptr) {
+        ring->release();
+    }
+    flightRetired = true;
+}
+
+// claim an unowned ring
+bool SsFlightRing::acquire() {
+    auto owned = false;
+    return _owned.compare_exchange_strong(owned, true,
+                                          std::memory_order_acquire);
+}
+
+// owner thread exited
+void SsFlightRing::release() {
+    _owned.store(false, std::memory_order_release);
+}
+
+// overwrite the oldest slot, the sequence is odd while it is written
+void SsFlightRing::push(const char *format, const char *record, size_t size) {
+    auto index = _next.load(std::memory_order_relaxed);
+    auto &slot = _slots[index % FLIGHT_RECORDER_SLOTS];
+    auto sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.format = format;
+    slot.size = size;
+    std::memcpy(slot.data, record, size);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    _next.store(index + 1, std::memory_order_release);
+}
+
+// keep records at or above level, dumps are appended to path
+void SsFlightRecorder::enable(uint8_t level, const std::string &path) {
+    auto length = std::min(path.size(), sizeof(_path) - 1);
+    std::memcpy(_path, path.data(), length);
+    _path[length] = '\0';
+
+    _level.store(level, std::memory_order_relaxed);
+}
+
+// stop recording, what is recorded can still be dumped
+void SsFlightRecorder::disable() {
+    _level.store(UINT8_MAX, std::memory_order_relaxed);
+}
+
+// lowest level kept
+uint8_t SsFlightRecorder::level() {
+    return _level.load(std::memory_order_relaxed);
+}
+
+// free text message as a "%s" record, truncated to fit a slot
+void SsFlightRecorder::record(uint8_t level, const char *message, size_t size) {
+    SsFormatBuffer record;
+    size = std::min<size_t>(size, FLIGHT_RECORDER_SLOT_SIZE -
+                                  FLIGHT_RECORDER_TEXT_OVERHEAD);
+    SsLogRecord::encodeText(record, level, message, size);
+    push(SsLogRecord::textFormat(), record);
+}
+
+// append every ring to the dump file as a binary log stream, each message
+// preceded by the process and its format, only async signal safe calls
+// are made
+bool SsFlightRecorder::dump() {
+#if defined(__platform_linux__)
+    if (_path[0] == '\0') {
+        return false;
+    }
+
+    auto descriptor = ::open(_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (descriptor < 0) {
+        return false;
+    }
+
+    // one writev per record, so dumps of several processes appending to
+    // the same file interleave whole records only
+    auto writeAll = [descriptor] (iovec *parts, int count) {
+        while (count != 0) {
+            auto written = ::writev(descriptor, parts, count);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return;
+            }
+
+            auto done = static_cast<size_t>(written);
+            while (count != 0 && done >= parts->iov_len) {
+                done -= parts->iov_len;
+                ++parts;
+                --count;
+            }
+            if (count != 0) {
+                parts->iov_base = static_cast<char*>(parts->iov_base) + done;
+                parts->iov_len -= done;
+            }
+        }
+    };
+
+    // format ids are per process, getpid is async signal safe
+    auto stream = static_cast<uint32_t>(::getpid());
+
+    for (auto &entry : _rings) {
+        auto ring = entry.load(std::memory_order_acquire);
+        if (ring == nullptr) {
+            continue;
+        }
+
+        ring->visit([&] (const char *format, const char *record, size_t size) {
+            auto id = SsLogRecord::messageFormat(record);
+            auto length = static_cast<uint16_t>(
+                std::min<size_t>(std::strlen(format), UINT16_MAX));
+
+            char header[1 + sizeof(stream) + 1 + sizeof(id) + sizeof(length)];
+            auto position = header;
+            *position++ = static_cast<char>(
+                SsLogRecord::RecordType::RT_STREAM);
+            std::memcpy(position, &stream, sizeof(stream));
+            position += sizeof(stream);
+            *position++ = static_cast<char>(
+                SsLogRecord::RecordType::RT_FORMAT);
+            std::memcpy(position, &id, sizeof(id));
+            position += sizeof(id);
+            std::memcpy(position, &length, sizeof(length));
+
+            iovec parts[3] = {
+                {header, sizeof(header)},
+                {const_cast<char*>(format), length},
+                {const_cast<char*>(record), size}
+            };
+            writeAll(parts, 3);
+        });
+    }
+
+    ::close(descriptor);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// ring of the calling thread, a released ring is reused before a new one is
+// published, none once every entry is owned
+SsFlightRing *SsFlightRecorder::threadRing() {
+    if (flightRetired) {
+        return nullptr;
+    }
+    if (flightRingHolder.ring != nullptr) {
+        return flightRingHolder.ring;
+    }
+
+    for (auto &entry : _rings) {
+        auto ring = entry.load(std::memory_order_acquire);
+        if (ring == nullptr) {
+            std::unique_ptr<SsFlightRing> created(new SsFlightRing());
+            created->acquire();
+            if (entry.compare_exchange_strong(ring, created.get(),
+                                              std::memory_order_acq_rel)) {
+                flightRingHolder.ring = created.release();
+                return flightRingHolder.ring;
+            }
+            // another thread published here first, ring is its entry
+        }
+
+        if (ring->acquire()) {
+            flightRingHolder.ring = ring;
+            return ring;
+        }
+    }
+
+    return nullptr;
+}
+
+// record into the ring of the calling thread
+void SsFlightRecorder::push(const char *format, const SsFormatBuffer &record) {
+    auto ring = threadRing();
+    if (ring != nullptr) {
+        ring->push(format, record.data(), record.size());
+    }
+}
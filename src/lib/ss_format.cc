@@ -0,0 +1,168 @@
+#include "shadowsocks/ss_format.h"
+
+
+// append raw bytes, silently truncated at capacity
+void SsFormatBuffer::append(const char *data, size_t size) {
+    size = std::min(size, FORMAT_BUFFER_SIZE - _size);
+    std::memcpy(_data + _size, data, size);
+    _size += size;
+}
+
+// append one character
+void SsFormatBuffer::append(char c) {
+    if (_size < FORMAT_BUFFER_SIZE) {
+        _data[_size++] = c;
+    }
+}
+
+// formatted bytes, not null terminated
+const char *SsFormatBuffer::data() const {
+    return _data;
+}
+
+// number of formatted bytes
+size_t SsFormatBuffer::size() const {
+    return _size;
+}
+
+// bytes left before truncation
+size_t SsFormatBuffer::available() const {
+    return FORMAT_BUFFER_SIZE - _size;
+}
+
+// copy out as string
+std::string SsFormatBuffer::str() const {
+    return std::string(_data, _size);
+}
+
+// decimal or lowercase hex digits
+void SsFormatBuffer::writeUnsigned(unsigned long long value, bool hex) {
+    static const char digits[] = "0123456789abcdef";
+    const unsigned base = hex ? 16 : 10;
+
+    char text[24];
+    size_t length = 0;
+    do {
+        text[sizeof(text) - ++length] = digits[value % base];
+        value /= base;
+    } while (value != 0);
+
+    append(text + sizeof(text) - length, length);
+}
+
+// %g matches the default ostream precision
+void SsFormatBuffer::writeFloating(double value) {
+    char text[32];
+    auto length = std::snprintf(text, sizeof(text), "%g", value);
+    if (length > 0) {
+        append(text, std::min(static_cast<size_t>(length), sizeof(text) - 1));
+    }
+}
+
+// null terminated string
+void SsFormatBuffer::write(const char *value, bool hex,
+                           KindTag<ArgumentKind::AK_STRING>) {
+    if (value == nullptr) {
+        append("(null)", 6);
+    } else {
+        append(value, std::strlen(value));
+    }
+}
+
+// std::string
+void SsFormatBuffer::write(const std::string &value, bool hex,
+                           KindTag<ArgumentKind::AK_STRING>) {
+    append(value.data(), value.size());
+}
+
+// copy literals and escapes up to the next placeholder
+const char *formatRuntimeNext(SsFormatBuffer &buffer, const char *fmt) {
+    for (;;) {
+        auto literal = fmt;
+        while (*fmt != '\0' && *fmt != '%') {
+            ++fmt;
+        }
+        buffer.append(literal, fmt - literal);
+
+        if (*fmt == '\0') {
+            return fmt;
+        } else if (fmt[1] == '%') {
+            buffer.append('%');
+            fmt += 2;
+        } else if (fmt[1] == '\0') {
+            buffer.append('%');
+            return fmt + 1;
+        } else {
+            return fmt;
+        }
+    }
+}
+
+// no arguments left, placeholders are printed as they are
+void formatRuntime(SsFormatBuffer &buffer, const char *fmt) {
+    for (;;) {
+        fmt = formatRuntimeNext(buffer, fmt);
+        if (*fmt == '\0') {
+            return;
+        }
+
+        buffer.append('%');
+        ++fmt;
+    }
+}
+
+// SsFormatStream constructor, an operator<< that logs itself gets its own
+// stream instead of the per thread one
+SsFormatStream::SsFormatStream(SsFormatBuffer &buffer, bool hex) {
+    auto &shared = SsFormatStream::shared();
+    if (shared.busy) {
+        _nested.reset(new Shared());
+        _shared = _nested.get();
+    } else {
+        _shared = &shared;
+    }
+
+    _shared->busy = true;
+    _shared->buffer.target = &buffer;
+    // same state as a fresh stream, an operator<< may have changed it
+    auto &out = _shared->out;
+    out.clear();
+    out.flags(std::ios_base::skipws |
+              (hex ? std::ios_base::hex : std::ios_base::dec));
+    out.width(0);
+    out.precision(6);
+    out.fill(' ');
+}
+
+// SsFormatStream destructor
+SsFormatStream::~SsFormatStream() {
+    _shared->buffer.target = nullptr;
+    _shared->busy = false;
+}
+
+// stream writing into the buffer
+std::ostream &SsFormatStream::get() {
+    return _shared->out;
+}
+
+// stream of the calling thread
+SsFormatStream::Shared &SsFormatStream::shared() {
+    static thread_local Shared stream;
+    return stream;
+}
+
+// one character, truncated like append()
+SsFormatStream::Buffer::int_type SsFormatStream::Buffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        target->append(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+// bytes, what does not fit is dropped and reported as written so the
+// stream stays good
+std::streamsize SsFormatStream::Buffer::xsputn(const char *data,
+                                               std::streamsize size) {
+    target->append(data, static_cast<size_t>(size));
+    return size;
+}
@@ -0,0 +1,181 @@
+#include "shadowsocks/ss_log_fields.h"
+
+
+// SsFieldWriter constructor
+SsFieldWriter::SsFieldWriter(SsFormatBuffer &buffer, FieldStyle style) :
+    _buffer(buffer), _style(style) {
+}
+
+// free text message as the msg field
+void SsFieldWriter::message(const char *data, size_t size) {
+    key(_style == FieldStyle::FS_JOURNAL ? "MESSAGE" : "msg");
+    if (!_full) {
+        string(data, size);
+        close();
+    }
+}
+
+// no fields left
+void SsFieldWriter::fields() {
+}
+
+// separator and key, keys are escaped like any other string, a field
+// without room for a short value is not started
+void SsFieldWriter::key(const char *key) {
+    auto length = std::strlen(key);
+    if (_buffer.available() < length + FIELD_VALUE_RESERVE) {
+        _full = true;
+        return;
+    }
+
+    if (!_first && _style != FieldStyle::FS_JOURNAL) {
+        _buffer.append(_style == FieldStyle::FS_JSON ? ',' : ' ');
+    }
+    _first = false;
+
+    if (_style == FieldStyle::FS_JSON) {
+        string(key, length);
+        _buffer.append(':');
+    } else if (_style == FieldStyle::FS_JOURNAL) {
+        // journald names are upper case letters, digits and underscores
+        for (size_t i = 0; i < length; ++i) {
+            auto c = static_cast<unsigned char>(key[i]);
+            _buffer.append(std::isalnum(c)
+                ? static_cast<char>(std::toupper(c)) : '_');
+        }
+    } else {
+        _buffer.append(key, length);
+        _buffer.append('=');
+    }
+}
+
+// value follows a journald name, the other styles wrote their separator
+void SsFieldWriter::open() {
+    if (_style == FieldStyle::FS_JOURNAL) {
+        _buffer.append('=');
+    }
+}
+
+// journald fields end with a newline
+void SsFieldWriter::close() {
+    if (_style == FieldStyle::FS_JOURNAL) {
+        _buffer.append('\n');
+    }
+}
+
+// JSON always quotes, logfmt only when the value needs it, quoted strings
+// are cut short rather than left open
+void SsFieldWriter::string(const char *data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+
+    if (_style == FieldStyle::FS_JOURNAL) {
+        journalString(data, size);
+        return;
+    }
+
+    auto quote = _style == FieldStyle::FS_JSON || size == 0;
+    for (size_t i = 0; i < size && !quote; ++i) {
+        auto c = static_cast<unsigned char>(data[i]);
+        quote = c <= ' ' || c == '=' || c == '"' || c == '\\' || c == 0x7f;
+    }
+
+    if (!quote) {
+        _buffer.append(data, size);
+        return;
+    }
+
+    _buffer.append('"');
+    auto run = data;
+    for (auto end = data + size; data != end; ++data) {
+        if (_buffer.available() <= static_cast<size_t>(data - run) +
+                                   FIELD_ESCAPE_RESERVE) {
+            break;
+        }
+
+        auto c = static_cast<unsigned char>(*data);
+        if (c >= ' ' && c != '"' && c != '\\' && c != 0x7f) {
+            continue;
+        }
+
+        // copy the plain run, then the escape
+        _buffer.append(run, data - run);
+        run = data + 1;
+
+        _buffer.append('\\');
+        switch (c) {
+            case '"':   _buffer.append('"');    break;
+            case '\\':  _buffer.append('\\');   break;
+            case '\n':  _buffer.append('n');    break;
+            case '\r':  _buffer.append('r');    break;
+            case '\t':  _buffer.append('t');    break;
+            default:
+                _buffer.append("u00", 3);
+                _buffer.append(digits[c >> 4]);
+                _buffer.append(digits[c & 0x0f]);
+                break;
+        }
+    }
+    _buffer.append(run, data - run);
+    _buffer.append('"');
+}
+
+// journald takes values as they are, one with a newline is sent as its
+// little endian 64 bit length and the raw bytes, cut to what fits
+void SsFieldWriter::journalString(const char *data, size_t size) {
+    if (std::memchr(data, '\n', size) == nullptr) {
+        _buffer.append('=');
+        _buffer.append(data, std::min(size, _buffer.available() - 1));
+        return;
+    }
+
+    uint64_t length = 0;
+    if (_buffer.available() > 1 + sizeof(length) + 1) {
+        length = std::min<uint64_t>(
+            size, _buffer.available() - 1 - sizeof(length) - 1);
+    }
+
+    char bytes[sizeof(length)];
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+        bytes[i] = static_cast<char>(length >> (8 * i));
+    }
+
+    _buffer.append('\n');
+    _buffer.append(bytes, sizeof(bytes));
+    _buffer.append(data, static_cast<size_t>(length));
+}
+
+// JSON has no literal for nan and infinity
+void SsFieldWriter::number(double value) {
+    open();
+    if (_style == FieldStyle::FS_JSON && !std::isfinite(value)) {
+        _buffer.append("null", 4);
+    } else {
+        _buffer.write(value, false);
+    }
+}
+
+// true or false, never 1 or 0
+void SsFieldWriter::value(bool value) {
+    open();
+    if (value) {
+        _buffer.append("true", 4);
+    } else {
+        _buffer.append("false", 5);
+    }
+}
+
+// null terminated string
+void SsFieldWriter::value(const char *value,
+                          KindTag<ArgumentKind::AK_STRING>) {
+    if (value == nullptr) {
+        string("(null)", 6);
+    } else {
+        string(value, std::strlen(value));
+    }
+}
+
+// std::string
+void SsFieldWriter::value(const std::string &value,
+                          KindTag<ArgumentKind::AK_STRING>) {
+    string(value.data(), value.size());
+}
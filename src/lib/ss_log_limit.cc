@@ -0,0 +1,56 @@
+#include "shadowsocks/ss_log_limit.h"
+
+
+#define LOG_LIMIT_NANOSECONDS           (1000000000.0)
+
+
+// monotonic nanoseconds
+static int64_t monotonicNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// SsLogLimit constructor, rate messages per second after a burst
+SsLogLimit::SsLogLimit(double rate, unsigned burst) :
+    _interval(static_cast<int64_t>(LOG_LIMIT_NANOSECONDS /
+                                   std::max(rate, 1e-9))),
+    _tolerance(_interval * (std::max(burst, 1u) - 1)) {
+}
+
+// take a token, suppressed is the number of messages denied since the last
+// one that got through
+bool SsLogLimit::acquire(uint64_t &suppressed) {
+    auto now = monotonicNow();
+    auto arrival = _arrival.load(std::memory_order_relaxed);
+
+    while (true) {
+        auto start = std::max(arrival, now);
+        if (start - now > _tolerance) {
+            _suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (_arrival.compare_exchange_weak(arrival, start + _interval,
+                                           std::memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+// SsLogSampler constructor
+SsLogSampler::SsLogSampler(uint64_t every) :
+    _every(std::max<uint64_t>(every, 1)) {
+}
+
+// first message and every n-th after it, the others are counted
+bool SsLogSampler::acquire(uint64_t &suppressed) {
+    auto count = _count.fetch_add(1, std::memory_order_relaxed);
+    if (count % _every != 0) {
+        return false;
+    }
+
+    suppressed = count == 0 ? 0 : _every - 1;
+    return true;
+}
@@ -0,0 +1,317 @@
+#include "shadowsocks/ss_log_record.h"
+#include "shadowsocks/ss_exception.h"
+
+
+#define LOG_RECORD_TIME_SIZE            (64)
+
+
+/* free text messages share one "%s" format */
+FORMAT_LITERAL(LogRecordText, "%s");
+
+
+// static members definition
+std::mutex SsLogRecord::_mutex;
+std::vector<const char*> SsLogRecord::_formats;
+std::atomic<uint32_t> SsLogRecord::_stream{0};
+
+
+// already formatted message as a "%s" record, no string is built
+void SsLogRecord::encodeText(SsFormatBuffer &buffer, uint8_t level,
+                             const char *text, size_t size) {
+    encodeHeader(buffer, formatId<LogRecordText>(), level);
+    encodeString(buffer, text, size);
+    buffer.append(static_cast<char>(ArgumentType::AT_END));
+}
+
+// format record for id, written once per stream before its messages
+void SsLogRecord::encodeFormat(std::string &out, uint32_t id) {
+    auto fmt = format(id);
+    auto length = static_cast<uint16_t>(
+        std::min<size_t>(std::strlen(fmt), UINT16_MAX));
+
+    out += static_cast<char>(RecordType::RT_FORMAT);
+    out.append(reinterpret_cast<const char*>(&id), sizeof(id));
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.append(fmt, length);
+}
+
+// records that follow belong to stream
+void SsLogRecord::encodeStream(std::string &out, uint32_t stream) {
+    out += static_cast<char>(RecordType::RT_STREAM);
+    out.append(reinterpret_cast<const char*>(&stream), sizeof(stream));
+}
+
+// process id of the caller, cached, a forked child looks it up again
+uint32_t SsLogRecord::stream() {
+    auto stream = _stream.load(std::memory_order_relaxed);
+    if (stream != 0) {
+        return stream;
+    }
+
+#if defined(__platform_windows__)
+    stream = static_cast<uint32_t>(::GetCurrentProcessId());
+#else
+    static const int forked = ::pthread_atfork(nullptr, nullptr, [] {
+        _stream.store(0, std::memory_order_relaxed);
+    });
+    (void) forked;
+    stream = static_cast<uint32_t>(::getpid());
+#endif
+    _stream.store(stream, std::memory_order_relaxed);
+    return stream;
+}
+
+// format id of an encoded message
+uint32_t SsLogRecord::messageFormat(const char *record) {
+    uint32_t id;
+    std::memcpy(&id, record + MESSAGE_ID_OFFSET, sizeof(id));
+    return id;
+}
+
+// literal format of id
+const char *SsLogRecord::format(uint32_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _formats[id];
+}
+
+// format of encodeText() records
+const char *SsLogRecord::textFormat() {
+    return LogRecordText::str();
+}
+
+// assign the next id to a literal format
+uint32_t SsLogRecord::registerFormat(const char *fmt) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _formats.push_back(fmt);
+    return static_cast<uint32_t>(_formats.size() - 1);
+}
+
+// record type, format id, level and wall clock in nanoseconds
+void SsLogRecord::encodeHeader(SsFormatBuffer &buffer, uint32_t id,
+                               uint8_t level) {
+    int64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    buffer.append(static_cast<char>(RecordType::RT_MESSAGE));
+    buffer.append(reinterpret_cast<const char*>(&id), sizeof(id));
+    buffer.append(static_cast<char>(level));
+    buffer.append(reinterpret_cast<const char*>(&timestamp),
+                  sizeof(timestamp));
+}
+
+// null terminated string
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer, const char *value,
+                                 bool hex, KindTag<ArgumentKind::AK_STRING>) {
+    if (value == nullptr) {
+        encodeString(buffer, "(null)", 6);
+    } else {
+        encodeString(buffer, value, std::strlen(value));
+    }
+}
+
+// std::string
+void SsLogRecord::encodeArgument(SsFormatBuffer &buffer,
+                                 const std::string &value, bool hex,
+                                 KindTag<ArgumentKind::AK_STRING>) {
+    encodeString(buffer, value.data(), value.size());
+}
+
+// fixed size value, dropped when it would not leave room for AT_END
+void SsLogRecord::encodeValue(SsFormatBuffer &buffer, ArgumentType type,
+                              const void *value, size_t size) {
+    if (buffer.available() < 1 + size + 1) {
+        return;
+    }
+
+    buffer.append(static_cast<char>(type));
+    buffer.append(static_cast<const char*>(value), size);
+}
+
+// length prefixed string, truncated to the space left
+void SsLogRecord::encodeString(SsFormatBuffer &buffer,
+                               const char *value, size_t size) {
+    uint16_t length;
+    if (buffer.available() < 1 + sizeof(length) + 1) {
+        return;
+    }
+
+    size = std::min(size, buffer.available() - 1 - sizeof(length) - 1);
+    length = static_cast<uint16_t>(std::min<size_t>(size, UINT16_MAX));
+
+    buffer.append(static_cast<char>(ArgumentType::AT_STRING));
+    buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    buffer.append(value, length);
+}
+
+// SsLogRecordReader constructor
+SsLogRecordReader::SsLogRecordReader(std::istream &in) : _input(in) {
+}
+
+// next message as text, format records are collected on the way
+bool SsLogRecordReader::next(std::string &line) {
+    for (;;) {
+        auto type = _input.get();
+        if (type == std::char_traits<char>::eof()) {
+            return false;
+        }
+
+        switch (static_cast<SsLogRecord::RecordType>(type)) {
+            case SsLogRecord::RecordType::RT_STREAM:
+                readStream();
+                break;
+            case SsLogRecord::RecordType::RT_FORMAT:
+                readFormat();
+                break;
+            case SsLogRecord::RecordType::RT_MESSAGE:
+                readMessage(line);
+                return true;
+            default:
+                throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+                    SsLogger::format("unknown record type %x at offset %d",
+                                     type,
+                                     static_cast<int64_t>(_input.tellg())));
+        }
+    }
+}
+
+// process the following records come from, streams without stream records
+// are stream 0
+void SsLogRecordReader::readStream() {
+    read(&_stream, sizeof(_stream));
+}
+
+// id and literal format, ids are only unique within a stream
+void SsLogRecordReader::readFormat() {
+    uint32_t id;
+    uint16_t length;
+    read(&id, sizeof(id));
+    read(&length, sizeof(length));
+
+    std::string fmt(length, '\0');
+    read(&fmt[0], length);
+    _formats[std::make_pair(_stream, id)] = std::move(fmt);
+}
+
+// header, arguments, then the format applied like SsLogger does
+void SsLogRecordReader::readMessage(std::string &line) {
+    uint32_t id;
+    uint8_t level;
+    int64_t timestamp;
+    read(&id, sizeof(id));
+    read(&level, sizeof(level));
+    read(&timestamp, sizeof(timestamp));
+
+    std::vector<Argument> arguments;
+    readArguments(arguments);
+
+    auto fmt = _formats.find(std::make_pair(_stream, id));
+    if (fmt == _formats.end()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("message of stream %d refers to unknown "
+                             "format %d", _stream, id));
+    }
+
+    // local wall clock with nanoseconds
+    time_t seconds = timestamp / 1000000000;
+    char date[LOG_RECORD_TIME_SIZE];
+    auto length = std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S",
+                                std::localtime(&seconds));
+
+    SsFormatBuffer buffer;
+    buffer.append(date, length);
+    length = std::snprintf(date, sizeof(date), ".%09d ",
+                           static_cast<int>(timestamp % 1000000000));
+    buffer.append(date, length);
+    buffer.write(SsLogger::levelName(
+        static_cast<SsLogger::LoggerLevel>(level)), false);
+    buffer.append(": ", 2);
+
+    auto text = fmt->second.c_str();
+    for (auto &argument : arguments) {
+        text = formatRuntimeNext(buffer, text);
+        if (*text == '\0') {
+            break;
+        }
+
+        auto hex = text[1] == 'x';
+        if (hex) {
+            buffer.append("0x", 2);
+        }
+        writeArgument(buffer, argument, hex);
+
+        text += 2;
+        while (formatAlnum(*text)) {
+            ++text;
+        }
+    }
+    formatRuntime(buffer, text);
+
+    line = buffer.str();
+}
+
+// typed values up to AT_END
+void SsLogRecordReader::readArguments(std::vector<Argument> &arguments) {
+    for (;;) {
+        Argument argument{};
+        read(&argument.type, sizeof(argument.type));
+
+        switch (argument.type) {
+            case ArgumentType::AT_END:
+                return;
+            case ArgumentType::AT_SIGNED:
+                read(&argument.signedValue, sizeof(argument.signedValue));
+                break;
+            case ArgumentType::AT_UNSIGNED:
+                read(&argument.unsignedValue, sizeof(argument.unsignedValue));
+                break;
+            case ArgumentType::AT_CHARACTER:
+                argument.stringValue.resize(1);
+                read(&argument.stringValue[0], 1);
+                break;
+            case ArgumentType::AT_FLOATING:
+                read(&argument.floatingValue, sizeof(argument.floatingValue));
+                break;
+            case ArgumentType::AT_STRING: {
+                uint16_t length;
+                read(&length, sizeof(length));
+                argument.stringValue.resize(length);
+                read(&argument.stringValue[0], length);
+                break;
+            }
+            default:
+                throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+                    SsLogger::format("unknown argument type %x",
+                                     static_cast<int>(argument.type)));
+        }
+
+        arguments.push_back(std::move(argument));
+    }
+}
+
+// exactly size bytes or the stream is truncated
+void SsLogRecordReader::read(void *data, size_t size) {
+    _input.read(static_cast<char*>(data), size);
+    if (static_cast<size_t>(_input.gcount()) != size) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+                          "binary log truncated in the middle of a record");
+    }
+}
+
+// decoded value with the writer SsLogger uses for text
+void SsLogRecordReader::writeArgument(SsFormatBuffer &buffer,
+                                      const Argument &argument, bool hex) {
+    switch (argument.type) {
+        case ArgumentType::AT_SIGNED:
+            buffer.write(argument.signedValue, hex);
+            break;
+        case ArgumentType::AT_UNSIGNED:
+            buffer.write(argument.unsignedValue, hex);
+            break;
+        case ArgumentType::AT_FLOATING:
+            buffer.write(argument.floatingValue, hex);
+            break;
+        default:
+            buffer.write(argument.stringValue, hex);
+            break;
+    }
+}
@@ -0,0 +1,83 @@
+#include "shadowsocks/ss_log_ring.h"
+
+
+// SsLogRing constructor, capacity rounded up to a power of two
+SsLogRing::SsLogRing(size_t capacity) : _capacity(sizeof(Header) * 4) {
+    while (_capacity < capacity) {
+        _capacity <<= 1;
+    }
+    _data.reset(new char[_capacity]);
+}
+
+// copy one record in, false when there is not enough free space
+bool SsLogRing::push(uint8_t level, uint8_t encoding, time_t time,
+                     const char *message, size_t size) {
+    // a record never takes more than a quarter of the ring
+    size = std::min(size, _capacity / 4 - sizeof(Header));
+
+    auto tail = _tail.load(std::memory_order_relaxed);
+    auto head = _head.load(std::memory_order_acquire);
+
+    // records are contiguous, the end of the ring is skipped when too short
+    auto need = recordSize(size);
+    auto offset = tail & (_capacity - 1);
+    auto contiguous = _capacity - offset;
+    auto skip = contiguous < need ? contiguous : 0;
+    if (skip + need > _capacity - (tail - head)) {
+        return false;
+    }
+
+    if (skip != 0) {
+        if (skip >= sizeof(Header)) {
+            Header header{RECORD_SKIP, 0, 0, 0};
+            std::memcpy(_data.get() + offset, &header, sizeof(Header));
+        }
+        tail += skip;
+        offset = 0;
+    }
+
+    Header header{static_cast<uint32_t>(size), level, encoding,
+                  static_cast<int64_t>(time)};
+    std::memcpy(_data.get() + offset, &header, sizeof(Header));
+    std::memcpy(_data.get() + offset + sizeof(Header), message, size);
+
+    _tail.store(tail + need, std::memory_order_release);
+    return true;
+}
+
+// ring size in bytes
+size_t SsLogRing::capacity() const {
+    return _capacity;
+}
+
+// bytes waiting for the writer
+size_t SsLogRing::used() const {
+    return _tail.load(std::memory_order_relaxed) -
+           _head.load(std::memory_order_relaxed);
+}
+
+// count a record that did not fit
+void SsLogRing::drop() {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// records dropped since the ring was created
+uint64_t SsLogRing::dropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+// producer thread is gone, ring is released once drained
+void SsLogRing::close() {
+    _closed.store(true, std::memory_order_release);
+}
+
+// producer thread is gone
+bool SsLogRing::closed() const {
+    return _closed.load(std::memory_order_acquire);
+}
+
+// header and message, aligned for the next header
+size_t SsLogRing::recordSize(size_t size) {
+    auto align = alignof(Header);
+    return (sizeof(Header) + size + align - 1) & ~(align - 1);
+}
@@ -2,15 +2,65 @@
 
 
 #define LOGGER_TIME_INFO_SIZE               (128)
+#define LOGGER_SECONDS_PER_DAY              (86400)
+#define LOGGER_OFFSET_PERIOD                (900)
+#define LOGGER_TEXT_DATE_FORMAT             "%A %b %d %H:%M:%S %Y \t->\t "
+#define LOGGER_ISO_DATE_FORMAT              "%Y-%m-%dT%H:%M:%S%z"
 
 
-// static members definition
-std::map<SsLogger::LoggerName, SsLogger::SsLoggerPtr> SsLogger::_loggers{};
+// static members definition, mutex outlives the loggers
+std::mutex SsLogger::_mutex;
+SsRcu<SsLogger::LoggerMap> SsLogger::_loggers;
+std::atomic<uint8_t> SsLogger::_threshold{
+    static_cast<uint8_t>(SsLogger::LoggerLevel::LL_EMERGENCY)};
+std::atomic<uint8_t> SsLogger::_thresholds[LOGGER_ENCODINGS] = {
+    {static_cast<uint8_t>(SsLogger::LoggerLevel::LL_EMERGENCY)},
+    {static_cast<uint8_t>(SsLogger::LoggerLevel::LL_EMERGENCY)},
+    {static_cast<uint8_t>(SsLogger::LoggerLevel::LL_EMERGENCY)},
+    {static_cast<uint8_t>(SsLogger::LoggerLevel::LL_EMERGENCY)},
+    {static_cast<uint8_t>(SsLogger::LoggerLevel::LL_EMERGENCY)}};
+std::atomic<bool> SsLogger::_async{false};
+std::atomic<SsLogger::AsyncPolicy> SsLogger::_policy{
+    SsLogger::AsyncPolicy::AP_DROP_ON_FULL};
+std::atomic<bool> SsLogger::_pending{false};
+size_t SsLogger::_ringSize = LOG_RING_SIZE;
+bool SsLogger::_stopping = false;
+uint64_t SsLogger::_reportedDrops = 0;
+uint64_t SsLogger::_retiredDrops = 0;
+std::vector<std::shared_ptr<SsLogRing>> SsLogger::_rings;
+std::condition_variable SsLogger::_wakeup;
+std::thread SsLogger::_writer;
+
+
+/* ring of the calling thread, closed when the thread exits */
+struct SsLoggerThreadRing {
+    std::shared_ptr<SsLogRing> ring;
+    ~SsLoggerThreadRing();
+};
+
+static thread_local bool threadRetired = false;
+static thread_local SsLoggerThreadRing threadRingHolder;
+
+// writer drains what is left and releases the ring
+SsLoggerThreadRing::~SsLoggerThreadRing() {
+    if (ring) {
+        ring->close();
+    }
+    threadRetired = true;
+}
+
+/* writer thread is joined before the static members are destroyed */
+static struct SsLoggerAsyncGuard {
+    ~SsLoggerAsyncGuard() {
+        SsLogger::disableAsync();
+    }
+} loggerAsyncGuard;
 
 
 // SsLogger constructor
-SsLogger::SsLogger(std::ostream &out) : _output(out) {
-    // empty constructor
+SsLogger::SsLogger(std::ostream &out) :
+    _output(out), _dateFormat(LOGGER_TEXT_DATE_FORMAT) {
+    _batch.reserve(LOGGER_BATCH_SIZE);
 }
 
 // SsLogger destructor
@@ -21,22 +71,43 @@ SsLogger::~SsLogger() {
 // add logger to global
 void SsLogger::addLogger(SsLogger::LoggerName name, SsLoggerPtr logger) {
     logger->setName(name);
-    _loggers[name] = std::move(logger);
+
+    // a replaced logger is destroyed last, it logs on close
+    SsLoggerPtr replaced;
+    _loggers.update([&] (LoggerMap &loggers) {
+        replaced = std::move(loggers[name]);
+        loggers[name] = std::move(logger);
+    });
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    updateThreshold();
 }
 
 // remove logger by name
 bool SsLogger::removeLogger(SsLogger::LoggerName name) {
-    if (_loggers.find(name) == _loggers.end()) {
-        return false;
+    SsLoggerPtr removed;
+    _loggers.update([&] (LoggerMap &loggers) {
+        auto it = loggers.find(name);
+        if (it != loggers.end()) {
+            removed = std::move(it->second);
+            loggers.erase(it);
+        }
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        updateThreshold();
     }
 
-    _loggers.erase(name);
-    return true;
+    return removed != nullptr;
 }
 
 // set level of logger
 void SsLogger::setLevel(LoggerLevel level) {
-    _level = level;
+    _level.store(level, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    updateThreshold();
 }
 
 // named logger
@@ -44,33 +115,633 @@ void SsLogger::setName(SsLogger::LoggerName name) {
     _name = name;
 }
 
-// do output message when level correct
-void SsLogger::log(LoggerLevel level, std::string message) {
-    if (_loggers.empty()) {
+// text lines, binary records or one logfmt/JSON object per line, binary
+// output needs a binary stream, structured lines carry ISO 8601 dates
+void SsLogger::setEncoding(LoggerEncoding encoding) {
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _encoding.store(encoding, std::memory_order_relaxed);
+        _dateFormat = encoding == LoggerEncoding::LE_LOGFMT ||
+                      encoding == LoggerEncoding::LE_JSON
+            ? LOGGER_ISO_DATE_FORMAT : LOGGER_TEXT_DATE_FORMAT;
+        _date.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    updateThreshold();
+}
+
+// start the writer thread, records are queued in per thread rings
+void SsLogger::enableAsync(AsyncPolicy policy, size_t ringSize) {
+    disableAsync();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.store(policy, std::memory_order_relaxed);
+    _ringSize = ringSize;
+    _stopping = false;
+    _writer = std::thread(&SsLogger::asyncWriter);
+    _async.store(true, std::memory_order_release);
+}
+
+// drain every ring and stop the writer thread, logging is synchronous again
+void SsLogger::disableAsync() {
+    if (!_async.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _wakeup.notify_one();
+    _writer.join();
+
+    // records pushed while the writer was stopping
+    std::lock_guard<std::mutex> lock(_mutex);
+    drainRings();
+}
+
+// records are queued for the writer thread
+bool SsLogger::asyncEnabled() {
+    return _async.load(std::memory_order_acquire);
+}
+
+// stop the writer thread before fork, a child would inherit async mode
+// without the thread, true when there was one to resume
+bool SsLogger::suspendAsync() {
+    auto async = asyncEnabled();
+    disableAsync();
+    return async;
+}
+
+// writer thread again, with the policy and ring size it had
+void SsLogger::resumeAsync() {
+    AsyncPolicy policy;
+    size_t ringSize;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        policy = _policy.load(std::memory_order_relaxed);
+        ringSize = _ringSize;
+    }
+
+    enableAsync(policy, ringSize);
+}
+
+// records dropped on full rings
+uint64_t SsLogger::dropped() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto dropped = _retiredDrops;
+    for (auto &ring : _rings) {
+        dropped += ring->dropped();
+    }
+    return dropped;
+}
+
+// keep recent records in memory, dumped to path on emergency, fatal signals
+// or request, level may be below every logger
+void SsLogger::enableFlightRecorder(LoggerLevel level,
+                                    const std::string &path) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    SsFlightRecorder::enable(static_cast<uint8_t>(level), path);
+    updateThreshold();
+}
+
+// stop recording
+void SsLogger::disableFlightRecorder() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    SsFlightRecorder::disable();
+    updateThreshold();
+}
+
+// append recorded messages to the recorder file, async signal safe
+bool SsLogger::dumpFlightRecorder() {
+    return SsFlightRecorder::dump();
+}
+
+// recorded messages are dumped before the process goes
+void SsLogger::emergencyExit() {
+    SsFlightRecorder::dump();
+    std::exit(OPERATOR_FAILURE);
+}
+
+// do output message when level correct, binary loggers get it as "%s"
+void SsLogger::log(LoggerLevel level, const char *message, size_t size) {
+    if (SsFlightRecorder::enabled(static_cast<uint8_t>(level))) {
+        SsFlightRecorder::record(static_cast<uint8_t>(level), message, size);
+    }
+
+    if (enabled(level, LoggerEncoding::LE_BINARY)) {
+        SsFormatBuffer record;
+        SsLogRecord::encodeText(record, static_cast<uint8_t>(level),
+                                message, size);
+        write(level, LoggerEncoding::LE_BINARY, record.data(), record.size());
+    }
+
+    if (enabledMessage(level)) {
+        writeMessage(level, message, size);
+    }
+}
+
+// free text message to every text based encoding accepting level
+void SsLogger::writeMessage(LoggerLevel level,
+                            const char *message, size_t size) {
+    if (enabled(level, LoggerEncoding::LE_TEXT)) {
+        write(level, LoggerEncoding::LE_TEXT, message, size);
+    }
+
+    for (auto encoding : {LoggerEncoding::LE_LOGFMT, LoggerEncoding::LE_JSON,
+                          LoggerEncoding::LE_JOURNAL}) {
+        if (enabled(level, encoding)) {
+            SsFormatBuffer payload;
+            messagePayload(encoding, payload, message, size);
+            write(level, encoding, payload.data(), payload.size());
+        }
+    }
+}
+
+// free text message as it is queued for encoding, structured loggers get
+// it escaped as the msg field
+void SsLogger::messagePayload(LoggerEncoding encoding, SsFormatBuffer &payload,
+                              const char *message, size_t size) {
+    if (encoding == LoggerEncoding::LE_TEXT) {
+        payload.append(message, size);
+        return;
+    }
+
+    SsFieldWriter writer(payload, fieldStyle(encoding));
+    writer.message(message, size);
+}
+
+// field syntax of a structured encoding
+SsFieldWriter::FieldStyle SsLogger::fieldStyle(LoggerEncoding encoding) {
+    switch (encoding) {
+        case LoggerEncoding::LE_JSON:
+            return SsFieldWriter::FieldStyle::FS_JSON;
+        case LoggerEncoding::LE_JOURNAL:
+            return SsFieldWriter::FieldStyle::FS_JOURNAL;
+        default:
+            return SsFieldWriter::FieldStyle::FS_LOGFMT;
+    }
+}
+
+// queue message in async mode, otherwise output it now
+void SsLogger::write(LoggerLevel level, LoggerEncoding encoding,
+                     const char *message, size_t size) {
+    auto time = std::time(nullptr);
+
+    // emergency exits right after, everything queued goes out first
+    if (level == LoggerLevel::LL_EMERGENCY) {
+        disableAsync();
+    }
+
+    if (!_async.load(std::memory_order_acquire) ||
+            !writeAsync(level, encoding, time, message, size)) {
+        writeSync(level, encoding, time, message, size);
+    }
+}
+
+// output message to every logger accepting level, flushed right away,
+// callers only contend on the loggers they write to
+void SsLogger::writeSync(LoggerLevel level, LoggerEncoding encoding,
+                         time_t time, const char *message, size_t size) {
+    SsRcu<LoggerMap>::Reader loggers(_loggers);
+    if (loggers.get() == nullptr) {
+        return;
+    }
+
+    for (auto &pair : *loggers) {
+        auto &logger = pair.second;
+        if (!logger->accepts(level, encoding)) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(logger->_lock);
+        if (encoding == LoggerEncoding::LE_BINARY) {
+            logger->appendRecord(message, size);
+        } else {
+            logger->append(level, time, message, size);
+        }
+        logger->flush();
+    }
+}
+
+// push into the thread ring, false when the caller has to write itself
+bool SsLogger::writeAsync(LoggerLevel level, LoggerEncoding encoding,
+                          time_t time, const char *message, size_t size) {
+    auto ring = threadRing();
+    if (ring == nullptr) {
+        return false;
+    }
+
+    while (!ring->push(static_cast<uint8_t>(level),
+                       static_cast<uint8_t>(encoding), time, message, size)) {
+        if (_policy.load(std::memory_order_relaxed) ==
+                AsyncPolicy::AP_DROP_ON_FULL) {
+            ring->drop();
+            return true;
+        }
+
+        // block on full, until the writer made room or async mode ended
+        if (!_async.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _pending.store(true, std::memory_order_relaxed);
+        _wakeup.notify_one();
+        std::this_thread::yield();
+    }
+
+    // wake the writer early when the ring fills up
+    if (ring->used() > ring->capacity() / 2) {
+        _pending.store(true, std::memory_order_relaxed);
+        _wakeup.notify_one();
+    }
+    return true;
+}
+
+// ring of the calling thread, registered with the writer on first use
+SsLogRing *SsLogger::threadRing() {
+    if (threadRetired) {
+        return nullptr;
+    }
+
+    if (!threadRingHolder.ring) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // a ring always holds a few full sized messages
+        threadRingHolder.ring = std::make_shared<SsLogRing>(
+            std::max<size_t>(_ringSize, LOGGER_RING_MIN_SIZE));
+        _rings.push_back(threadRingHolder.ring);
+    }
+    return threadRingHolder.ring.get();
+}
+
+// writer thread, wakes up on interval or when a ring is half full
+void SsLogger::asyncWriter() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        _wakeup.wait_for(lock,
+                         std::chrono::milliseconds(LOGGER_ASYNC_INTERVAL),
+                         [] () {
+                             return _stopping ||
+                                 _pending.load(std::memory_order_relaxed);
+                         });
+        _pending.store(false, std::memory_order_relaxed);
+
+        drainRings();
+    }
+}
+
+// move every queued record into logger batches, one write per logger
+void SsLogger::drainRings() {
+    auto dropped = _retiredDrops;
+    for (auto &ring : _rings) {
+        ring->drain([] (uint8_t level, uint8_t encoding, time_t time,
+                        const char *message, size_t size) {
+            deliver(static_cast<LoggerLevel>(level),
+                    static_cast<LoggerEncoding>(encoding),
+                    time, message, size);
+        });
+        dropped += ring->dropped();
+    }
+
+    if (dropped > _reportedDrops) {
+        FORMAT_LITERAL(DroppedFormat, "%d log messages dropped");
+        auto level = LoggerLevel::LL_WARNING;
+        auto count = dropped - _reportedDrops;
+        _reportedDrops = dropped;
+
+        SsFormatBuffer record;
+        SsLogRecord::encode<DroppedFormat>(record, static_cast<uint8_t>(level),
+                                           count);
+        deliver(level, LoggerEncoding::LE_BINARY, std::time(nullptr),
+                record.data(), record.size());
+
+        SsFormatBuffer buffer;
+        SsFormat<DroppedFormat>::write(buffer, count);
+        for (auto encoding : {LoggerEncoding::LE_TEXT,
+                              LoggerEncoding::LE_LOGFMT,
+                              LoggerEncoding::LE_JSON,
+                              LoggerEncoding::LE_JOURNAL}) {
+            SsFormatBuffer payload;
+            messagePayload(encoding, payload, buffer.data(), buffer.size());
+            deliver(level, encoding, std::time(nullptr),
+                    payload.data(), payload.size());
+        }
+    }
+
+    SsRcu<LoggerMap>::Reader loggers(_loggers);
+    if (loggers.get() != nullptr) {
+        for (auto &pair : *loggers) {
+            std::lock_guard<std::mutex> lock(pair.second->_lock);
+            pair.second->flush();
+        }
+    }
+
+    // rings of exited threads, their drop counters are kept
+    _rings.erase(std::remove_if(_rings.begin(), _rings.end(),
+                     [&] (const std::shared_ptr<SsLogRing> &ring) {
+                         if (ring->closed() && ring->used() == 0) {
+                             _retiredDrops += ring->dropped();
+                             return true;
+                         }
+                         return false;
+                     }),
+                 _rings.end());
+}
+
+// message into the batch of every logger with encoding accepting level
+void SsLogger::deliver(LoggerLevel level, LoggerEncoding encoding,
+                       time_t time, const char *message, size_t size) {
+    SsRcu<LoggerMap>::Reader loggers(_loggers);
+    if (loggers.get() == nullptr) {
         return;
     }
 
-    for (auto &pair : _loggers) {
+    for (auto &pair : *loggers) {
         auto &logger = pair.second;
-        if (level >= logger->_level) {
-            logger->_output
-                << level << ": "
-                << currentDate(logger->_dateFormat.c_str())
-                << message
-                << std::endl;
+        if (!logger->accepts(level, encoding)) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(logger->_lock);
+        if (encoding == LoggerEncoding::LE_BINARY) {
+            logger->appendRecord(message, size);
+        } else {
+            logger->append(level, time, message, size);
         }
     }
 }
 
-// format current time
-std::string SsLogger::currentDate(SsLogger::Format fmt) {
-    time_t rawTime;
-    std::time(&rawTime);
+// lowest level any registered logger accepts, per encoding and overall,
+// the flight recorder counts for the overall one
+void SsLogger::updateThreshold() {
+    LoggerLevel thresholds[LOGGER_ENCODINGS];
+    std::fill(std::begin(thresholds), std::end(thresholds),
+              LoggerLevel::LL_EMERGENCY);
+    SsRcu<LoggerMap>::Reader loggers(_loggers);
+    if (loggers.get() != nullptr) {
+        for (auto &pair : *loggers) {
+            auto encoding = pair.second->_encoding.load(
+                std::memory_order_relaxed);
+            auto &threshold = thresholds[static_cast<size_t>(encoding)];
+            threshold = std::min(threshold, pair.second->_level.load(
+                std::memory_order_relaxed));
+        }
+    }
+
+    auto lowest = LoggerLevel::LL_EMERGENCY;
+    for (size_t i = 0; i < LOGGER_ENCODINGS; ++i) {
+        _thresholds[i].store(static_cast<uint8_t>(thresholds[i]),
+                             std::memory_order_relaxed);
+        lowest = std::min(lowest, thresholds[i]);
+    }
+    _threshold.store(std::min(static_cast<uint8_t>(lowest),
+                              SsFlightRecorder::level()),
+                     std::memory_order_relaxed);
+}
+
+// logger takes messages of this encoding and level
+bool SsLogger::accepts(LoggerLevel level, LoggerEncoding encoding) const {
+    return _encoding.load(std::memory_order_relaxed) == encoding &&
+           level >= _level.load(std::memory_order_relaxed);
+}
+
+// one line into the batch, structured payloads are already escaped
+void SsLogger::append(LoggerLevel level, time_t time,
+                      const char *message, size_t size) {
+    switch (_encoding.load(std::memory_order_relaxed)) {
+        case LoggerEncoding::LE_LOGFMT:
+            _batch += "time=";
+            _batch += currentDate(time);
+            _batch += " level=";
+            _batch += levelName(level);
+            _batch += ' ';
+            _batch.append(message, size);
+            _batch += '\n';
+            break;
+        case LoggerEncoding::LE_JSON:
+            _batch += "{\"time\":\"";
+            _batch += currentDate(time);
+            _batch += "\",\"level\":\"";
+            _batch += levelName(level);
+            _batch += '"';
+            if (size != 0) {
+                _batch += ',';
+                _batch.append(message, size);
+            }
+            _batch += "}\n";
+            break;
+        case LoggerEncoding::LE_JOURNAL:
+            // journal export format, entries end with an empty line
+            _batch += "PRIORITY=";
+            _batch += static_cast<char>('0' + syslogPriority(level));
+            _batch += '\n';
+            _batch.append(message, size);
+            _batch += '\n';
+            break;
+        default:
+            _batch += levelName(level);
+            _batch += ": ";
+            _batch += currentDate(time);
+            _batch.append(message, size);
+            _batch += '\n';
+            break;
+    }
+
+    if (_batch.size() >= LOGGER_BATCH_SIZE) {
+        writeBatch();
+    }
+}
+
+// bytes of a record built by a subclass
+void SsLogger::appendBatch(const char *data, size_t size) {
+    _batch.append(data, size);
 
-    static auto buffer = new char[LOGGER_TIME_INFO_SIZE];
-    std::strftime(buffer, LOGGER_TIME_INFO_SIZE, fmt, std::localtime(&rawTime));
+    if (_batch.size() >= LOGGER_BATCH_SIZE) {
+        writeBatch();
+    }
+}
+
+// syslog severity, emergency exits the process, for syslog that is critical
+int SsLogger::syslogPriority(LoggerLevel level) {
+    switch (level) {
+        case LoggerLevel::LL_VERBOSE:   return 7;
+        case LoggerLevel::LL_DEBUG:     return 7;
+        case LoggerLevel::LL_INFO:      return 6;
+        case LoggerLevel::LL_WARNING:   return 4;
+        case LoggerLevel::LL_ERROR:     return 3;
+        case LoggerLevel::LL_EMERGENCY: return 2;
+    }
 
-    return buffer;
+    return 5;
+}
+
+// one binary record into the batch, preceded by its format on first use,
+// every batch starts with the process it comes from, a forked child
+// writes its formats again under its own stream
+void SsLogger::appendRecord(const char *record, size_t size) {
+    auto stream = SsLogRecord::stream();
+    if (stream != _stream) {
+        _stream = stream;
+        _formats.assign(_formats.size(), false);
+    }
+    if (_batch.empty()) {
+        SsLogRecord::encodeStream(_batch, stream);
+    }
+
+    auto id = SsLogRecord::messageFormat(record);
+    if (id >= _formats.size()) {
+        _formats.resize(id + 1, false);
+    }
+    if (!_formats[id]) {
+        SsLogRecord::encodeFormat(_batch, id);
+        _formats[id] = true;
+    }
+
+    _batch.append(record, size);
+
+    if (_batch.size() >= LOGGER_BATCH_SIZE) {
+        writeBatch();
+    }
+}
+
+// every format written so far, for a stream that starts over, e.g. a
+// rotated file, called with _lock held
+void SsLogger::encodeFormats(std::string &out) const {
+    if (std::find(_formats.begin(), _formats.end(), true) == _formats.end()) {
+        return;
+    }
+
+    SsLogRecord::encodeStream(out, _stream);
+    for (size_t id = 0; id < _formats.size(); ++id) {
+        if (_formats[id]) {
+            SsLogRecord::encodeFormat(out, static_cast<uint32_t>(id));
+        }
+    }
+}
+
+// write the batch with a single call
+void SsLogger::writeBatch() {
+    if (!_batch.empty()) {
+        _output.write(_batch.data(), _batch.size());
+        _batch.clear();
+    }
+}
+
+// the stream is flushed even without a batch, so buffering streams can
+// write out on their own schedule
+void SsLogger::flush() {
+    writeBatch();
+    _output.flush();
+}
+
+// formatted date, strftime runs once per second per logger
+const std::string &SsLogger::currentDate(time_t time) {
+    if (time != _dateTime || _date.empty()) {
+        std::tm local;
+        localTime(time, local);
+
+        char buffer[LOGGER_TIME_INFO_SIZE];
+        auto length = std::strftime(buffer, sizeof(buffer),
+                                    _dateFormat.c_str(), &local);
+        _date.assign(buffer, length);
+        _dateTime = time;
+    }
+
+    return _date;
+}
+
+// days since 1970-01-01 of a proleptic gregorian date
+static int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    auto era = (year >= 0 ? year : year - 399) / 400;
+    auto yearOfEra = static_cast<unsigned>(year - era * 400);
+    auto dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 +
+                     day - 1;
+    auto dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 +
+                    dayOfYear;
+
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+// utc offset of local time at time, from the cache localTime() keeps,
+// called with _lock held
+time_t SsLogger::utcOffset(time_t time) {
+    std::tm local;
+    localTime(time, local);
+    return _utcOffset;
+}
+
+// local time by arithmetic, the timezone is consulted every quarter hour
+void SsLogger::localTime(time_t time, std::tm &local) {
+    if (time < _offsetBegin || time >= _offsetEnd) {
+#if defined(__platform_windows__)
+        localtime_s(&local, &time);
+#else
+        localtime_r(&time, &local);
+#endif
+        auto days = daysFromCivil(local.tm_year + 1900, local.tm_mon + 1,
+                                  local.tm_mday);
+        _utcOffset = static_cast<time_t>(
+            days * LOGGER_SECONDS_PER_DAY + local.tm_hour * 3600 +
+            local.tm_min * 60 + local.tm_sec) - time;
+
+        // offsets only change on quarter hour boundaries
+        _offsetDst = local.tm_isdst;
+        _offsetBegin = time - time % LOGGER_OFFSET_PERIOD;
+        _offsetEnd = _offsetBegin + LOGGER_OFFSET_PERIOD;
+        return;
+    }
+
+    local = std::tm{};
+    local.tm_isdst = _offsetDst;
+#if !defined(__platform_windows__)
+    local.tm_gmtoff = static_cast<long>(_utcOffset);
+#endif
+
+    // civil date from days, see daysFromCivil
+    auto seconds = static_cast<int64_t>(time + _utcOffset);
+    auto days = seconds / LOGGER_SECONDS_PER_DAY;
+    auto rest = seconds % LOGGER_SECONDS_PER_DAY;
+    if (rest < 0) {
+        rest += LOGGER_SECONDS_PER_DAY;
+        --days;
+    }
+
+    auto shifted = days + 719468;
+    auto era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    auto dayOfEra = static_cast<unsigned>(shifted - era * 146097);
+    auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 -
+                      dayOfEra / 146096) / 365;
+    auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 -
+                                 yearOfEra / 100);
+    auto monthIndex = (5 * dayOfYear + 2) / 153;
+    auto day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    auto month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    auto year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+
+    local.tm_year = static_cast<int>(year - 1900);
+    local.tm_mon = static_cast<int>(month - 1);
+    local.tm_mday = static_cast<int>(day);
+    local.tm_hour = static_cast<int>(rest / 3600);
+    local.tm_min = static_cast<int>(rest % 3600 / 60);
+    local.tm_sec = static_cast<int>(rest % 60);
+    local.tm_wday = static_cast<int>(((days % 7) + 11) % 7);
+    local.tm_yday = static_cast<int>(days - daysFromCivil(year, 1, 1));
+}
+
+// level text
+const char *SsLogger::levelName(LoggerLevel level) {
+    switch (level) {
+        case LoggerLevel::LL_VERBOSE:   return "VERBOSE";
+        case LoggerLevel::LL_DEBUG:     return "DEBUG";
+        case LoggerLevel::LL_INFO:      return "INFO";
+        case LoggerLevel::LL_WARNING:   return "WARNING";
+        case LoggerLevel::LL_ERROR:     return "ERROR";
+        case LoggerLevel::LL_EMERGENCY: return "EMERGENCY";
+    }
+
+    return "UNKNOWN";
 }
 
 // output logger
@@ -84,24 +755,5 @@ std::ostream &operator<<(std::ostream &out, SsLogger *logger) {
 
 // output level text
 std::ostream &operator<<(std::ostream &out, const SsLogger::LoggerLevel &level) {
-    switch (level) {
-        case SsLogger::LoggerLevel::LL_VERBOSE:     out << "VERBOSE";   break;
-        case SsLogger::LoggerLevel::LL_DEBUG:       out << "DEBUG";     break;
-        case SsLogger::LoggerLevel::LL_INFO:        out << "INFO";      break;
-        case SsLogger::LoggerLevel::LL_WARNING:     out << "WARNING";   break;
-        case SsLogger::LoggerLevel::LL_ERROR:       out << "ERROR";     break;
-        case SsLogger::LoggerLevel::LL_EMERGENCY:   out << "EMERGENCY"; break;
-    }
-
-    return out;
-}
-
-// TupleElementPrinter constructor
-TupleElementPrinter::TupleElementPrinter(std::ostream &out) :
-    _output(out), _defaultFlags(_output.flags()) {
-}
-
-// temporarily set a flags to stream
-void TupleElementPrinter::setFlag(std::ios::fmtflags flags) {
-    _defaultFlags = _output.setf(flags, std::ios::basefield);
+    return out << SsLogger::levelName(level);
 }
@@ -0,0 +1,117 @@
+#include "shadowsocks/ss_rcu.h"
+
+
+// static members definition, epochs start at one, zero means not reading
+std::atomic<uint64_t> SsRcuDomain::_epoch{1};
+SsRcuDomain::Slot SsRcuDomain::_slots[RCU_READER_SLOTS];
+std::atomic<uint64_t> SsRcuDomain::_overflow[2];
+std::mutex SsRcuDomain::_mutex;
+
+
+/* read state of the calling thread, the slot is released when it exits */
+struct SsRcuThreadState {
+    bool claimed = false;
+    SsRcuDomain::Slot *slot = nullptr;
+    unsigned depth = 0;
+    size_t overflow = 0;
+    ~SsRcuThreadState();
+};
+
+static thread_local SsRcuThreadState rcuThreadState;
+
+
+// enter a read section, nested sections keep the outermost epoch
+void SsRcuDomain::readLock() {
+    auto &state = rcuThreadState;
+    if (state.depth++ != 0) {
+        return;
+    }
+
+    auto slot = threadSlot();
+    if (slot != nullptr) {
+        slot->epoch.store(_epoch.load(std::memory_order_seq_cst),
+                          std::memory_order_seq_cst);
+        return;
+    }
+
+    // the counter only protects us if the epoch did not move before it was
+    // raised, otherwise a later synchronize waits on the other parity
+    for (;;) {
+        auto epoch = _epoch.load(std::memory_order_seq_cst);
+        state.overflow = epoch % 2;
+        _overflow[state.overflow].fetch_add(1, std::memory_order_seq_cst);
+        if (_epoch.load(std::memory_order_seq_cst) == epoch) {
+            break;
+        }
+        _overflow[state.overflow].fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+// leave a read section
+void SsRcuDomain::readUnlock() {
+    auto &state = rcuThreadState;
+    if (--state.depth != 0) {
+        return;
+    }
+
+    if (state.slot != nullptr) {
+        state.slot->epoch.store(0, std::memory_order_release);
+    } else {
+        _overflow[state.overflow].fetch_sub(1, std::memory_order_release);
+    }
+}
+
+// wait until every read section entered before the call has left, must not
+// be called from inside a read section
+void SsRcuDomain::synchronize() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto epoch = _epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    for (auto &slot : _slots) {
+        while (true) {
+            auto entered = slot.epoch.load(std::memory_order_seq_cst);
+            if (entered == 0 || entered >= epoch) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // overflow readers of the previous parity counted down to zero
+    auto &previous = _overflow[(epoch - 1) % 2];
+    while (previous.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+}
+
+// slot of the calling thread, claimed on first use, none when all are taken
+SsRcuDomain::Slot *SsRcuDomain::threadSlot() {
+    auto &state = rcuThreadState;
+    if (state.claimed) {
+        return state.slot;
+    }
+
+    state.claimed = true;
+    for (auto &slot : _slots) {
+        auto owned = false;
+        if (slot.owned.compare_exchange_strong(owned, true,
+                                               std::memory_order_acquire)) {
+            state.slot = &slot;
+            break;
+        }
+    }
+    return state.slot;
+}
+
+// slot is free for the next thread
+void SsRcuDomain::releaseSlot(Slot *slot) {
+    slot->owned.store(false, std::memory_order_release);
+}
+
+// thread exits, later sections of this thread use the shared counters
+SsRcuThreadState::~SsRcuThreadState() {
+    if (slot != nullptr) {
+        SsRcuDomain::releaseSlot(slot);
+        slot = nullptr;
+    }
+}
@@ -0,0 +1,91 @@
+#include "shadowsocks/ss_result.h"
+#include "shadowsocks/ss_exception.h"
+
+
+// code of a system error, failures of one connection get their own codes
+SsError SsError::fromSystem(int system) {
+    switch (system) {
+#if defined(__platform_linux__)
+        case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+        case EINPROGRESS:
+            return SsError(ErrorCode::EC_WOULD_BLOCK, system);
+        case EINTR:
+            return SsError(ErrorCode::EC_INTERRUPTED, system);
+        case ECONNRESET:
+        case ECONNABORTED:
+        case EPIPE:
+            return SsError(ErrorCode::EC_RESET, system);
+        case ETIMEDOUT:
+            return SsError(ErrorCode::EC_TIMEOUT, system);
+        case ECONNREFUSED:
+        case EHOSTUNREACH:
+        case ENETUNREACH:
+            return SsError(ErrorCode::EC_REFUSED, system);
+#elif defined(__platform_windows__)
+        case WSAEWOULDBLOCK:
+        case WSAEINPROGRESS:
+            return SsError(ErrorCode::EC_WOULD_BLOCK, system);
+        case WSAEINTR:
+            return SsError(ErrorCode::EC_INTERRUPTED, system);
+        case WSAECONNRESET:
+        case WSAECONNABORTED:
+            return SsError(ErrorCode::EC_RESET, system);
+        case WSAETIMEDOUT:
+            return SsError(ErrorCode::EC_TIMEOUT, system);
+        case WSAECONNREFUSED:
+        case WSAEHOSTUNREACH:
+        case WSAENETUNREACH:
+            return SsError(ErrorCode::EC_REFUSED, system);
+#endif
+        default:
+            return SsError(ErrorCode::EC_SYSTEM, system);
+    }
+}
+
+// error of the last failed socket call
+SsError SsError::last() {
+#if defined(__platform_linux__)
+    return fromSystem(errno);
+#elif defined(__platform_windows__)
+    return fromSystem(WSAGetLastError());
+#endif
+}
+
+// short name of a code
+const char *SsError::name(ErrorCode code) {
+    switch (code) {
+        case ErrorCode::EC_NONE:            return "none";
+        case ErrorCode::EC_WOULD_BLOCK:     return "would block";
+        case ErrorCode::EC_INTERRUPTED:     return "interrupted";
+        case ErrorCode::EC_RESET:           return "reset";
+        case ErrorCode::EC_TIMEOUT:         return "timeout";
+        case ErrorCode::EC_REFUSED:         return "refused";
+        case ErrorCode::EC_BAD_HEADER:      return "bad header";
+        case ErrorCode::EC_INVALID_STATE:   return "invalid state";
+        case ErrorCode::EC_UNSUPPORTED:     return "unsupported";
+        case ErrorCode::EC_SYSTEM:          return "system error";
+    }
+
+    return "unknown";
+}
+
+// the cold path: startup and configuration failures become exceptions
+void SsError::raise(SsLogger::LoggerLevel level) const {
+    std::ostringstream message;
+    message << *this;
+    throw SsException(level, message.str());
+}
+
+// name and the system error behind it
+std::ostream &operator<<(std::ostream &o, const SsError &error) {
+    o << SsError::name(error._code);
+    if (error._system != 0) {
+        o << " (" << error._system << ": " << std::strerror(error._system)
+          << ")";
+    }
+
+    return o;
+}
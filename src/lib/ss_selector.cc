@@ -81,18 +81,17 @@ void SsSelector::movify(SsSelector::Descriptor descriptor,
     }
 }
 
-// start select all objects
+// start select all objects, a timeout or a signal gives no events
 #if defined(__platform_linux__)
 SsSelector::SelectResult SsSelector::select(int timeout) {
-    SelectResult result;
+    SelectEvents result;
     int pollResult = ::poll(&_objects[0], _objects.size(), timeout * 1000);
     if (pollResult == OPERATOR_FAILURE) {
-        result.first = SelectorState::SS_FAILURE;
-    } else if (pollResult == 0) {
-        result.first = SelectorState::SS_TIMEOUT;
-    } else {
-        result.first = SelectorState::SS_SUCCESS;
-
+        auto error = SsError::last();
+        if (error != SsError::ErrorCode::EC_INTERRUPTED) {
+            return error;
+        }
+    } else if (pollResult > 0) {
         for (auto &fd : _objects) {
             auto descriptorReadable = false;
             auto descriptorWritable = false;
@@ -106,7 +105,7 @@ SsSelector::SelectResult SsSelector::select(int timeout) {
                     descriptorWritable = true;
                 }
 
-                result.second.push_back({fd.fd, {
+                result.push_back({fd.fd, {
                     descriptorReadable, descriptorWritable
                 }});
 
@@ -117,7 +116,7 @@ SsSelector::SelectResult SsSelector::select(int timeout) {
         }
     }
 
-    return result;
+    return std::move(result);
 }
 #elif defined(__platform_windows__)
 SsSelector::SelectResult SsSelector::select(int timeout) {
@@ -137,15 +136,14 @@ SsSelector::SelectResult SsSelector::select(int timeout) {
         }
     }
 
-    SelectResult result;
+    SelectEvents result;
     int selectResult = ::select(FD_SETSIZE, &readable, &writable, nullptr, &tv);
     if (selectResult == OPERATOR_FAILURE) {
-        result.first = SelectorState::SS_FAILURE;
-    } else if (selectResult == 0) {
-        result.first = SelectorState::SS_TIMEOUT;
-    } else {
-        result.first = SelectorState::SS_SUCCESS;
-
+        auto error = SsError::last();
+        if (error != SsError::ErrorCode::EC_INTERRUPTED) {
+            return error;
+        }
+    } else if (selectResult > 0) {
         for (auto &pair : _objects) {
             auto descriptorReadable = false;
             auto descriptorWritable = false;
@@ -158,7 +156,7 @@ SsSelector::SelectResult SsSelector::select(int timeout) {
             }
 
             if (descriptorReadable || descriptorWritable) {
-                result.second.push_back({pair.first, {
+                result.push_back({pair.first, {
                     descriptorReadable, descriptorWritable
                 }});
 
@@ -169,7 +167,7 @@ SsSelector::SelectResult SsSelector::select(int timeout) {
         }
     }
 
-    return result;
+    return std::move(result);
 }
 #endif
 
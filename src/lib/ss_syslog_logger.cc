@@ -0,0 +1,209 @@
+#include "shadowsocks/ss_syslog_logger.h"
+#include "shadowsocks/ss_exception.h"
+
+
+#if defined(__platform_linux__)
+// SsDatagramBuffer constructor, the socket is connected right away
+SsDatagramBuffer::SsDatagramBuffer(std::string path) : _path(std::move(path)) {
+    if (!connect()) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+            SsLogger::format("cannot connect log socket %s: %s",
+                             _path, std::strerror(errno)));
+    }
+}
+
+// SsDatagramBuffer destructor, everything pending is sent
+SsDatagramBuffer::~SsDatagramBuffer() {
+    sync();
+    close();
+}
+
+// single characters are only part of frames
+SsDatagramBuffer::int_type SsDatagramBuffer::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        _pending += traits_type::to_char_type(c);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+// frames wait for the next flush
+std::streamsize SsDatagramBuffer::xsputn(const char *data,
+                                         std::streamsize size) {
+    _pending.append(data, static_cast<size_t>(size));
+    return size;
+}
+
+// ostream::flush, every complete frame is sent
+int SsDatagramBuffer::sync() {
+    size_t offset = 0;
+    while (offset < _pending.size()) {
+        auto sent = send(offset);
+        if (sent == offset) {
+            break;
+        }
+        offset = sent;
+    }
+    _pending.erase(0, offset);
+
+    return 0;
+}
+
+// datagram socket connected to path, close on exec
+bool SsDatagramBuffer::connect() {
+    _descriptor = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (_descriptor < 0) {
+        return false;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, _path.c_str(),
+                 sizeof(address.sun_path) - 1);
+    if (::connect(_descriptor, reinterpret_cast<sockaddr*>(&address),
+                  sizeof(address)) != 0) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// close current socket
+void SsDatagramBuffer::close() {
+    if (_descriptor >= 0) {
+        ::close(_descriptor);
+        _descriptor = -1;
+    }
+}
+
+// one sendmmsg for up to SYSLOG_BATCH_MESSAGES frames from offset, returns
+// the offset after what was sent or dropped, unchanged when frames are
+// incomplete
+size_t SsDatagramBuffer::send(size_t offset) {
+    mmsghdr messages[SYSLOG_BATCH_MESSAGES];
+    iovec vectors[SYSLOG_BATCH_MESSAGES];
+    size_t ends[SYSLOG_BATCH_MESSAGES];
+
+    unsigned count = 0;
+    auto position = offset;
+    while (count < SYSLOG_BATCH_MESSAGES &&
+           _pending.size() - position >= sizeof(uint32_t)) {
+        uint32_t size;
+        std::memcpy(&size, _pending.data() + position, sizeof(size));
+        if (_pending.size() - position - sizeof(size) < size) {
+            break;
+        }
+
+        vectors[count].iov_base = &_pending[position + sizeof(size)];
+        vectors[count].iov_len = size;
+        messages[count] = mmsghdr{};
+        messages[count].msg_hdr.msg_iov = &vectors[count];
+        messages[count].msg_hdr.msg_iovlen = 1;
+        position += sizeof(size) + size;
+        ends[count++] = position;
+    }
+    if (count == 0) {
+        return offset;
+    }
+
+    // never block the logger on a slow daemon, the daemon may also have
+    // restarted, so one reconnect per batch
+    auto sent = -1;
+    for (int attempt = 0; attempt < 2 && sent < 0; ++attempt) {
+        if (_descriptor < 0 && !connect()) {
+            break;
+        }
+        do {
+            sent = ::sendmmsg(_descriptor, messages, count, MSG_DONTWAIT);
+        } while (sent < 0 && errno == EINTR);
+
+        if (sent < 0 && (errno == ECONNREFUSED || errno == ENOTCONN ||
+                         errno == ENOENT)) {
+            close();
+        } else {
+            break;
+        }
+    }
+    auto error = errno;
+    if (sent > 0) {
+        // back after an outage, the loss is reported once
+        if (_dropped != 0) {
+            std::fprintf(stderr, "log socket %s available again, %llu "
+                         "messages lost\n", _path.c_str(),
+                         static_cast<unsigned long long>(_dropped));
+            _dropped = 0;
+            _reported = 0;
+        }
+        return ends[sent - 1];
+    }
+
+    // a failed send drops the whole batch, the logger lock is held here, so
+    // failures cannot be logged, stderr gets them at doubling counts
+    _dropped += count;
+    if (_dropped >= _reported * 2) {
+        std::fprintf(stderr, "log socket %s unavailable: %s, %llu messages "
+                     "lost\n", _path.c_str(), std::strerror(error),
+                     static_cast<unsigned long long>(_dropped));
+        _reported = _dropped;
+    }
+    return ends[count - 1];
+}
+
+// SsDatagramStream constructor
+SsDatagramStream::SsDatagramStream(std::string path) :
+    std::ostream(nullptr), _buffer(std::move(path)) {
+    rdbuf(&_buffer);
+}
+
+// SsSyslogLogger constructor, journald gets native fields, syslog logfmt
+SsSyslogLogger::SsSyslogLogger(std::string identifier,
+                               SyslogProtocol protocol, std::string path) :
+    SsDatagramStream(!path.empty() ? std::move(path)
+                     : protocol == SyslogProtocol::SP_JOURNAL
+                         ? SYSLOG_JOURNAL_PATH : SYSLOG_DEVICE_PATH),
+    SsLogger(static_cast<std::ostream&>(*this)),
+    _identifier(std::move(identifier)),
+    _protocol(protocol) {
+    setEncoding(protocol == SyslogProtocol::SP_JOURNAL
+                    ? LoggerEncoding::LE_JOURNAL : LoggerEncoding::LE_LOGFMT);
+}
+
+// one datagram per record, the daemon adds the time
+void SsSyslogLogger::append(LoggerLevel level, time_t time,
+                            const char *message, size_t size) {
+    auto priority = syslogPriority(level);
+
+    // forked workers report their own pid
+    auto pid = ::getpid();
+    if (pid != _pid) {
+        _pid = pid;
+        _pidText = std::to_string(pid);
+    }
+
+    _record.assign(sizeof(uint32_t), '\0');
+    if (_protocol == SyslogProtocol::SP_JOURNAL) {
+        _record += "PRIORITY=";
+        _record += static_cast<char>('0' + priority);
+        _record += "\nSYSLOG_IDENTIFIER=";
+        _record += _identifier;
+        _record += "\nSYSLOG_PID=";
+        _record += _pidText;
+        _record += '\n';
+        _record.append(message, size);
+    } else {
+        _record += '<';
+        _record += std::to_string(SYSLOG_FACILITY_DAEMON | priority);
+        _record += '>';
+        _record += _identifier;
+        _record += '[';
+        _record += _pidText;
+        _record += "]: ";
+        _record.append(message, size);
+    }
+
+    auto length = static_cast<uint32_t>(_record.size() - sizeof(uint32_t));
+    std::memcpy(&_record[0], &length, sizeof(length));
+    appendBatch(_record.data(), _record.size());
+}
+#endif
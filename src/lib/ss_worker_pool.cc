@@ -0,0 +1,272 @@
+#include "shadowsocks/ss_worker_pool.h"
+#include "shadowsocks/ss_file_logger.h"
+#include "shadowsocks/ss_affinity.h"
+#include "shadowsocks/ss_exception.h"
+
+
+#if defined(HAVE_FORK)
+// SsWorkerPool constructor, nothing is forked before run()
+SsWorkerPool::SsWorkerPool(size_t workers, WorkerMain main) :
+    _main(std::move(main)), _workers(workers, Worker{0, {}, {}}) {
+    if (workers == 0) {
+        throw SsException(SsLogger::LoggerLevel::LL_ERROR,
+                          "worker pool needs at least one worker");
+    }
+
+    sigemptyset(&_signals);
+    sigemptyset(&_previous);
+    for (auto signal : {SIGCHLD, SIGTERM, SIGINT, SIGQUIT,
+                        SIGHUP, SIGUSR1, SIGUSR2}) {
+        sigaddset(&_signals, signal);
+    }
+}
+
+// master loop until every worker stopped, SIGTERM and SIGINT let workers
+// drain, SIGQUIT makes them close at once, also while they drain, signals
+// are taken synchronously so nothing runs in a handler
+int SsWorkerPool::run() {
+    sigprocmask(SIG_BLOCK, &_signals, &_previous);
+
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        spawn(i);
+    }
+    INF("master %d started %d workers", ::getpid(), _workers.size());
+
+    while (!_stopping || alive() != 0) {
+        timespec timeout{0, WORKER_WAIT_INTERVAL * 1000000L};
+        switch (sigtimedwait(&_signals, nullptr, &timeout)) {
+            case SIGTERM:
+            case SIGINT:
+                stop(SIGTERM);
+                break;
+            case SIGQUIT:
+                stop(SIGQUIT);
+                break;
+            case SIGHUP:
+                SsFileBuffer::reopenAll();
+                forward(SIGHUP);
+                reload();
+                break;
+            case SIGUSR1:
+                SsLogger::dumpFlightRecorder();
+                forward(SIGUSR1);
+                break;
+            case SIGUSR2:
+                forward(SIGUSR2);
+                break;
+            default:
+                break;
+        }
+
+        reap();
+        if (!_stopping) {
+            restart();
+        } else if (alive() != 0 && Clock::now() >= _stopDeadline) {
+            WARN("%d workers still running, killing them", alive());
+            forward(SIGKILL);
+            _stopDeadline = Clock::time_point::max();
+        }
+    }
+
+    INF("master %d stopped", ::getpid());
+    sigprocmask(SIG_SETMASK, &_previous, nullptr);
+    return _status;
+}
+
+// number of workers
+size_t SsWorkerPool::size() const {
+    return _workers.size();
+}
+
+// workers forked from now on are pinned to their core
+void SsWorkerPool::setPinned(bool pinned) {
+    _pinned = pinned;
+}
+
+// configuration reloaded by the master on SIGHUP, workers forked from now
+// on start with its current snapshot
+void SsWorkerPool::setConfigStore(SsConfigStore *store) {
+    _store = store;
+}
+
+// fork worker index, the child runs main with the signal mask it had before
+// run() and exits with its result, no logger thread or lock crosses the fork
+bool SsWorkerPool::spawn(size_t index) {
+    auto &worker = _workers[index];
+    auto master = ::getpid();
+
+    auto async = SsLogger::suspendAsync();
+    auto pid = ::fork();
+    if (pid != 0 && async) {
+        SsLogger::resumeAsync();
+    }
+
+    if (pid < 0) {
+        ERR("cannot fork worker %d: %s", index, std::strerror(errno));
+        worker.pid = 0;
+        worker.restartAt = Clock::now() +
+                           std::chrono::milliseconds(WORKER_RESTART_DELAY);
+        return false;
+    }
+
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &_previous, nullptr);
+#if defined(__platform_linux__)
+        // a killed master takes its workers along
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (::getppid() != master) {
+            std::_Exit(EXIT_FAILURE);
+        }
+#endif
+
+        if (_pinned) {
+            auto pinned = SsAffinity::pinReactor(index);
+            if (!pinned) {
+                WARN("cannot pin worker %d: %s", index, pinned.error());
+            }
+        }
+
+        auto status = EXIT_FAILURE;
+        try {
+            status = _main(index);
+        } catch (const std::exception &e) {
+            ERR("worker %d failed: %s", index, e.what());
+        }
+        std::exit(status);
+    }
+
+    worker.pid = pid;
+    worker.started = Clock::now();
+    DBG("worker %d started as %d", index, pid);
+    return true;
+}
+
+// collect exited workers, those that died soon after starting are
+// restarted with a delay so a broken worker does not spin
+void SsWorkerPool::reap() {
+    for (;;) {
+        int status;
+        auto pid = ::waitpid(-1, &status, WNOHANG);
+        if (pid <= 0) {
+            break;
+        }
+
+        auto worker = std::find_if(_workers.begin(), _workers.end(),
+            [&] (const Worker &worker) {
+                return worker.pid == pid;
+            }
+        );
+        if (worker == _workers.end()) {
+            auto retired = std::find(_retired.begin(), _retired.end(), pid);
+            if (retired != _retired.end()) {
+                DBG("retired worker %d exited", pid);
+                _retired.erase(retired);
+            }
+            continue;
+        }
+
+        auto index = worker - _workers.begin();
+        if (WIFSIGNALED(status)) {
+            WARN("worker %d (%d) killed by signal %d",
+                 index, pid, WTERMSIG(status));
+            _status = EXIT_FAILURE;
+        } else if (WEXITSTATUS(status) != EXIT_SUCCESS) {
+            WARN("worker %d (%d) exited with status %d",
+                 index, pid, WEXITSTATUS(status));
+            _status = EXIT_FAILURE;
+        } else if (!_stopping) {
+            INF("worker %d (%d) exited", index, pid);
+        }
+
+        auto now = Clock::now();
+        worker->pid = 0;
+        worker->restartAt = now;
+        if (now - worker->started <
+                std::chrono::milliseconds(WORKER_MIN_UPTIME)) {
+            worker->restartAt += std::chrono::milliseconds(
+                WORKER_RESTART_DELAY);
+        }
+    }
+}
+
+// replace exited workers that are due
+void SsWorkerPool::restart() {
+    auto now = Clock::now();
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i].pid == 0 && now >= _workers[i].restartAt) {
+            INF("restarting worker %d", i);
+            spawn(i);
+        }
+    }
+}
+
+// workers reload the configuration on their own SIGHUP, only a changed
+// listener set needs new workers, a broken file keeps everything running
+void SsWorkerPool::reload() {
+    if (_store == nullptr || _stopping) {
+        return;
+    }
+
+    auto before = _store->current();
+    if (!_store->reload()) {
+        return;
+    }
+
+    auto after = _store->current();
+    if (!SsConfiguration::added(*before, *after).empty() ||
+            !SsConfiguration::added(*after, *before).empty()) {
+        replace();
+    }
+}
+
+// running workers drain on SIGTERM and are reaped without a restart, new
+// ones bind the listeners of the current snapshot
+void SsWorkerPool::replace() {
+    INF("listeners changed, replacing %d workers", alive() - _retired.size());
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        auto &worker = _workers[i];
+        if (worker.pid != 0) {
+            ::kill(worker.pid, SIGTERM);
+            _retired.push_back(worker.pid);
+        }
+        spawn(i);
+    }
+}
+
+// same signal to every running worker, retired ones included
+void SsWorkerPool::forward(int signal) {
+    for (auto &worker : _workers) {
+        if (worker.pid != 0) {
+            ::kill(worker.pid, signal);
+        }
+    }
+    for (auto pid : _retired) {
+        ::kill(pid, signal);
+    }
+}
+
+// no more restarts, workers get signal and WORKER_STOP_TIMEOUT to exit,
+// longer than the CORE_DRAIN_PERIOD they take to drain, a worker that got
+// SIGTERM already, e.g. from the service manager, just ignores another
+void SsWorkerPool::stop(int signal) {
+    if (!_stopping) {
+        INF("stopping %d workers", alive());
+        _stopping = true;
+        _status = EXIT_SUCCESS;
+        _stopDeadline = Clock::now() +
+                        std::chrono::milliseconds(WORKER_STOP_TIMEOUT);
+    }
+
+    forward(signal);
+}
+
+// workers currently running, retired ones still draining included
+size_t SsWorkerPool::alive() const {
+    return _retired.size() + static_cast<size_t>(
+        std::count_if(_workers.begin(), _workers.end(),
+            [] (const Worker &worker) {
+                return worker.pid != 0;
+            }
+        ));
+}
+#endif
@@ -1,17 +1,81 @@
-#include <iostream>
-#include <cstdlib>
-#include "ss_config.h"
+#include "shadowsocks/ss_core.h"
+#include "shadowsocks/ss_configuration.h"
+#include "shadowsocks/ss_worker_pool.h"
+#include "shadowsocks/ss_exception.h"
 
 
-void atExitHandler() {
-    std::cout << "atExitHandler" << std::endl << std::flush;
+#define SERVER_DEFAULT_CONFIG           ("ss-server.conf")
+#define SERVER_POLL_INTERVAL            (200)
+
+
+// print usage
+static void usage(const char *program) {
+    std::cout << "usage: " << program << " [-c config] [-w workers]"
+              << std::endl
+              << "  -c  configuration file, " << SERVER_DEFAULT_CONFIG
+              << " by default" << std::endl
+              << "  -w  worker processes, one per core by default"
+              << std::endl;
+}
+
+// event loop of one worker, picks up reloaded users, acls and limits, the
+// listeners it was started with stay until the master replaces it
+static int serve(SsConfigStore &store, size_t index) {
+    SsConfigStore::View view(store);
+    INF_FIELDS("worker serving", logField("index", index),
+               logField("listeners", view.get()->listeners().size()),
+               logField("generation", store.generation()));
+
+    while (SsCore::shutdownPhase() == SsCore::ShutdownPhase::SP_RUNNING) {
+        store.poll();
+        if (view.refresh()) {
+            DBG("worker %d uses configuration generation %d",
+                index, store.generation());
+        }
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(SERVER_POLL_INTERVAL));
+    }
+
+    return EXIT_SUCCESS;
 }
 
 
 int main(int argc, char *argv[]) {
-    std::cout << APPLICATION_NAME << std::endl;
+    std::string config = SERVER_DEFAULT_CONFIG;
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            config = argv[++i];
+        } else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc &&
+                   std::atoi(argv[i + 1]) > 0) {
+            workers = static_cast<size_t>(std::atoi(argv[++i]));
+        } else {
+            usage(argv[0]);
+            return std::strcmp(argv[i], "-h") == 0 ? EXIT_SUCCESS
+                                                    : EXIT_FAILURE;
+        }
+    }
 
-    std::cout << std::atexit(atExitHandler);
+    SsCore::enableDebugLogger(SsLogger::LoggerLevel::LL_INFO);
+    SsCore::initEnvironments();
 
-    return 0;
+    try {
+        // a broken configuration fails here, before anything is forked
+        SsConfigStore store(config);
+#if defined(HAVE_FORK)
+        SsWorkerPool pool(workers, [&] (size_t index) {
+            return serve(store, index);
+        });
+        pool.setConfigStore(&store);
+        return pool.run();
+#else
+        if (workers > 1) {
+            WARN("no fork on this platform, serving in one process");
+        }
+        return serve(store, 0);
+#endif
+    } catch (const SsException &) {
+        // logged where it was thrown
+        return EXIT_FAILURE;
+    }
 }
@@ -0,0 +1,60 @@
+#include "shadowsocks/ss_log_record.h"
+#include "shadowsocks/ss_access_log.h"
+#include "shadowsocks/ss_exception.h"
+
+
+// print usage
+static void usage(const char *program) {
+    std::cout << "usage: " << program << " [-a] [file...]" << std::endl
+              << "  decodes binary logs to text, standard input without files"
+              << std::endl
+              << "  -a  the files are access logs" << std::endl;
+}
+
+// decode one stream to standard output, false on a damaged stream
+template <typename Reader>
+static bool decode(std::istream &in, const char *name) {
+    Reader reader(in);
+
+    try {
+        std::string line;
+        while (reader.next(line)) {
+            std::cout << line << '\n';
+        }
+    } catch (const SsException &e) {
+        std::cerr << name << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && std::strcmp(argv[1], "-h") == 0) {
+        usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    auto access = argc > 1 && std::strcmp(argv[1], "-a") == 0;
+    auto decodeStream = access ? decode<SsAccessLogReader>
+                               : decode<SsLogRecordReader>;
+
+    auto first = access ? 2 : 1;
+    if (argc == first) {
+        return decodeStream(std::cin, "stdin") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    auto status = EXIT_SUCCESS;
+    for (int i = first; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            std::cerr << argv[i] << ": " << std::strerror(errno) << std::endl;
+            status = EXIT_FAILURE;
+        } else if (!decodeStream(in, argv[i])) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}